@@ -0,0 +1,116 @@
+#include <cmath>
+#include <algorithm>
+#include "adaptivesweep.h"
+
+const std::vector<uint16_t>& AdaptiveSweep::start(const Limits &limits)
+{
+    m_limits = limits;
+    m_limits.m_coarseStep = std::max<uint16_t>(limits.m_coarseStep, 1);
+    m_limits.m_minStep    = std::max<uint16_t>(limits.m_minStep, 1);
+
+    m_points.clear();
+    m_round.clear();
+
+    for(uint32_t pwm = m_limits.m_start; pwm <= m_limits.m_end; pwm += m_limits.m_coarseStep)
+    {
+        m_round.push_back(static_cast<uint16_t>(pwm));
+    }
+
+    // always end at the last PWM so the whole range is covered
+    if (m_round.empty() || (m_round.back() != m_limits.m_end))
+    {
+        m_round.push_back(m_limits.m_end);
+    }
+
+    return m_round;
+}
+
+void AdaptiveSweep::addPoint(uint16_t pwm, const AdcPair &reading)
+{
+    m_points.push_back(Point{pwm, reading});
+}
+
+const std::vector<uint16_t>& AdaptiveSweep::refine()
+{
+    m_round.clear();
+
+    std::sort(m_points.begin(), m_points.end(),
+        [](const Point &a, const Point &b) { return a.m_pwm < b.m_pwm; });
+
+    if (m_points.size() < 3)
+    {
+        return m_round;
+    }
+
+    // scale both axes to the span of the curve so the
+    // tolerance doesn't depend on the device or the range.
+    int32_t minx = m_points.front().m_reading.m_v2;
+    int32_t maxx = minx;
+    int32_t miny = m_points.front().m_reading.m_v1 - minx;
+    int32_t maxy = miny;
+    for(const auto &point : m_points)
+    {
+        const int32_t x = point.m_reading.m_v2;
+        const int32_t y = point.m_reading.m_v1 - point.m_reading.m_v2;
+        minx = std::min(minx, x);
+        maxx = std::max(maxx, x);
+        miny = std::min(miny, y);
+        maxy = std::max(maxy, y);
+    }
+
+    const float xscale = 1.0f / static_cast<float>(std::max(maxx - minx, 1));
+    const float yscale = 1.0f / static_cast<float>(std::max(maxy - miny, 1));
+
+    auto x = [&](const Point &p) { return static_cast<float>(p.m_reading.m_v2) * xscale; };
+    auto y = [&](const Point &p) { return static_cast<float>(p.m_reading.m_v1 - p.m_reading.m_v2) * yscale; };
+
+    // halve an interval, unless the halves would be below the minimum step
+    auto split = [&](const Point &a, const Point &b)
+    {
+        if ((b.m_pwm - a.m_pwm) >= 2*m_limits.m_minStep)
+        {
+            const auto pwm = static_cast<uint16_t>((a.m_pwm + b.m_pwm) / 2);
+            if (m_round.empty() || (m_round.back() != pwm))
+            {
+                m_round.push_back(pwm);
+            }
+        }
+    };
+
+    for(size_t i=1; i+1<m_points.size(); i++)
+    {
+        const auto &a = m_points[i-1];
+        const auto &b = m_points[i];
+        const auto &c = m_points[i+1];
+
+        // distance of b to the chord a-c
+        const float dx = x(c) - x(a);
+        const float dy = y(c) - y(a);
+        const float length = std::sqrt(dx*dx + dy*dy);
+        float deviation;
+        if (length > 0.0f)
+        {
+            deviation = std::fabs(dx*(y(a) - y(b)) - dy*(x(a) - x(b))) / length;
+        }
+        else
+        {
+            deviation = std::hypot(x(b) - x(a), y(b) - y(a));
+        }
+
+        if (deviation > m_limits.m_tolerance)
+        {
+            split(a, b);
+            split(b, c);
+        }
+    }
+
+    // the PWMs are in ascending order, the budget goes to the
+    // first ones as they cover the knee of a collector sweep.
+    const size_t budget = (m_limits.m_maxPoints > m_points.size()) ? (m_limits.m_maxPoints - m_points.size()) : 0;
+    if (m_round.size() > budget)
+    {
+        m_round.resize(budget);
+    }
+
+    return m_round;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "customevent.h"
+
+/** plans a collector sweep that refines where the curve bends.
+
+    The sweep starts with a coarse, uniform, set of PWMs. After each
+    round of measurements every point is compared with the chord
+    through its neighbours, in the plane of the device voltage (v2)
+    and the sense voltage (v1-v2), both scaled to the span of the curve.
+    Where a point deviates more than the tolerance the intervals on
+    both sides are halved in the next round, until the minimum step is
+    reached. Flat regions keep the coarse step and the knee gets the
+    fine one.
+*/
+class AdaptiveSweep
+{
+public:
+    struct Limits
+    {
+        uint16_t m_start;       // first PWM
+        uint16_t m_end;         // last PWM
+        uint16_t m_coarseStep;  // step of the first round
+        uint16_t m_minStep;     // intervals are not refined below this step
+        float    m_tolerance;   // deviation from the chord, as a fraction of the curve span
+        uint32_t m_maxPoints;   // maximum number of points of the sweep
+    };
+
+    struct Point
+    {
+        uint16_t m_pwm;
+        AdcPair  m_reading;
+    };
+
+    /** start a sweep, returns the PWMs of the coarse round */
+    const std::vector<uint16_t>& start(const Limits &limits);
+
+    /** add the reading at a PWM of the current round */
+    void addPoint(uint16_t pwm, const AdcPair &reading);
+
+    /** the PWMs of the next round, empty when the sweep is complete */
+    const std::vector<uint16_t>& refine();
+
+    /** all points of the sweep so far, sorted by PWM after refine() */
+    const std::vector<Point>& points() const noexcept
+    {
+        return m_points;
+    }
+
+protected:
+    Limits m_limits;
+    std::vector<Point>    m_points;
+    std::vector<uint16_t> m_round;  // PWMs of the current round
+};
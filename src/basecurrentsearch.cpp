@@ -0,0 +1,93 @@
+#include <cmath>
+#include <algorithm>
+#include "basecurrentsearch.h"
+
+uint16_t BaseCurrentSearch::start(const Target &target)
+{
+    m_target     = target;
+    m_iterations = 0;
+    m_converged  = false;
+    m_lowPwm     = c_minPwm - 1;
+    m_highPwm    = c_maxPwm + 1;
+    m_pwm        = std::clamp(static_cast<int32_t>(target.m_pwm), c_minPwm, c_maxPwm);
+    m_prevPwm    = m_pwm;
+    m_prevError  = 0.0f;
+    m_hasPrev    = false;
+    m_bestPwm    = m_pwm;
+    m_bestError  = INFINITY;
+    return static_cast<uint16_t>(m_pwm);
+}
+
+bool BaseCurrentSearch::next(const AdcPair &measurement, uint16_t &pwm)
+{
+    m_iterations++;
+
+    const float error = senseCounts(measurement) - m_target.m_counts;
+    if (std::fabs(error) < std::fabs(m_bestError))
+    {
+        m_bestPwm   = m_pwm;
+        m_bestError = error;
+    }
+
+    if (std::fabs(error) <= m_target.m_tolerance)
+    {
+        m_converged = true;
+        return false;
+    }
+
+    if (m_iterations >= m_target.m_maxIterations)
+    {
+        return false;
+    }
+
+    if (error < 0.0f)
+    {
+        m_lowPwm = std::max(m_lowPwm, m_pwm);
+    }
+    else
+    {
+        m_highPwm = std::min(m_highPwm, m_pwm);
+    }
+
+    // no untried PWM is left between the measurements
+    // below and above the target, or the range ends.
+    if (m_highPwm - m_lowPwm <= 1)
+    {
+        return false;
+    }
+
+    float slope = m_target.m_countsPerPwm;
+    if (m_hasPrev && (m_prevPwm != m_pwm))
+    {
+        slope = (error - m_prevError) / static_cast<float>(m_pwm - m_prevPwm);
+    }
+
+    int32_t candidate = m_lowPwm;   // invalid unless the secant step works out
+    if (slope > 0.0f)
+    {
+        const float step = std::round(-error / slope);
+        if (std::fabs(step) < static_cast<float>(c_maxPwm))
+        {
+            candidate = m_pwm + static_cast<int32_t>(step);
+
+            // rounding to the same PWM would stall the search
+            if (candidate == m_pwm)
+            {
+                candidate += (error < 0.0f) ? 1 : -1;
+            }
+        }
+    }
+
+    if ((candidate <= m_lowPwm) || (candidate >= m_highPwm))
+    {
+        candidate = (m_lowPwm + m_highPwm) / 2;
+    }
+
+    m_prevPwm   = m_pwm;
+    m_prevError = error;
+    m_hasPrev   = true;
+    m_pwm       = std::clamp(candidate, c_minPwm, c_maxPwm);
+
+    pwm = static_cast<uint16_t>(m_pwm);
+    return true;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include "customevent.h"
+
+/** closed-loop search for the base PWM that results in a base current.
+
+    Everything is in raw units: the base current is measured as the
+    calibrated difference v1-v2 in ADC counts, the voltage across the
+    base sense resistor. The current rises monotonically with the PWM,
+    so each measurement narrows a bracket around the target. The next
+    PWM is a secant step through the last two measurements, or along
+    the expected slope after the first one. Steps that leave the
+    bracket are replaced by bisection, so the search always ends.
+*/
+class BaseCurrentSearch
+{
+public:
+    static constexpr int32_t c_minPwm = 0;
+    static constexpr int32_t c_maxPwm = 1023;
+
+    struct Target
+    {
+        float    m_counts;          // calibrated v1-v2 to reach
+        float    m_tolerance;       // in counts
+        float    m_countsPerPwm;    // expected slope, used for the first step
+        float    m_gain[2];         // calibration of the ADC channels, see SweepSetup
+        float    m_offset[2];
+        uint16_t m_pwm;             // first guess
+        uint16_t m_maxIterations;   // maximum number of measurements
+    };
+
+    /** start a search, returns the first PWM to measure */
+    uint16_t start(const Target &target);
+
+    /** handle the measurement at the PWM returned last. returns true and
+        the next PWM to measure, or false when the search has ended. */
+    bool next(const AdcPair &measurement, uint16_t &pwm);
+
+    /** true if the tolerance was reached */
+    bool converged() const noexcept
+    {
+        return m_converged;
+    }
+
+    /** PWM with the measurement closest to the target */
+    uint16_t bestPwm() const noexcept
+    {
+        return static_cast<uint16_t>(m_bestPwm);
+    }
+
+    /** number of measurements so far */
+    uint32_t iterations() const noexcept
+    {
+        return m_iterations;
+    }
+
+    /** calibrated base sense voltage of a base response in counts */
+    float senseCounts(const AdcPair &measurement) const noexcept
+    {
+        return (m_target.m_gain[0] * static_cast<float>(measurement.m_v1) + m_target.m_offset[0]) -
+            (m_target.m_gain[1] * static_cast<float>(measurement.m_v2) + m_target.m_offset[1]);
+    }
+
+protected:
+    Target   m_target;
+    uint32_t m_iterations;
+    bool     m_converged;
+
+    int32_t  m_lowPwm;      // highest PWM below the target, c_minPwm-1 if none
+    int32_t  m_highPwm;     // lowest PWM above the target, c_maxPwm+1 if none
+
+    int32_t  m_pwm;         // PWM being measured
+    int32_t  m_prevPwm;     // previous measurement, for the secant
+    float    m_prevError;
+    bool     m_hasPrev;
+
+    int32_t  m_bestPwm;
+    float    m_bestError;
+};
@@ -0,0 +1,96 @@
+#include <cstring>
+#include <algorithm>
+#include "binaryframer.h"
+
+BinaryFramer::BinaryFramer()
+{
+    m_checksumErrors = 0;
+    clear();
+}
+
+void BinaryFramer::clear()
+{
+    m_begin = 0;
+    m_end   = 0;
+}
+
+BinaryFramer::CommandRecord BinaryFramer::encodeCommand(char command,
+    uint16_t arg0, uint16_t arg1, uint16_t arg2)
+{
+    CommandRecord record;
+    record[0] = c_commandSync;
+    record[1] = static_cast<uint8_t>(command);
+    record[2] = arg0 & 0xFF;
+    record[3] = arg0 >> 8;
+    record[4] = arg1 & 0xFF;
+    record[5] = arg1 >> 8;
+    record[6] = arg2 & 0xFF;
+    record[7] = arg2 >> 8;
+
+    uint8_t sum = 0;
+    for(size_t i=0; i<c_commandSize-1; i++)
+    {
+        sum += record[i];
+    }
+    record[8] = static_cast<uint8_t>(-sum);
+
+    return record;
+}
+
+size_t BinaryFramer::write(const char *data, size_t len)
+{
+    if ((m_begin > 0) && (m_end + len > m_buffer.size()))
+    {
+        // move the unprocessed data to the front
+        std::memmove(m_buffer.data(), m_buffer.data() + m_begin, m_end - m_begin);
+        m_end  -= m_begin;
+        m_begin = 0;
+    }
+
+    const size_t consumed = std::min(len, m_buffer.size() - m_end);
+    std::memcpy(m_buffer.data() + m_end, data, consumed);
+    m_end += consumed;
+
+    return consumed;
+}
+
+bool BinaryFramer::readFrame(int32_t &v1, int32_t &v2)
+{
+    while((m_end - m_begin) >= c_responseSize)
+    {
+        const uint8_t *p = m_buffer.data() + m_begin;
+        if (p[0] != c_responseSync)
+        {
+            // resynchronise
+            m_begin++;
+            continue;
+        }
+
+        uint8_t sum = 0;
+        for(size_t i=0; i<c_responseSize; i++)
+        {
+            sum += p[i];
+        }
+
+        if (sum != 0)
+        {
+            // not a valid record, the sync byte
+            // must have been part of a value.
+            m_checksumErrors++;
+            m_begin++;
+            continue;
+        }
+
+        v1 = p[1] | (p[2] << 8) | (p[3] << 16);
+        v2 = p[4] | (p[5] << 8) | (p[6] << 16);
+        m_begin += c_responseSize;
+        return true;
+    }
+
+    if (m_begin == m_end)
+    {
+        clear();
+    }
+
+    return false;
+}
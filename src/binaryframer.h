@@ -0,0 +1,81 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+/** framing for the compact binary tracer protocol.
+
+    Command record (host -> tracer), 9 bytes:
+        [0]    sync 0xA5
+        [1]    command character, same as the ASCII protocol ('B', 'C' ..)
+        [2..7] three 16-bit little-endian arguments
+        [8]    checksum
+
+    Response record (tracer -> host), 8 bytes:
+        [0]    sync 0x5A
+        [1..3] v1, 24-bit little-endian
+        [4..6] v2, 24-bit little-endian
+        [7]    checksum
+
+    The checksum is chosen such that the 8-bit sum of all the bytes
+    in a record, including the sync byte and the checksum, is zero.
+
+    The host requests binary mode by sending the ASCII command "1P \n".
+    Firmware that supports it answers with a response record holding
+    v1 = c_protocolMagic and v2 = firmware feature flags and uses binary
+    records from then on. Older firmware stays in ASCII mode.
+
+    The released firmware is ASCII only. The firmware side of this
+    protocol is implemented by the simulator in tests/tracermodel.cpp,
+    which the tests and benchmarks run against.
+
+    Firmware with c_featureSweep accepts the sweep command 'S' with
+    arguments start, end and step. It sets the collector PWM to
+    start, start+step, .. up to and including end and streams back
+    one response record per step, without waiting for the host.
+*/
+class BinaryFramer
+{
+public:
+    static constexpr uint8_t  c_commandSync   = 0xA5;
+    static constexpr uint8_t  c_responseSync  = 0x5A;
+    static constexpr size_t   c_commandSize   = 9;
+    static constexpr size_t   c_responseSize  = 8;
+    static constexpr int32_t  c_protocolMagic = 0x425450;   // "PTB"
+
+    static constexpr uint32_t c_featureSweep  = 0x01;       // device-side collector sweep
+
+    using CommandRecord = std::array<uint8_t, c_commandSize>;
+
+    BinaryFramer();
+
+    static CommandRecord encodeCommand(char command,
+        uint16_t arg0, uint16_t arg1 = 0, uint16_t arg2 = 0);
+
+    /** store received data. returns the number of bytes consumed, which
+        is less than len when the buffer is full. Call readFrame() to make
+        room and write the remainder. */
+    size_t write(const char *data, size_t len);
+
+    /** get the values of the next valid response record.
+        data that is not part of a valid record is skipped.
+        returns false if there is no complete record. */
+    bool readFrame(int32_t &v1, int32_t &v2);
+
+    /** discard all buffered data */
+    void clear();
+
+    /** number of records rejected because of a checksum error */
+    constexpr size_t checksumErrors() const noexcept
+    {
+        return m_checksumErrors;
+    }
+
+protected:
+    std::array<uint8_t, c_responseSize*64> m_buffer;
+
+    size_t m_begin;     // first unprocessed byte
+    size_t m_end;       // one past the last received byte
+    size_t m_checksumErrors;
+};
@@ -0,0 +1,115 @@
+#include "conversion.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CONVERSION_SSE2
+#endif
+
+AdcConversion::AdcConversion(const SweepSetup &setup)
+{
+    m_gain1   = setup.m_adcGain[0];
+    m_offset1 = setup.m_adcOffset[0];
+    m_gain2   = setup.m_adcGain[1];
+    m_offset2 = setup.m_adcOffset[1];
+
+    // the resistors are in kilo ohms
+    m_collectorAmpsPerCount = c_adcVoltsPerCount / (setup.m_collectorResistor * 1000.0f);
+    m_baseAmpsPerCount      = c_adcVoltsPerCount / (setup.m_baseSenseResistor * 1000.0f);
+}
+
+void AdcConversion::convertScalar(const AdcPair *pairs, size_t count, float *voltage, float *current) const
+{
+    for(size_t i=0; i<count; i++)
+    {
+        const float c1 = m_gain1 * static_cast<float>(pairs[i].m_v1) + m_offset1;
+        const float c2 = m_gain2 * static_cast<float>(pairs[i].m_v2) + m_offset2;
+        voltage[i] = c2 * c_adcVoltsPerCount;
+        current[i] = (c1 - c2) * m_collectorAmpsPerCount;
+    }
+}
+
+#if defined(__AVX2__)
+
+void AdcConversion::convert(const AdcPair *pairs, size_t count, float *voltage, float *current) const
+{
+    const __m256 gain1   = _mm256_set1_ps(m_gain1);
+    const __m256 offset1 = _mm256_set1_ps(m_offset1);
+    const __m256 gain2   = _mm256_set1_ps(m_gain2);
+    const __m256 offset2 = _mm256_set1_ps(m_offset2);
+    const __m256 volts   = _mm256_set1_ps(c_adcVoltsPerCount);
+    const __m256 amps    = _mm256_set1_ps(m_collectorAmpsPerCount);
+
+    // 8 pairs per iteration
+    size_t i = 0;
+    for(; i+8 <= count; i+=8)
+    {
+        const auto src = reinterpret_cast<const __m256i*>(pairs + i);
+        const __m256 a = _mm256_cvtepi32_ps(_mm256_loadu_si256(src));      // pairs 0..3
+        const __m256 b = _mm256_cvtepi32_ps(_mm256_loadu_si256(src + 1));  // pairs 4..7
+
+        // de-interleave, the shuffle works per 128-bit lane which
+        // gives the order 0 1 4 5 2 3 6 7, the permute fixes that.
+        __m256 v1 = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2,0,2,0));
+        __m256 v2 = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3,1,3,1));
+        v1 = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(v1), _MM_SHUFFLE(3,1,2,0)));
+        v2 = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(v2), _MM_SHUFFLE(3,1,2,0)));
+
+        const __m256 c1 = _mm256_add_ps(_mm256_mul_ps(gain1, v1), offset1);
+        const __m256 c2 = _mm256_add_ps(_mm256_mul_ps(gain2, v2), offset2);
+
+        _mm256_storeu_ps(voltage + i, _mm256_mul_ps(c2, volts));
+        _mm256_storeu_ps(current + i, _mm256_mul_ps(_mm256_sub_ps(c1, c2), amps));
+    }
+
+    convertScalar(pairs + i, count - i, voltage + i, current + i);
+}
+
+#elif defined(CONVERSION_SSE2)
+
+void AdcConversion::convert(const AdcPair *pairs, size_t count, float *voltage, float *current) const
+{
+    const __m128 gain1   = _mm_set1_ps(m_gain1);
+    const __m128 offset1 = _mm_set1_ps(m_offset1);
+    const __m128 gain2   = _mm_set1_ps(m_gain2);
+    const __m128 offset2 = _mm_set1_ps(m_offset2);
+    const __m128 volts   = _mm_set1_ps(c_adcVoltsPerCount);
+    const __m128 amps    = _mm_set1_ps(m_collectorAmpsPerCount);
+
+    // 4 pairs per iteration
+    size_t i = 0;
+    for(; i+4 <= count; i+=4)
+    {
+        const auto src = reinterpret_cast<const __m128i*>(pairs + i);
+        const __m128 a = _mm_cvtepi32_ps(_mm_loadu_si128(src));        // pairs 0,1
+        const __m128 b = _mm_cvtepi32_ps(_mm_loadu_si128(src + 1));    // pairs 2,3
+
+        const __m128 v1 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2,0,2,0));
+        const __m128 v2 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3,1,3,1));
+
+        const __m128 c1 = _mm_add_ps(_mm_mul_ps(gain1, v1), offset1);
+        const __m128 c2 = _mm_add_ps(_mm_mul_ps(gain2, v2), offset2);
+
+        _mm_storeu_ps(voltage + i, _mm_mul_ps(c2, volts));
+        _mm_storeu_ps(current + i, _mm_mul_ps(_mm_sub_ps(c1, c2), amps));
+    }
+
+    convertScalar(pairs + i, count - i, voltage + i, current + i);
+}
+
+#else
+
+void AdcConversion::convert(const AdcPair *pairs, size_t count, float *voltage, float *current) const
+{
+    convertScalar(pairs, count, voltage, current);
+}
+
+#endif
+
+float AdcConversion::baseCurrent(const AdcPair &pair) const
+{
+    const float c1 = m_gain1 * static_cast<float>(pair.m_v1) + m_offset1;
+    const float c2 = m_gain2 * static_cast<float>(pair.m_v2) + m_offset2;
+    return (c1 - c2) * m_baseAmpsPerCount;
+}
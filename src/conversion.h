@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "customevent.h"
+
+/** converts raw ADC readings of the tracer to physical units.
+
+    The ADC has a 5V full scale at 2^18 counts. For every response
+    v2 is the voltage across the device under test and v1-v2 is the
+    voltage across the sense resistor, which gives the current.
+    Both ADC channels are corrected with the gain and offset of
+    the setup before conversion.
+
+    The bulk conversion uses AVX2 when the build enables it
+    (ENABLE_AVX2), SSE2 on other x86 builds and scalar code
+    elsewhere.
+*/
+class AdcConversion
+{
+public:
+    explicit AdcConversion(const SweepSetup &setup);
+
+    /** convert collector or diode responses to the voltage across
+        the device and the current through the collector resistor */
+    void convert(const AdcPair *pairs, size_t count, float *voltage, float *current) const;
+
+    /** base current of a base response in amps */
+    float baseCurrent(const AdcPair &pair) const;
+
+    static constexpr float c_adcVoltsPerCount = 5.0f / 256.0f / 1024.0f;
+
+protected:
+    /** the scalar kernel, also used for the tail of the SIMD kernels */
+    void convertScalar(const AdcPair *pairs, size_t count, float *voltage, float *current) const;
+
+    // calibrated counts are gain * raw + offset, they are subtracted
+    // before scaling to keep the precision of small differences.
+    float m_gain1;
+    float m_offset1;
+    float m_gain2;
+    float m_offset2;
+
+    float m_collectorAmpsPerCount;
+    float m_baseAmpsPerCount;
+};
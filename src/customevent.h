@@ -1,7 +1,8 @@
 #pragma once
 
 #include <string>
-#include <QEvent>
+#include <vector>
+#include <cstdint>
 
 struct SweepSetup
 {
@@ -9,12 +10,52 @@ struct SweepSetup
     float m_baseLimitResistor;  // in kilo ohms
     float m_collectorResistor;  // in kilo ohms
 
+    float m_adcGain[2];         // calibration of ADC channel 1 and 2
+    float m_adcOffset[2];       // in ADC counts, applied after the gain
+
     int32_t m_baseCurrentStart; // in microamps
     int32_t m_baseCurrentStop;  // in microamps
     uint32_t m_numberOfTraces;
+    bool    m_adaptiveSweep;    // refine the collector sweep where the curve bends
+
+    float   m_maxCurrent;       // sweep stop conditions in mA, V and mW, 0 = no limit
+    float   m_maxVoltage;
+    float   m_maxPower;
+
+    uint32_t m_maxTracesInMemory;   // persistence limit, 0 = no limit
+    uint32_t m_maxTraceMemory;      // persistence limit in megabytes, 0 = no limit
+
+    bool operator==(const SweepSetup &other) const
+    {
+        return (m_baseSenseResistor == other.m_baseSenseResistor) &&
+            (m_baseLimitResistor == other.m_baseLimitResistor) &&
+            (m_collectorResistor == other.m_collectorResistor) &&
+            (m_adcGain[0] == other.m_adcGain[0]) && (m_adcGain[1] == other.m_adcGain[1]) &&
+            (m_adcOffset[0] == other.m_adcOffset[0]) && (m_adcOffset[1] == other.m_adcOffset[1]) &&
+            (m_baseCurrentStart == other.m_baseCurrentStart) &&
+            (m_baseCurrentStop == other.m_baseCurrentStop) &&
+            (m_numberOfTraces == other.m_numberOfTraces) &&
+            (m_adaptiveSweep == other.m_adaptiveSweep) &&
+            (m_maxCurrent == other.m_maxCurrent) &&
+            (m_maxVoltage == other.m_maxVoltage) &&
+            (m_maxPower == other.m_maxPower) &&
+            (m_maxTracesInMemory == other.m_maxTracesInMemory) &&
+            (m_maxTraceMemory == other.m_maxTraceMemory);
+    }
+
+    /** true if both setups convert raw samples to the same values */
+    bool sameConversion(const SweepSetup &other) const
+    {
+        return (m_baseSenseResistor == other.m_baseSenseResistor) &&
+            (m_baseLimitResistor == other.m_baseLimitResistor) &&
+            (m_collectorResistor == other.m_collectorResistor) &&
+            (m_adcGain[0] == other.m_adcGain[0]) && (m_adcGain[1] == other.m_adcGain[1]) &&
+            (m_adcOffset[0] == other.m_adcOffset[0]) && (m_adcOffset[1] == other.m_adcOffset[1]);
+    }
 };
 
-class DataEvent : public QEvent
+/** kinds of data reported by SerialCtrl */
+class DataEvent
 {
 public:
 
@@ -25,26 +66,81 @@ public:
         Collector,
         Diode,
         StartSweep,
-        EndSweep
+        EndSweep,       // v1 is a SerialCtrl::SweepStop
+        BaseSearch      // result of SerialCtrl::seekBaseCurrent()
     };
+};
 
-    DataEvent(const std::string &data, DataType type)
-        : QEvent(QEvent::User), m_data(data), m_type(type)
+/** raw ADC values of a single tracer response */
+struct AdcPair
+{
+    int32_t m_v1;
+    int32_t m_v2;
+};
+
+/** a contiguous block of tracer responses of a single data type,
+    typically a sweep or part of one. The block can be cleared and
+    refilled without releasing its memory. */
+class DataBlock
+{
+public:
+    DataBlock(DataEvent::DataType type = DataEvent::DataType::Unknown)
+        : m_type(type)
     {
 
     }
 
-    const std::string data() const
+    DataEvent::DataType dataType() const
     {
-        return m_data;
+        return m_type;
     }
 
-    DataType dataType() const
+    void setDataType(DataEvent::DataType type)
     {
-        return m_type;
+        m_type = type;
+    }
+
+    void reserve(size_t capacity)
+    {
+        m_pairs.reserve(capacity);
+    }
+
+    void append(int32_t v1, int32_t v2)
+    {
+        m_pairs.push_back(AdcPair{v1, v2});
+    }
+
+    /** remove all pairs, keeps the allocated memory */
+    void clear()
+    {
+        m_pairs.clear();
+    }
+
+    bool empty() const
+    {
+        return m_pairs.empty();
+    }
+
+    size_t size() const
+    {
+        return m_pairs.size();
+    }
+
+    const AdcPair* data() const
+    {
+        return m_pairs.data();
     }
 
 private:
-    DataType    m_type;
-    std::string m_data;
+    DataEvent::DataType  m_type;
+    std::vector<AdcPair> m_pairs;
+};
+
+/** a parsed tracer response or sweep marker, passed from the
+    serial I/O thread to the GUI thread through a SpscRing */
+struct AdcSample
+{
+    DataEvent::DataType m_type;
+    int32_t m_v1;
+    int32_t m_v2;
 };
@@ -3,13 +3,20 @@
 #include <array>
 #include <cmath>
 #include <algorithm>
+#include <limits>
 #include <QPainter>
+#include <QDir>
+#include <QCoreApplication>
 
 #include "tracecolors.h"
 
 PlotRect::PlotRect()
 {
     m_plotRect = {0,0,0,0};
+    m_xmul = 1.0;
+    m_ymul = 1.0;
+    m_xoffset = 0.0;
+    m_yoffset = 0.0;
 }
 
 void PlotRect::setDataRect(const QRectF &dataRect)
@@ -28,29 +35,193 @@ void PlotRect::setPlotRect(const QRect &plotRect)
 }
 
 void PlotRect::plotData(QPainter &painter, 
-    const std::vector<QPointF> &data, const QColor &lineColor)
+    const float *x, const float *y, size_t count, const QColor &lineColor)
 {
-    if (data.size() <= 1)
+    if (count <= 1)
     {
         return;
     }
 
+    decimate(x, y, count);
+    drawScreenPoints(painter, lineColor);
+}
+
+void PlotRect::plotData(QPainter &painter,
+    const float *x, const float *y, size_t count,
+    const TraceLod &lod, const QColor &lineColor)
+{
+    if (count <= 1)
+    {
+        return;
+    }
+
+    if ((lod.numberOfLevels() == 0) || (lod.numberOfPoints() != count))
+    {
+        plotData(painter, x, y, count, lineColor);
+        return;
+    }
+
+    m_screenPoints.clear();
+    updateTransform();
+
+    // traverse the pyramid from its single top bucket
+    emitBucket(x, y, lod, lod.numberOfLevels()-1, 0);
+
+    drawScreenPoints(painter, lineColor);
+}
+
+void PlotRect::drawScreenPoints(QPainter &painter, const QColor &lineColor)
+{
     painter.setRenderHints(QPainter::Antialiasing);
     painter.setPen(QPen(lineColor, 3.0f));
+    painter.setBrush(Qt::NoBrush);
 
     painter.setClipRect(m_plotRect);
     painter.setClipping(true);
 
-    auto lineStart = graphToScreen(data.front());
-    for(const auto& p : data)
+    painter.drawPolyline(m_screenPoints.data(), static_cast<int>(m_screenPoints.size()));
+
+    painter.setClipping(false);
+}
+
+void PlotRect::updateTransform()
+{
+    m_xmul = static_cast<double>(m_plotRect.width()) / m_dataRect.width();
+    m_ymul = static_cast<double>(m_plotRect.height()) / m_dataRect.height();
+    m_xoffset = m_plotRect.left() - m_dataRect.left() * m_xmul;
+    m_yoffset = m_plotRect.bottom() + m_dataRect.top() * m_ymul;
+}
+
+void PlotRect::decimate(const float *x, const float *y, size_t count)
+{
+    m_screenPoints.clear();
+
+    // calculate the transform once for all points
+    updateTransform();
+
+    // a run is a sequence of consecutive points in the same pixel column.
+    // for every run we emit the first, minimum, maximum and last point
+    // in the order they occurred so the shape of the trace is preserved.
+    struct
+    {
+        int64_t m_column;
+        size_t  m_first;
+        size_t  m_last;
+        size_t  m_min;
+        size_t  m_max;
+        double  m_miny;
+        double  m_maxy;
+    } run;
+
+    auto emitRun = [&]()
+    {
+        std::array<size_t, 4> indices = {run.m_first, run.m_min, run.m_max, run.m_last};
+        std::sort(indices.begin(), indices.end());
+        auto end = std::unique(indices.begin(), indices.end());
+        for(auto iter = indices.begin(); iter != end; ++iter)
+        {
+            m_screenPoints.push_back(QPointF{m_xoffset + x[*iter] * m_xmul, m_yoffset - y[*iter] * m_ymul});
+        }
+    };
+
+    for(size_t i=0; i<count; i++)
+    {
+        const double sx = m_xoffset + x[i] * m_xmul;
+        const double sy = m_yoffset - y[i] * m_ymul;
+        const auto column = static_cast<int64_t>(std::floor(sx));
+
+        if ((i > 0) && (column == run.m_column))
+        {
+            run.m_last = i;
+            if (sy < run.m_miny)
+            {
+                run.m_miny = sy;
+                run.m_min  = i;
+            }
+            if (sy > run.m_maxy)
+            {
+                run.m_maxy = sy;
+                run.m_max  = i;
+            }
+        }
+        else
+        {
+            if (i > 0)
+            {
+                emitRun();
+            }
+
+            run.m_column = column;
+            run.m_first  = i;
+            run.m_last   = i;
+            run.m_min    = i;
+            run.m_max    = i;
+            run.m_miny   = sy;
+            run.m_maxy   = sy;
+        }
+    }
+
+    emitRun();
+}
+
+void PlotRect::emitBucket(const float *x, const float *y, const TraceLod &lod,
+    size_t level, size_t index)
+{
+    const auto &bucket = lod.level(level)[index];
+
+    auto emitPoint = [&](uint32_t i)
+    {
+        m_screenPoints.push_back(QPointF{m_xoffset + x[i] * m_xmul, m_yoffset - y[i] * m_ymul});
+    };
+
+    const double x0 = m_xoffset + bucket.m_minx * m_xmul;
+    const double x1 = m_xoffset + bucket.m_maxx * m_xmul;
+    const double y0 = m_yoffset - bucket.m_maxy * m_ymul;
+    const double y1 = m_yoffset - bucket.m_miny * m_ymul;
+
+    const bool visible = (x1 >= m_plotRect.left()) && (x0 <= m_plotRect.right()) &&
+        (y1 >= m_plotRect.top()) && (y0 <= m_plotRect.bottom());
+
+    if (!visible)
     {
-        auto lineEnd = graphToScreen(p);
+        // all segments inside the bucket are outside the
+        // plot, only the ones that enter and leave it matter.
+        emitPoint(bucket.m_first);
+        if (bucket.m_last != bucket.m_first)
+        {
+            emitPoint(bucket.m_last);
+        }
+        return;
+    }
+
+    if (((x1 - x0) <= 1.0) || ((y1 - y0) <= 1.0))
+    {
+        // the bucket covers a single pixel column or row:
+        // its first, extremes and last point are enough.
+        std::array<uint32_t, 4> indices = {bucket.m_first, bucket.m_min, bucket.m_max, bucket.m_last};
+        std::sort(indices.begin(), indices.end());
+        auto end = std::unique(indices.begin(), indices.end());
+        for(auto iter = indices.begin(); iter != end; ++iter)
+        {
+            emitPoint(*iter);
+        }
+        return;
+    }
 
-        painter.drawLine(lineStart, lineEnd);
-        lineStart = lineEnd;
+    if (level == 0)
+    {
+        for(uint32_t i = bucket.m_first; i <= bucket.m_last; i++)
+        {
+            emitPoint(i);
+        }
+        return;
     }
 
-    painter.setClipping(false);
+    const auto &children = lod.level(level-1);
+    for(size_t child = index*2; (child < index*2+2) && (child < children.size()); child++)
+    {
+        emitBucket(x, y, lod, level-1, child);
+    }
 }
 
 void PlotRect::clearRect(QPainter &painter)
@@ -76,19 +247,47 @@ QPointF PlotRect::graphToScreen(const QPointF &p) const
     return QPointF{x,y};
 }
 
+QPointF PlotRect::scale() const
+{
+    return QPointF{
+        m_plotRect.width() / m_dataRect.width(),
+        m_plotRect.height() / m_dataRect.height()
+    };
+}
+
 QPointF PlotRect::screenToGraph(const QPointF &p) const
 {
     const float xmul = static_cast<float>(m_plotRect.width()) / m_dataRect.width();
     const float ymul = static_cast<float>(m_plotRect.height()) / m_dataRect.height();
 
     float x = (p.x() - m_plotRect.left()) / xmul + m_dataRect.left();
-    float y = (p.y() + m_plotRect.bottom()) / ymul + m_dataRect.top();
+    float y = (m_plotRect.bottom() - p.y()) / ymul + m_dataRect.top();
 
     return QPointF{x,y};    
 }
 
 Graph::Graph(QWidget *parent) : QWidget(parent)
 {
+    m_axesLayerValid  = false;
+    m_traceLayerValid = false;
+
+    m_redrawTimer = new QTimer(this);
+    m_redrawTimer->setSingleShot(true);
+    connect(m_redrawTimer, &QTimer::timeout, this, &Graph::onRedrawTimer);
+    setMaxFrameRate(60);
+
+    m_pendingPoints = 0;
+    m_frameStats = FrameStats{};
+    m_setup = SweepSetup{};
+
+    // traces beyond the limits end up here
+    auto spillFilename = QDir::temp().filePath(
+        QString::asprintf("postracer-%lld.spill", QCoreApplication::applicationPid()));
+    if (!m_store.setSpillFile(spillFilename.toStdString()))
+    {
+        std::cout << "Cannot create spill file " << spillFilename.toStdString() << "\n";
+    }
+
     clearData();
 
     m_graphMargins.m_left   = 80;
@@ -110,90 +309,347 @@ Graph::Graph(QWidget *parent) : QWidget(parent)
 
 void Graph::clearData()
 {
-    std::unique_lock<std::mutex>(m_mutex);
-
     m_dataExtents.clear();
     m_traces.clear();
+    m_store.clear();
     m_labels.clear();
     m_selectedTrace = -1;
+    m_autoScale = true;
+    invalidateLayers(true);
+    m_dirtyRect = rect();
+    scheduleRedraw();
 }
 
 size_t Graph::newTrace()
 {
-    std::unique_lock<std::mutex>(m_mutex);
     m_traces.emplace_back();
+
+    const auto firstResident = m_store.firstResident();
+    m_store.newTrace(m_setup);
     std::cout << "new trace created\n";
 
-    size_t colorIndex = (m_traces.size()-1) % gs_traceColors.size();
-    m_traces.back().m_color = gs_traceColors.at(colorIndex);
+    if (m_store.firstResident() != firstResident)
+    {
+        // the oldest traces were spilled, they don't need
+        // their caches and disappear from the plot
+        for(size_t i=firstResident; i<m_store.firstResident(); i++)
+        {
+            if (!m_store.isAvailable(i))
+            {
+                m_traces[i].m_lod.clear();
+                m_traces[i].m_index.clear();
+            }
+        }
+        invalidateLayers(false);
+        m_dirtyRect = rect();
+        scheduleRedraw();
+    }
+
+    m_traces.back().m_colorIndex = static_cast<uint8_t>((m_traces.size()-1) % gs_traceColors.size());
     m_traces.back().m_visible = true;
+    m_traces.back().m_renderedPoints = 0;
 
     return m_traces.size();
 }
 
+void Graph::selectTrace(int32_t trace)
+{
+    m_selectedTrace = trace;
+
+    if ((trace >= 0) && (static_cast<size_t>(trace) < m_traces.size()) && !m_store.isAvailable(trace))
+    {
+        // the trace was spilled to disk, page it in.
+        // it replaces the trace that was paged in before.
+        const auto previous = m_store.pagedTrace();
+        if (previous != TraceStore::c_noTrace)
+        {
+            m_traces[previous].m_index.clear();
+        }
+
+        if (m_store.pageIn(trace))
+        {
+            m_traces[trace].m_index.update(m_store.x(trace), m_store.y(trace), m_store.size(trace));
+        }
+        invalidateLayers(false);
+    }
+
+    update();
+}
+
+bool Graph::openArchive(const QString &filename)
+{
+    auto archive = std::make_shared<TraceArchive>();
+    if (!archive->open(filename))
+    {
+        return false;
+    }
+
+    clearData();
+
+    m_store.attachArchive(archive);
+    m_traces.resize(m_store.numberOfTraces());
+
+    // the extents come from the record headers, the
+    // samples are only read when a trace is paged in.
+    bool first = true;
+    for(size_t i=0; i<m_traces.size(); i++)
+    {
+        auto &trace = m_traces[i];
+        trace.m_colorIndex = static_cast<uint8_t>(i % gs_traceColors.size());
+        trace.m_visible = true;
+        trace.m_renderedPoints = m_store.size(i);
+
+        if (m_store.size(i) == 0)
+        {
+            continue;
+        }
+
+        const auto bounds = archive->bounds(i);
+        const float x[2] = {static_cast<float>(bounds.left()), static_cast<float>(bounds.right())};
+        const float y[2] = {static_cast<float>(bounds.top()), static_cast<float>(bounds.bottom())};
+        if (first)
+        {
+            m_dataExtents.m_minx = m_dataExtents.m_maxx = x[0];
+            m_dataExtents.m_miny = m_dataExtents.m_maxy = y[0];
+            first = false;
+        }
+        growExtents(x, y, 2);
+    }
+
+    autoScaleDataRect();
+    invalidateLayers(true);
+    m_dirtyRect = rect();
+    scheduleRedraw();
+    return true;
+}
+
+void Graph::setTraceLimits(size_t maxTraces, size_t maxBytes)
+{
+    m_store.setLimits(maxTraces, maxBytes);
+}
+
+QColor Graph::traceColor(size_t trace) const
+{
+    return gs_traceColors.at(m_traces.at(trace).m_colorIndex);
+}
+
 size_t Graph::getNumberOfTraces() const
 {
-    std::unique_lock<std::mutex>(m_mutex);
     return m_traces.size();
 }
 
+std::vector<TraceSnapshotPtr> Graph::snapshot() const
+{
+    std::vector<TraceSnapshotPtr> traces;
+    traces.reserve(m_store.numberOfTraces());
+    for(size_t trace=0; trace<m_store.numberOfTraces(); trace++)
+    {
+        traces.push_back(m_store.snapshot(trace));
+    }
+    return traces;
+}
+
 
-void Graph::addLabel(const QString &txt, const QPointF &p)
+void Graph::addLabel(const QString &txt, size_t trace)
 {
-    m_labels.push_back(LabelType{.m_txt = txt, .m_pos = p});
+    m_labels.push_back(LabelType{.m_txt = txt, .m_trace = trace});
+    invalidateLayers(false);
+    m_dirtyRect = rect();
+    scheduleRedraw();
 }
 
-void Graph::addDataPoint(const QPointF &p)
+void Graph::clearLabels()
 {
-    std::unique_lock<std::mutex>(m_mutex);
+    m_labels.clear();
+    invalidateLayers(false);
+    m_dirtyRect = rect();
+    scheduleRedraw();
+}
+
+void Graph::setTraceBase(size_t trace, const AdcPair &base)
+{
+    m_store.setBase(trace, base);
+}
+
+void Graph::setSweepSetup(const SweepSetup &setup)
+{
+    m_setup = setup;
+
     if (m_traces.empty())
     {
-        m_dataExtents.m_minx = p.x();
-        m_dataExtents.m_maxx = p.x();
-        m_dataExtents.m_miny = p.y();
-        m_dataExtents.m_maxy = p.y();                
+        return;
+    }
+
+    // derive the traces again from the raw samples when the
+    // conversion changed, the caches depend on the derived values.
+    if (!m_store.setSetup(setup))
+    {
+        return;
+    }
+
+    bool first = true;
+    for(size_t i=0; i<m_traces.size(); i++)
+    {
+        auto &trace = m_traces[i];
+        trace.m_lod.clear();
+        trace.m_index.clear();
+        if (!m_store.isAvailable(i) || (m_store.size(i) == 0))
+        {
+            continue;
+        }
+
+        const auto x = m_store.x(i);
+        const auto y = m_store.y(i);
+        const auto n = m_store.size(i);
+        if (m_store.isResident(i))
+        {
+            trace.m_lod.update(x, y, n);
+        }
+        trace.m_index.update(x, y, n);
+
+        if (first)
+        {
+            m_dataExtents.m_minx = m_dataExtents.m_maxx = x[0];
+            m_dataExtents.m_miny = m_dataExtents.m_maxy = y[0];
+            first = false;
+        }
+        growExtents(x, y, n);
+    }
+
+    if (m_autoScale)
+    {
+        autoScaleDataRect();
+    }
+
+    invalidateLayers(true);
+    m_dirtyRect = rect();
+    scheduleRedraw();
+}
+
+void Graph::growExtents(const float *x, const float *y, size_t count)
+{
+    for(size_t i=0; i<count; i++)
+    {
+        m_dataExtents.m_maxx = std::max(x[i], m_dataExtents.m_maxx);
+        m_dataExtents.m_maxy = std::max(y[i], m_dataExtents.m_maxy);
+        m_dataExtents.m_minx = std::min(x[i], m_dataExtents.m_minx);
+        m_dataExtents.m_miny = std::min(y[i], m_dataExtents.m_miny);
+    }
+}
+
+void Graph::addSamples(const AdcPair *pairs, size_t count)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    const bool firstTrace = m_traces.empty();
+    if (firstTrace)
+    {
         m_traces.emplace_back();
+        m_store.newTrace(m_setup);
+        m_traces.back().m_colorIndex = 0;
+        m_traces.back().m_visible = true;
+        m_traces.back().m_renderedPoints = 0;
     }
 
+    const size_t current = m_traces.size()-1;
     auto & currentCurve = m_traces.back();
 
-    if (currentCurve.m_data.empty())
+    const size_t previousCount = m_store.size(current);
+    m_store.append(pairs, count);
+
+    const auto x = m_store.x(current);
+    const auto y = m_store.y(current);
+    const auto n = m_store.size(current);
+    currentCurve.m_lod.update(x, y, n);
+    currentCurve.m_index.update(x, y, n);
+
+    if (firstTrace)
     {
-        currentCurve.m_data.push_back(p);
+        m_dataExtents.m_minx = m_dataExtents.m_maxx = x[0];
+        m_dataExtents.m_miny = m_dataExtents.m_maxy = y[0];
+    }
 
-        m_dataExtents.m_maxx = std::max(static_cast<float>(p.x()), m_dataExtents.m_maxx);
-        m_dataExtents.m_maxy = std::max(static_cast<float>(p.y()), m_dataExtents.m_maxy);
-        m_dataExtents.m_minx = std::min(static_cast<float>(p.x()), m_dataExtents.m_minx);  
-        m_dataExtents.m_miny = std::min(static_cast<float>(p.y()), m_dataExtents.m_miny);  
+    auto oldExtents = m_dataExtents;
+    growExtents(x + previousCount, y + previousCount, count);
 
-        m_plotRect.setDataRect(
-            QRectF{
-                m_dataExtents.m_minx, m_dataExtents.m_miny,
-                (m_dataExtents.m_maxx - m_dataExtents.m_minx) * 1.1f,
-                (m_dataExtents.m_maxy - m_dataExtents.m_miny) * 1.1f
-            });
+    const bool extentsChanged = 
+        (oldExtents.m_minx != m_dataExtents.m_minx) || (oldExtents.m_maxx != m_dataExtents.m_maxx) ||
+        (oldExtents.m_miny != m_dataExtents.m_miny) || (oldExtents.m_maxy != m_dataExtents.m_maxy);
 
-        update();
+    if (extentsChanged && m_autoScale)
+    {
+        autoScaleDataRect();
+
+        // the view changed: everything must be redrawn
+        m_dirtyRect = rect();
     }
     else
     {
-        currentCurve.m_data.push_back(p);
-        m_dataExtents.m_maxx = std::max(static_cast<float>(p.x()), m_dataExtents.m_maxx);
-        m_dataExtents.m_maxy = std::max(static_cast<float>(p.y()), m_dataExtents.m_maxy);
-        m_dataExtents.m_minx = std::min(static_cast<float>(p.x()), m_dataExtents.m_minx);
-        m_dataExtents.m_miny = std::min(static_cast<float>(p.y()), m_dataExtents.m_miny);
+        // only the area covered by the new segments is dirty,
+        // the segment from the previous point must be redrawn too
+        const size_t first = (previousCount > 0) ? previousCount-1 : 0;
+        QRectF segments{m_plotRect.graphToScreen(QPointF{x[first], y[first]}), QSizeF{0,0}};
+        for(size_t i=first+1; i<n; i++)
+        {
+            auto sp = m_plotRect.graphToScreen(QPointF{x[i], y[i]});
+            segments.setLeft(std::min(segments.left(), sp.x()));
+            segments.setRight(std::max(segments.right(), sp.x()));
+            segments.setTop(std::min(segments.top(), sp.y()));
+            segments.setBottom(std::max(segments.bottom(), sp.y()));
+        }
 
-        m_plotRect.setDataRect(
-            QRectF{
-                m_dataExtents.m_minx, m_dataExtents.m_miny,
-                (m_dataExtents.m_maxx - m_dataExtents.m_minx) * 1.1f,
-                (m_dataExtents.m_maxy - m_dataExtents.m_miny) * 1.1f
-            });
+        // grow by the pen width
+        m_dirtyRect |= segments.toAlignedRect().adjusted(-3,-3,3,3);
+    }
+
+    m_pendingPoints += count;
+    scheduleRedraw();
+}
+
+void Graph::autoScaleDataRect()
+{
+    m_plotRect.setDataRect(
+        QRectF{
+            m_dataExtents.m_minx, m_dataExtents.m_miny,
+            (m_dataExtents.m_maxx - m_dataExtents.m_minx) * 1.1f,
+            (m_dataExtents.m_maxy - m_dataExtents.m_miny) * 1.1f
+        });
+}
+
+void Graph::scheduleRedraw()
+{
+    // redraws are rate limited: all points added
+    // before the timer expires end up in one frame.
+    if (!m_redrawTimer->isActive())
+    {
+        m_redrawTimer->start();
+    }
+}
 
-        update();        
+void Graph::onRedrawTimer()
+{
+    m_frameStats.m_frames++;
+    m_frameStats.m_points += m_pendingPoints;
+    m_frameStats.m_lastFramePoints = m_pendingPoints;
+    m_frameStats.m_maxFramePoints  = std::max(m_frameStats.m_maxFramePoints, m_pendingPoints);
+    m_pendingPoints = 0;
+
+    if (!m_dirtyRect.isEmpty())
+    {
+        update(m_dirtyRect);
+        m_dirtyRect = QRect();
     }
 }
 
+void Graph::setMaxFrameRate(uint32_t framesPerSecond)
+{
+    framesPerSecond = std::max(framesPerSecond, 1U);
+    m_redrawTimer->setInterval(static_cast<int>(1000 / framesPerSecond));
+}
+
 void Graph::resizeEvent(QResizeEvent *event)
 {
     QSize newSize = event->size();
@@ -213,34 +669,136 @@ void Graph::updatePlotRectSize()
 
 void Graph::paintEvent(QPaintEvent *event)
 {
+    updateLayers();
+
+    // only the cursor is drawn directly, everything
+    // else comes from the cached layers.
     QPainter painter(this);
-    painter.fillRect(rect(), Qt::black);
-    painter.setRenderHint(QPainter::Antialiasing);
+    painter.drawPixmap(0, 0, m_traceLayer);
 
-    m_plotRect.clearRect(painter);
-    
-    // plot axes
-    plotAxes(painter);
+    drawMarker(painter);
+}
 
-    // plot traces
-    for(auto const& trace : m_traces)
+void Graph::invalidateLayers(bool axes)
+{
+    if (axes)
     {
+        m_axesLayerValid = false;
+    }
+    m_traceLayerValid = false;
+}
+
+void Graph::updateLayers()
+{
+    const qreal pixelRatio = devicePixelRatioF();
+    const QSize layerSize = size() * pixelRatio;
+
+    // the axes depend on the data rect and the widget size
+    if ((m_axesLayer.size() != layerSize) || (m_plotRect.getDataRect() != m_layerDataRect))
+    {
+        invalidateLayers(true);
+    }
+
+    if (!m_axesLayerValid)
+    {
+        m_axesLayer = QPixmap(layerSize);
+        m_axesLayer.setDevicePixelRatio(pixelRatio);
+
+        QPainter painter(&m_axesLayer);
+        painter.setFont(font());
+        painter.fillRect(rect(), Qt::black);
+        painter.setRenderHint(QPainter::Antialiasing);
+
+        m_plotRect.clearRect(painter);
+        plotAxes(painter);
+
+        m_layerDataRect  = m_plotRect.getDataRect();
+        m_axesLayerValid = true;
+    }
+
+    if (!m_traceLayerValid)
+    {
+        m_traceLayer = m_axesLayer.copy();
+        m_traceLayer.setDevicePixelRatio(pixelRatio);
+
+        QPainter painter(&m_traceLayer);
+        painter.setFont(font());
+
+        for(size_t i=0; i<m_traces.size(); i++)
+        {
+            auto &trace = m_traces[i];
+            if (trace.m_visible && m_store.isAvailable(i))
+            {
+                m_plotRect.plotData(painter, m_store.x(i), m_store.y(i), m_store.size(i),
+                    trace.m_lod, gs_traceColors.at(trace.m_colorIndex));
+            }
+            trace.m_renderedPoints = m_store.size(i);
+        }
+
+        plotOverlay(painter);
+
+        m_traceLayerValid = true;
+    }
+    else
+    {
+        appendToTraceLayer();
+    }
+}
+
+void Graph::appendToTraceLayer()
+{
+    // mouse moves don't add data, don't bother starting a painter
+    bool pending = false;
+    for(size_t i=0; i<m_traces.size(); i++)
+    {
+        pending |= m_store.isResident(i) && (m_traces[i].m_renderedPoints < m_store.size(i));
+    }
+
+    if (!pending)
+    {
+        return;
+    }
+
+    QPainter painter(&m_traceLayer);
+    painter.setFont(font());
+
+    bool appended = false;
+    for(size_t i=0; i<m_traces.size(); i++)
+    {
+        auto &trace = m_traces[i];
+        const size_t count = m_store.size(i);
+        if ((trace.m_renderedPoints >= count) || !m_store.isResident(i))
+        {
+            continue;
+        }
+
         if (trace.m_visible)
         {
-            m_plotRect.plotData(painter, trace.m_data, trace.m_color);
+            // start at the last point drawn so the new segments connect
+            const size_t first = (trace.m_renderedPoints > 0) ? trace.m_renderedPoints-1 : 0;
+            m_plotRect.plotData(painter, m_store.x(i) + first, m_store.y(i) + first, count - first,
+                gs_traceColors.at(trace.m_colorIndex));
+            appended = true;
         }
+        trace.m_renderedPoints = count;
     }
 
+    // keep the outline and labels on top of the new segments
+    if (appended)
+    {
+        plotOverlay(painter);
+    }
+}
+
+void Graph::plotOverlay(QPainter &painter)
+{
     m_plotRect.drawOutline(painter);
-    
     plotLabels(painter);
-
-    drawMarker(painter);
 }
 
 void Graph::drawMarker(QPainter &painter)
 {
-    if ((!m_cursorPos.isNull()) && (m_selectedTrace >=0) && (m_selectedTrace < m_traces.size()))
+    if (!m_cursorPos.isNull())
     {
         QPen cursorPen;
         cursorPen.setStyle(Qt::DashDotLine);
@@ -248,28 +806,26 @@ void Graph::drawMarker(QPainter &painter)
         
         auto graphPos = m_plotRect.screenToGraph(m_cursorPos);
 
-        auto const& trace = m_traces.at(m_selectedTrace);
-
-        if (!trace.m_data.empty())
+        // snap to the nearest point of all visible traces,
+        // the distance is measured in pixels.
+        const auto scale = m_plotRect.scale();
+        size_t nearestTrace = m_traces.size();
+        uint32_t nearestIndex = 0;
+        double distance2 = std::numeric_limits<double>::max();
+        for(size_t i=0; i<m_traces.size(); i++)
         {
-            auto iter = std::lower_bound(
-                trace.m_data.begin(), 
-                trace.m_data.end(), 
-                graphPos,           
-                [](const QPointF &lhs, const QPointF &rhs) -> bool
-                    {
-                        return lhs.x() < rhs.x();
-                    }
-                );
-
-            // if we're past the end of the data array
-            // take the last point
-            if (iter == trace.m_data.end())
+            auto const& trace = m_traces[i];
+            if (trace.m_visible && trace.m_index.nearest(graphPos, scale.x(), scale.y(), nearestIndex, distance2))
             {
-                iter = trace.m_data.begin() + trace.m_data.size()-1;
+                nearestTrace = i;
             }
+        }
+
+        if (nearestTrace < m_traces.size())
+        {
+            const auto nearest = m_store.point(nearestTrace, nearestIndex);
 
-            auto nearestPos = m_plotRect.graphToScreen(QPointF{iter->x(), iter->y()});
+            auto nearestPos = m_plotRect.graphToScreen(nearest);
             painter.setPen(cursorPen);
             painter.drawLine(nearestPos.x(), m_graphMargins.m_top, nearestPos.x(), height() - m_graphMargins.m_bottom - 1);
             painter.drawLine(m_graphMargins.m_left, nearestPos.y(), width() - m_graphMargins.m_right - 1, nearestPos.y());
@@ -277,7 +833,7 @@ void Graph::drawMarker(QPainter &painter)
             auto textPos = nearestPos;
             textPos += QPoint(10, -10);
 
-            auto txt = QString::asprintf("%.3f (V), %.2f (mA)", iter->x(), iter->y() * 1000.0f);
+            auto txt = QString::asprintf("%.3f (V), %.2f (mA)", nearest.x(), nearest.y() * 1000.0f);
 
             QFontMetrics fontMetrics(font());
             auto textBox = fontMetrics.boundingRect(txt);
@@ -308,8 +864,14 @@ void Graph::plotLabels(QPainter &painter)
     painter.setRenderHints(QPainter::RenderHint::Antialiasing);
     for(auto const& label : m_labels)
     {
+        // labels follow the end of their trace
+        if (!m_store.isAvailable(label.m_trace) || (m_store.size(label.m_trace) == 0))
+        {
+            continue;
+        }
+
         auto bb = fm.boundingRect(label.m_txt);
-        auto pos = m_plotRect.graphToScreen( QPointF{label.m_pos.x(), label.m_pos.y()} );
+        auto pos = m_plotRect.graphToScreen(m_store.point(label.m_trace, m_store.size(label.m_trace)-1));
         pos += QPointF{8,0};
 
         painter.drawRoundedRect(bb.adjusted(pos.x()-4, pos.y()-4, pos.x()+4, pos.y()+4), 4, 4);
@@ -319,8 +881,10 @@ void Graph::plotLabels(QPainter &painter)
 
 void Graph::plotAxes(QPainter &painter)
 {
-    float xspan = m_dataExtents.xspan();
-    float yspan = m_dataExtents.yspan();
+    // ticks follow the visible part of the data
+    const auto dataRect = m_plotRect.getDataRect();
+    float xspan = dataRect.width();
+    float yspan = dataRect.height();
 
     if ((xspan < 1e-20f) || (yspan < 1e-20f))
     {
@@ -371,7 +935,10 @@ void Graph::plotAxes(QPainter &painter)
 
     QFontMetrics fm(font());
 
-    for(uint32_t x=0; x<xticks; x++)
+    const auto xfirst = static_cast<int64_t>(std::ceil(dataRect.left() / xunit));
+    const auto yfirst = static_cast<int64_t>(std::ceil(dataRect.top() / yunit));
+
+    for(int64_t x=xfirst; x<=xfirst+xticks; x++)
     {   
         auto const pos = m_plotRect.graphToScreen( QPointF{x*xunit, 0} );
 
@@ -399,7 +966,7 @@ void Graph::plotAxes(QPainter &painter)
         painter.drawText(txtpos, txt);
     }
 
-    for(uint32_t y=0; y<yticks; y++)
+    for(int64_t y=yfirst; y<=yfirst+yticks; y++)
     {   
         auto const pos = m_plotRect.graphToScreen( QPointF{0,y*yunit} );
 
@@ -409,6 +976,12 @@ void Graph::plotAxes(QPainter &painter)
             continue;
         }
 
+        // dont plot ticks that in the bottom margin
+        if (pos.y() > m_plotRect.bottom())
+        {
+            continue;
+        }
+
         painter.setPen(QPen(QColor("#505050"), 2.0f, Qt::PenStyle::DashDotDotLine));
         painter.drawLine(m_graphMargins.m_left, pos.y(), width()-1-m_graphMargins.m_right, pos.y());
 
@@ -480,13 +1053,14 @@ void Graph::mouseMoveEvent(QMouseEvent *event)
     {
         auto offset = m_plotRect.screenToGraph(m_mouseDownPos) - m_plotRect.screenToGraph(event->pos());
         auto newDataRect = m_dataRectStartDrag;
-        newDataRect.adjust(offset.x(), -offset.y(), offset.x(), -offset.y());
+        newDataRect.adjust(offset.x(), offset.y(), offset.x(), offset.y());
         m_plotRect.setDataRect(newDataRect);
+        m_autoScale = false;
         update();
     }
     else    
     {
-        if ((m_selectedTrace < 0) || (m_selectedTrace >= m_traces.size()))
+        if (m_traces.empty())
         {
             if (!m_cursorPos.isNull())
             {
@@ -503,46 +1077,36 @@ void Graph::mouseMoveEvent(QMouseEvent *event)
 
 void Graph::wheelEvent(QWheelEvent *event)
 {
-    //QPoint numPixels = event->pixelDelta();
     QPoint numDegrees = event->angleDelta() / 8;
 
-    //auto mouseChipPos = screenToGraph(event->pos());
-
-    if (numDegrees.y() > 0)
+    if (numDegrees.y() != 0)
     {
-        // limit zoom level to 50
-        //m_zoomLevel = std::min(m_zoomLevel+1, 50);
-        //auto llx = mouseChipPos.x() - ((mouseChipPos.x() - m_graphViewport.m_xstart) * 80 / 100);
-        //auto lly = mouseChipPos.y() - ((mouseChipPos.y() - m_graphViewport.m_ystart) * 80 / 100);
-        //auto urx = mouseChipPos.x() + ((m_graphViewport.m_xstart+m_graphViewport.m_xspan - mouseChipPos.x()) * 80 / 100);
-        //auto ury = mouseChipPos.y() + ((m_graphViewport.m_ystart+m_graphViewport.m_yspan - mouseChipPos.y()) * 80 / 100);
-
-        //m_graphViewport.m_xstart = llx;
-        //m_graphViewport.m_ystart = lly;
+        // zoom 20% per wheel step of 15 degrees while
+        // keeping the data under the cursor in place.
+        const double zoom = std::pow(0.8, numDegrees.y() / 15.0);
+        const auto anchor = m_plotRect.screenToGraph(event->position());
+        const auto dataRect = m_plotRect.getDataRect();
 
-        //m_graphViewport.m_xspan = urx - llx;
-        //m_graphViewport.m_yspan = ury - lly;
+        m_plotRect.setDataRect(
+            QRectF{
+                anchor.x() - (anchor.x() - dataRect.left()) * zoom,
+                anchor.y() - (anchor.y() - dataRect.top()) * zoom,
+                dataRect.width() * zoom,
+                dataRect.height() * zoom
+            });
 
-        update();   
+        m_autoScale = false;
+        update();
     }
-    else if (numDegrees.y() < 0)
-    {
-        // limit zoom level to 1
-        //m_zoomLevel = std::max(m_zoomLevel-1, 1);    
-
-        //auto llx = mouseChipPos.x() - ((mouseChipPos.x() - m_graphViewport.m_xstart) * 100 / 80);
-        //auto lly = mouseChipPos.y() - ((mouseChipPos.y() - m_graphViewport.m_ystart) * 100 / 80);
-        //auto urx = mouseChipPos.x() + ((m_graphViewport.m_xstart+m_graphViewport.m_xspan - mouseChipPos.x()) * 100 / 80);
-        //auto ury = mouseChipPos.y() + ((m_graphViewport.m_ystart+m_graphViewport.m_yspan - mouseChipPos.y()) * 100 / 80);
-
-        //m_graphViewport.m_xstart = llx;
-        //m_graphViewport.m_ystart = lly;
-
-        //m_graphViewport.m_xspan = urx - llx;
-        //m_graphViewport.m_yspan = ury - lly;
 
-        update();        
-    }    
+    event->accept();
+}
 
+void Graph::mouseDoubleClickEvent(QMouseEvent *event)
+{
+    // back to showing all data
+    m_autoScale = true;
+    autoScaleDataRect();
+    update();
     event->accept();
-}
\ No newline at end of file
+}
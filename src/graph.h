@@ -1,9 +1,14 @@
 #pragma once
 
-#include <mutex>
 #include <vector>
 #include <QWidget>
 #include <QMouseEvent>
+#include <QTimer>
+#include <QPixmap>
+
+#include "tracelod.h"
+#include "pointindex.h"
+#include "tracestore.h"
 
 /** helper class that plots a data traces */
 class PlotRect
@@ -18,13 +23,28 @@ public:
     void clearRect(QPainter &painter);
     void drawOutline(QPainter &painter);
 
+    /** plot a trace as a single polyline. Consecutive points that
+        fall in the same pixel column are reduced to the first, last,
+        minimum and maximum point so the number of vertices is bounded
+        by the plot width rather than the number of data points. */
     void plotData(QPainter &painter,
-        const std::vector<QPointF> &data, 
+        const float *x, const float *y, size_t count,
+        const QColor &lineColor);
+
+    /** plot a trace using its level-of-detail pyramid. Only buckets
+        that are visible and wider than a pixel are refined, so the
+        cost is bounded at any zoom level. */
+    void plotData(QPainter &painter,
+        const float *x, const float *y, size_t count,
+        const TraceLod &lod,
         const QColor &lineColor);
 
     QPointF graphToScreen(const QPointF &p) const;
     QPointF screenToGraph(const QPointF &p) const;
 
+    /** pixels per data unit in x and y */
+    QPointF scale() const;
+
     constexpr auto top() const
     {
         return m_plotRect.top();
@@ -47,46 +67,109 @@ public:
 
 protected:
 
+    /** transform data to screen coordinates and decimate
+        to min/max per pixel column into m_screenPoints */
+    void decimate(const float *x, const float *y, size_t count);
+
+    /** emit the vertices of a pyramid bucket into m_screenPoints */
+    void emitBucket(const float *x, const float *y, const TraceLod &lod,
+        size_t level, size_t index);
+
+    /** calculate the data to screen transform for bulk conversions */
+    void updateTransform();
+
+    void drawScreenPoints(QPainter &painter, const QColor &lineColor);
+
     QRectF  m_dataRect;
     QRect   m_plotRect;
-};
 
+    // screen = offset + data * mul, y flipped
+    double  m_xmul;
+    double  m_ymul;
+    double  m_xoffset;
+    double  m_yoffset;
+
+    std::vector<QPointF> m_screenPoints;    // re-used to avoid allocations
+};
 
+/** curve tracer plot. Like all widgets it must only be used from
+    the GUI thread, other threads use snapshot() to get the traces. */
 class Graph : public QWidget
 {
 public:
     Graph(QWidget *parent = 0);
 
+    /** repaint statistics, used to check how well
+        incoming points are coalesced into frames */
+    struct FrameStats
+    {
+        uint64_t m_frames;          // number of frames drawn because of new data
+        uint64_t m_points;          // total number of points absorbed by those frames
+        size_t   m_lastFramePoints; // points absorbed by the last frame
+        size_t   m_maxFramePoints;  // maximum number of points absorbed by a frame
+    };
+
     void clearData();
     
     /** creates a new trace and return the total number of traces */
     size_t newTrace();
 
-    void addDataPoint(const QPointF &p);
-    void addLabel(const QString &txt, const QPointF &p);
+    /** add a block of raw samples to the current trace,
+        they are converted with the current sweep setup */
+    void addSamples(const AdcPair *pairs, size_t count);
+
+    /** set the sweep setup used for new traces. the measured
+        traces are derived again if the resistors or the ADC
+        calibration changed, see TraceStore::setSetup(). */
+    void setSweepSetup(const SweepSetup &setup);
+
+    /** remember the base measurement of a trace */
+    void setTraceBase(size_t trace, const AdcPair &base);
+
+    /** limit the rate at which new data is redrawn, default 60 fps */
+    void setMaxFrameRate(uint32_t framesPerSecond);
+
+    const FrameStats& frameStats() const noexcept
+    {
+        return m_frameStats;
+    }
+    /** add a label at the end of a trace */
+    void addLabel(const QString &txt, size_t trace);
+    void clearLabels();
 
     void mousePressEvent(QMouseEvent *event) override;
     void mouseReleaseEvent(QMouseEvent *event) override;
     void mouseMoveEvent(QMouseEvent *event) override;
     void wheelEvent(QWheelEvent *event) override;
+    void mouseDoubleClickEvent(QMouseEvent *event) override;
 
     void resizeEvent(QResizeEvent *event) override;
 
-    void selectTrace(int32_t trace)
-    {
-        m_selectedTrace = trace;
-        update();
-    }
+    /** select a trace, a trace that was spilled to disk is paged back in */
+    void selectTrace(int32_t trace);
+
+    /** replace all traces by the traces of an archive, they
+        are paged in when selected. returns false on error. */
+    bool openArchive(const QString &filename);
+
+    /** limit the traces kept in memory, see TraceStore::setLimits() */
+    void setTraceLimits(size_t maxTraces, size_t maxBytes);
 
-    /** get number of traces - thread safe */
+    /** get number of traces */
     size_t getNumberOfTraces() const;
 
-    /** direct access to traces - not thread safe */
-    auto const& traces() const
+    /** colour used to draw a trace */
+    QColor traceColor(size_t trace) const;
+
+    /** direct access to the trace samples */
+    const TraceStore& traceStore() const noexcept
     {
-        return m_traces;
+        return m_store;
     }
 
+    /** immutable copies of all traces for use on other threads */
+    std::vector<TraceSnapshotPtr> snapshot() const;
+
 protected:
     void paintEvent(QPaintEvent *event) override;
 
@@ -95,20 +178,49 @@ protected:
     void drawMarker(QPainter &painter);
     void updatePlotRectSize();
 
+    /** fit the data rect to the data extents */
+    void autoScaleDataRect();
+
+    /** include points in the data extents */
+    void growExtents(const float *x, const float *y, size_t count);
+
+    /** redraw the cached layers that are out of date.
+        changes of the data rect or widget size are detected here,
+        changes to the data must be reported with invalidateLayers().
+        Points appended to a trace are drawn into the existing trace
+        layer, the cost doesn't depend on the length of the trace. */
+    void updateLayers();
+
+    /** draw the segments appended since the last frame into the trace layer */
+    void appendToTraceLayer();
+
+    /** draw the plot outline and labels on top of the traces */
+    void plotOverlay(QPainter &painter);
+    void invalidateLayers(bool axes);
+
+    /** request a repaint of m_dirtyRect at the next frame */
+    void scheduleRedraw();
+    void onRedrawTimer();
+
     struct LabelType
     {
         QString m_txt;
-        QPointF m_pos;
+        size_t  m_trace;    // the label is drawn at the end of the trace
     };
 
+    /** per trace state, the samples of trace i are in m_store */
     struct TraceType
     {
-        std::vector<QPointF> m_data;
-        QColor               m_color;
+        uint8_t              m_colorIndex;      // into gs_traceColors
         bool                 m_visible;
+        size_t               m_renderedPoints;  // number of points drawn into the trace layer
+        TraceLod             m_lod;
+        PointIndex           m_index;   // for the cursor
     };
 
     std::vector<TraceType> m_traces;
+    TraceStore             m_store;
+    SweepSetup             m_setup;     // used to convert new traces
     std::vector<LabelType> m_labels;
     
     PlotRect m_plotRect;
@@ -160,5 +272,16 @@ protected:
     QPoint      m_cursorPos;
 
     QRectF      m_dataRectStartDrag;
-    std::mutex m_mutex;
+    bool        m_autoScale;        // follow the data extents, off after a zoom or pan
+
+    QTimer      *m_redrawTimer;
+    QRect       m_dirtyRect;        // area to repaint at the next frame
+    size_t      m_pendingPoints;    // points added since the last frame
+    FrameStats  m_frameStats;
+
+    QPixmap     m_axesLayer;        // background, grid and tick labels
+    QPixmap     m_traceLayer;       // axes layer with traces, outline and labels on top
+    QRectF      m_layerDataRect;    // data rect the layers were drawn with
+    bool        m_axesLayerValid;
+    bool        m_traceLayerValid;
 };
@@ -0,0 +1,311 @@
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <QCoreApplication>
+#include "conversion.h"
+#include "sweepplan.h"
+#include "headlessrunner.h"
+
+HeadlessRunner::HeadlessRunner(const Options &options)
+    : m_options(options), m_completedJobs(0), m_droppedSamples(0), m_finished(false)
+{
+    m_pollTimer = new QTimer(this);
+    connect(m_pollTimer, &QTimer::timeout, this, &HeadlessRunner::onPollTimer);
+}
+
+std::string HeadlessRunner::archiveName(const std::string &out, uint32_t job, uint32_t jobs)
+{
+    if (jobs <= 1)
+    {
+        return out;
+    }
+
+    // run.ptra -> run-1.ptra
+    const auto dot   = out.rfind('.');
+    const auto slash = out.find_last_of("/\\");
+    const bool hasExtension = (dot != std::string::npos) && ((slash == std::string::npos) || (dot > slash));
+    const auto stem = hasExtension ? out.substr(0, dot) : out;
+    const auto extension = hasExtension ? out.substr(dot) : std::string();
+    return stem + "-" + std::to_string(job+1) + extension;
+}
+
+void HeadlessRunner::start()
+{
+    // all tracers are opened before anything is swept, so a
+    // wrong port is reported before the first part is measured.
+    const auto serials = SerialCtrl::open(m_options.m_ports);
+    for(size_t i=0; i<serials.size(); i++)
+    {
+        auto tracer = std::make_unique<Tracer>();
+        tracer->m_port = m_options.m_ports[i];
+        tracer->m_serial.reset(serials[i]);
+        m_tracers.push_back(std::move(tracer));
+    }
+
+    for(const auto &tracer : m_tracers)
+    {
+        if (!tracer->m_serial)
+        {
+            std::cerr << "Cannot open serial port " << tracer->m_port << "\n";
+            finish(c_exitPortError);
+            return;
+        }
+    }
+
+    for(size_t job=0; job<m_options.m_jobs; job++)
+    {
+        m_pendingJobs.push_back(job);
+    }
+
+    m_runTimer.start();
+    dispatchJobs();
+    if (!m_finished)
+    {
+        m_pollTimer->start(10);
+    }
+}
+
+void HeadlessRunner::dispatchJobs()
+{
+    for(auto &tracer : m_tracers)
+    {
+        if (m_pendingJobs.empty())
+        {
+            return;
+        }
+
+        if (tracer->m_serial && (tracer->m_job == c_noJob))
+        {
+            const auto job = m_pendingJobs.front();
+            m_pendingJobs.pop_front();
+            if (!startJob(*tracer, job))
+            {
+                std::cerr << "Cannot create " << archiveName(m_options.m_out, job, m_options.m_jobs) << "\n";
+                finish(c_exitOutputError);
+                return;
+            }
+        }
+    }
+}
+
+bool HeadlessRunner::startJob(Tracer &tracer, size_t job)
+{
+    if (!tracer.m_writer.open(archiveName(m_options.m_out, job, m_options.m_jobs)))
+    {
+        return false;
+    }
+
+    tracer.m_job = job;
+    tracer.m_writtenTraces = 0;
+    tracer.m_hasBase = false;
+    tracer.m_baseSearchMeasurements = 0;
+    tracer.m_pairs.clear();
+
+    if (m_options.m_sweep == SweepType::Transistor)
+    {
+        tracer.m_expectedTraces = SweepPlan::queueTransistorSweep(*tracer.m_serial, m_options.m_setup);
+    }
+    else
+    {
+        tracer.m_expectedTraces = std::max(1U, m_options.m_setup.m_numberOfTraces);
+        for(uint32_t trace=0; trace<tracer.m_expectedTraces; trace++)
+        {
+            SweepPlan::queueDiodeSweep(*tracer.m_serial, m_options.m_setup);
+        }
+    }
+
+    std::cout << "Job " << job+1 << " on " << tracer.m_port << "\n";
+
+    tracer.m_idleTimer.start();
+    tracer.m_serial->run();
+    return true;
+}
+
+void HeadlessRunner::onPollTimer()
+{
+    for(auto &tracer : m_tracers)
+    {
+        if (!tracer->m_serial || (tracer->m_job == c_noJob))
+        {
+            continue;
+        }
+
+        AdcSample sample;
+        bool received = false;
+        while(tracer->m_serial && tracer->m_serial->samples().pop(sample))
+        {
+            received = true;
+            if (!handleSample(*tracer, sample))
+            {
+                return;
+            }
+        }
+
+        if (received)
+        {
+            tracer->m_idleTimer.restart();
+        }
+        else if (tracer->m_idleTimer.elapsed() > m_options.m_timeoutMs)
+        {
+            std::cerr << "Tracer " << tracer->m_port << " stopped responding\n";
+            dropTracer(*tracer);
+            if (m_finished)
+            {
+                return;
+            }
+        }
+    }
+
+    dispatchJobs();
+}
+
+bool HeadlessRunner::handleSample(Tracer &tracer, const AdcSample &sample)
+{
+    switch(sample.m_type)
+    {
+    case DataEvent::DataType::StartSweep:
+        tracer.m_pairs.clear();
+        break;
+    case DataEvent::DataType::Base:
+        tracer.m_baseSample = AdcPair{sample.m_v1, sample.m_v2};
+        tracer.m_hasBase = (m_options.m_sweep == SweepType::Transistor);
+        break;
+    case DataEvent::DataType::BaseSearch:
+        tracer.m_baseSearchMeasurements = sample.m_v1;
+        tracer.m_baseSearchTime = sample.m_v2;
+        break;
+    case DataEvent::DataType::Collector:
+    case DataEvent::DataType::Diode:
+        tracer.m_pairs.push_back(AdcPair{sample.m_v1, sample.m_v2});
+        break;
+    case DataEvent::DataType::EndSweep:
+        tracer.m_sweepStop    = static_cast<SerialCtrl::SweepStop>(sample.m_v1);
+        tracer.m_sweepStopPwm = sample.m_v2;
+        if (!writeTrace(tracer))
+        {
+            std::cerr << "Cannot write to " << archiveName(m_options.m_out, tracer.m_job, m_options.m_jobs) << "\n";
+            finish(c_exitOutputError);
+            return false;
+        }
+
+        if (tracer.m_writtenTraces == tracer.m_expectedTraces)
+        {
+            tracer.m_writer.close();
+            tracer.m_job = c_noJob;
+            tracer.m_completedJobs++;
+            m_completedJobs++;
+
+            if (m_completedJobs == m_options.m_jobs)
+            {
+                finish(c_exitOk);
+                return false;
+            }
+        }
+        break;
+    default:
+        break;
+    }
+    return true;
+}
+
+bool HeadlessRunner::writeTrace(Tracer &tracer)
+{
+    const auto &pairs = tracer.m_pairs;
+    m_x.resize(pairs.size());
+    m_y.resize(pairs.size());
+    AdcConversion conversion(m_options.m_setup);
+    conversion.convert(pairs.data(), pairs.size(), m_x.data(), m_y.data());
+
+    if (!tracer.m_writer.append(m_options.m_setup, tracer.m_hasBase ? &tracer.m_baseSample : nullptr,
+        pairs.data(), m_x.data(), m_y.data(), pairs.size()))
+    {
+        return false;
+    }
+
+    tracer.m_writtenTraces++;
+    std::cout << "Job " << tracer.m_job+1 << " trace " << tracer.m_writtenTraces << "/" << tracer.m_expectedTraces
+        << ": " << pairs.size() << " samples, " << m_runTimer.elapsed() << " ms";
+    if (tracer.m_baseSearchMeasurements != 0)
+    {
+        std::cout << ", base current in " << std::abs(tracer.m_baseSearchMeasurements) << " measurements, "
+            << tracer.m_baseSearchTime / 1000.0f << " ms"
+            << ((tracer.m_baseSearchMeasurements < 0) ? " (tolerance not reached)" : "");
+        tracer.m_baseSearchMeasurements = 0;
+    }
+    if (tracer.m_sweepStop != SerialCtrl::SweepStop::Complete)
+    {
+        std::cout << ", stopped at the " << SweepPlan::sweepStopName(tracer.m_sweepStop)
+            << " limit (PWM " << tracer.m_sweepStopPwm << ")";
+    }
+    std::cout << "\n";
+    return true;
+}
+
+void HeadlessRunner::dropTracer(Tracer &tracer)
+{
+    // the archive of the job is written again from the start
+    tracer.m_writer.close();
+    m_droppedSamples += tracer.m_serial->droppedSamples();
+    tracer.m_serial.reset();
+    if (tracer.m_job != c_noJob)
+    {
+        m_pendingJobs.push_front(tracer.m_job);
+        tracer.m_job = c_noJob;
+    }
+
+    const bool anyLeft = std::any_of(m_tracers.begin(), m_tracers.end(),
+        [](const std::unique_ptr<Tracer> &t) { return static_cast<bool>(t->m_serial); });
+
+    if (!anyLeft)
+    {
+        std::cerr << "No tracers left, " << m_completedJobs << " of " << m_options.m_jobs << " jobs completed\n";
+        finish(c_exitTimeout);
+    }
+}
+
+void HeadlessRunner::finish(ExitStatus status)
+{
+    m_finished = true;
+    m_pollTimer->stop();
+
+    for(auto &tracer : m_tracers)
+    {
+        if (tracer->m_serial)
+        {
+            m_droppedSamples += tracer->m_serial->droppedSamples();
+        }
+
+        if (m_runTimer.isValid())
+        {
+            std::cout << tracer->m_port << ": " << tracer->m_completedJobs << " jobs";
+            if (tracer->m_serial && (tracer->m_serial->settleStats().m_steps != 0))
+            {
+                const auto stats = tracer->m_serial->settleStats();
+                std::cout << ", " << static_cast<float>(stats.m_measurements) / stats.m_steps
+                    << " measurements per settled step, at most " << stats.m_maxMeasurements
+                    << ", " << stats.m_unsettled << " unsettled";
+            }
+            if (tracer->m_serial && (tracer->m_serial->badLines() != 0))
+            {
+                std::cout << ", " << tracer->m_serial->badLines() << " bad responses dropped";
+            }
+            std::cout << "\n";
+        }
+
+        tracer->m_serial.reset();
+        tracer->m_writer.close();
+    }
+
+    if (m_runTimer.isValid())
+    {
+        std::cout << m_completedJobs << " jobs in " << m_runTimer.elapsed() << " ms\n";
+    }
+
+    if ((status == c_exitOk) && (m_droppedSamples != 0))
+    {
+        std::cerr << m_droppedSamples << " samples were lost\n";
+        status = c_exitDataLost;
+    }
+
+    QCoreApplication::exit(status);
+}
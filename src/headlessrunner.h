@@ -0,0 +1,125 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <limits>
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+
+#include "customevent.h"
+#include "serialctrl.h"
+#include "tracearchive.h"
+
+/** runs sweeps without a GUI, for unattended characterisation.
+
+    One or more tracers are driven directly through SerialCtrl, each
+    on its own I/O thread. The sweeps to run form a work list of jobs,
+    a job is the complete sweep of one part. Whenever a tracer becomes
+    idle it is handed the next job, so faster tracers take more jobs.
+    A job of a tracer that stops responding is handed to another one.
+
+    Every trace is appended to the archive of its job as soon as its
+    sweep ends, so nothing is kept in memory and an interrupted run
+    leaves usable archives. The application exits with one of the
+    ExitStatus codes.
+*/
+class HeadlessRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum ExitStatus
+    {
+        c_exitOk           = 0,
+        c_exitUsage        = 1,    // invalid command line
+        c_exitPortError    = 2,    // cannot open a serial port
+        c_exitOutputError  = 3,    // cannot write an archive
+        c_exitTimeout      = 4,    // all tracers stopped responding
+        c_exitDataLost     = 5     // samples were dropped
+    };
+
+    enum class SweepType
+    {
+        Transistor,     // a collector sweep per base current
+        Diode
+    };
+
+    struct Options
+    {
+        std::vector<std::string> m_ports;   // one per tracer
+        std::string m_out;          // trace archive to write, see archiveName()
+        uint32_t    m_jobs;         // number of parts to sweep
+        SweepType   m_sweep;
+        SweepSetup  m_setup;        // m_numberOfTraces is the number of traces per job
+        int         m_timeoutMs;    // maximum time between two responses
+    };
+
+    explicit HeadlessRunner(const Options &options);
+
+    /** archive of a job: the output file itself for a single
+        job, otherwise the job number is added to its name. */
+    static std::string archiveName(const std::string &out, uint32_t job, uint32_t jobs);
+
+public slots:
+    /** open the tracers and start the sweeps, call from the event loop */
+    void start();
+
+protected:
+    static constexpr size_t c_noJob = std::numeric_limits<size_t>::max();
+
+    struct Tracer
+    {
+        std::string m_port;
+        std::unique_ptr<SerialCtrl> m_serial;   // null once the tracer failed
+        TraceArchiveWriter m_writer;            // archive of m_job
+
+        size_t   m_job = c_noJob;               // job being swept
+        uint32_t m_expectedTraces = 0;
+        uint32_t m_writtenTraces = 0;
+        uint32_t m_completedJobs = 0;
+
+        std::vector<AdcPair> m_pairs;   // samples of the current trace
+        AdcPair  m_baseSample{0,0};     // last base measurement
+        bool     m_hasBase = false;
+        int32_t  m_baseSearchMeasurements = 0;  // of the current trace, see SerialCtrl::seekBaseCurrent()
+        int32_t  m_baseSearchTime = 0;          // in microseconds
+        SerialCtrl::SweepStop m_sweepStop = SerialCtrl::SweepStop::Complete;    // of the current trace
+        int32_t  m_sweepStopPwm = 0;
+        QElapsedTimer m_idleTimer;      // time since the last response
+    };
+
+    /** drain the responses of all tracers, like the GUI once per frame */
+    void onPollTimer();
+
+    /** hand the next jobs to the idle tracers */
+    void dispatchJobs();
+
+    /** queue the sweeps of a job on a tracer */
+    bool startJob(Tracer &tracer, size_t job);
+
+    /** returns false if the runner finished */
+    bool handleSample(Tracer &tracer, const AdcSample &sample);
+    bool writeTrace(Tracer &tracer);
+
+    /** stop using a tracer that failed, its job is handed to another */
+    void dropTracer(Tracer &tracer);
+
+    /** stop and exit the application with status */
+    void finish(ExitStatus status);
+
+    Options m_options;
+    std::vector<std::unique_ptr<Tracer>> m_tracers;
+    std::deque<size_t> m_pendingJobs;   // the work list
+    uint32_t m_completedJobs;
+    uint32_t m_droppedSamples;  // of all tracers, also the failed ones
+    bool     m_finished;
+
+    QTimer       *m_pollTimer;
+    QElapsedTimer m_runTimer;
+
+    std::vector<float> m_x;     // re-used to convert a trace
+    std::vector<float> m_y;
+};
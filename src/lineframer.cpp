@@ -0,0 +1,141 @@
+#include <limits>
+#include "lineframer.h"
+
+LineFramer::LineFramer()
+{
+    m_overflows = 0;
+    clear();
+}
+
+void LineFramer::clear()
+{
+    m_head  = 0;
+    m_tail  = 0;
+    m_count = 0;
+    m_lines = 0;
+    m_lineLength = 0;
+}
+
+size_t LineFramer::write(const char *data, size_t len)
+{
+    size_t consumed = 0;
+    while(consumed < len)
+    {
+        if (full())
+        {
+            if (m_lines > 0)
+            {
+                // wait until the caller has read some lines
+                break;
+            }
+
+            // the ring is filled with a single partial line
+            // which can only be garbage: throw it away. The rest
+            // of it still ends a line, which answers a command.
+            clear();
+            push(c_discarded);
+            m_lineLength = 1;
+            m_overflows++;
+        }
+
+        const char c = data[consumed++];
+        if (isEOL(c))
+        {
+            // a CR/LF pair or an empty line doesn't
+            // produce a response.
+            if (m_lineLength > 0)
+            {
+                push('\n');
+                m_lines++;
+                m_lineLength = 0;
+            }
+        }
+        else if (isAcceptableChar(c))
+        {
+            push(c);
+            m_lineLength++;
+        }
+    }
+
+    return consumed;
+}
+
+bool LineFramer::readLine(const char *&line, size_t &len)
+{
+    if (m_lines == 0)
+    {
+        return false;
+    }
+
+    len = 0;
+    while(true)
+    {
+        const char c = m_ring[m_tail];
+        m_tail = (m_tail + 1) & (c_ringSize-1);
+        m_count--;
+
+        if (c == '\n')
+        {
+            break;
+        }
+
+        // overlong lines are truncated and marked
+        if (len < c_maxLineLength)
+        {
+            m_line[len++] = c;
+        }
+        else
+        {
+            m_line[0] = c_discarded;
+        }
+    }
+
+    m_line[len] = 0;
+    m_lines--;
+
+    line = m_line.data();
+    return true;
+}
+
+bool LineFramer::parseValues(const char *line, size_t len, int32_t &v1, int32_t &v2)
+{
+    int32_t values[2] = {0,0};
+    size_t  count = 0;
+    bool    inNumber = false;
+
+    for(size_t i=0; i<len; i++)
+    {
+        const char c = line[i];
+        if ((c >= '0') && (c <= '9'))
+        {
+            if (!inNumber)
+            {
+                if (count == 2)
+                {
+                    break;
+                }
+                count++;
+                inNumber = true;
+            }
+            const int32_t digit = c - '0';
+            if (values[count-1] > (std::numeric_limits<int32_t>::max() - digit) / 10)
+            {
+                // too large for a reading, the line is garbage
+                return false;
+            }
+            values[count-1] = values[count-1]*10 + digit;
+        }
+        else if (c == c_discarded)
+        {
+            return false;
+        }
+        else
+        {
+            inNumber = false;
+        }
+    }
+
+    v1 = values[0];
+    v2 = values[1];
+    return count == 2;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+/** reassembles response lines from the serial data stream.
+
+    The USB-serial converter merges and splits packets at will,
+    so a single read can hold a fragment of a line or several
+    lines. Received data is stored in a fixed-size ring buffer
+    until a complete line is available. No memory is allocated.
+*/
+class LineFramer
+{
+public:
+    LineFramer();
+
+    /** store received data in the ring buffer.
+        returns the number of bytes consumed, which is less than
+        len when the buffer is full of complete lines. Call
+        readLine() to make room and write the remainder. */
+    size_t write(const char *data, size_t len);
+
+    /** get the next complete line, without the EOL characters.
+        the line is valid until the next call to readLine().
+        returns false if there is no complete line. */
+    bool readLine(const char *&line, size_t &len);
+
+    /** discard all buffered data */
+    void clear();
+
+    /** parse the two tab separated decimal values of a response line.
+        returns false if the line doesn't hold two values, a value
+        doesn't fit an int32_t or part of the line was discarded. */
+    static bool parseValues(const char *line, size_t len, int32_t &v1, int32_t &v2);
+
+    /** number of complete lines waiting to be read */
+    constexpr size_t linesAvailable() const noexcept
+    {
+        return m_lines;
+    }
+
+    /** number of times the buffer overflowed and data was discarded */
+    constexpr size_t overflows() const noexcept
+    {
+        return m_overflows;
+    }
+
+protected:
+    static constexpr size_t c_ringSize = 4096;  // must be a power of two
+    static constexpr size_t c_maxLineLength = 128;
+    static constexpr char   c_discarded = '?';   // marks a line that lost data
+
+    static constexpr bool isEOL(char c) noexcept
+    {
+        return ((c==10) || (c==13));
+    }
+
+    static constexpr bool isAcceptableChar(char c) noexcept
+    {
+        return ((c >= '0') && (c <= '9')) || (c=='\t') || (c==' ');
+    }
+
+    constexpr bool full() const noexcept
+    {
+        return m_count == c_ringSize;
+    }
+
+    void push(char c) noexcept
+    {
+        m_ring[m_head] = c;
+        m_head = (m_head + 1) & (c_ringSize-1);
+        m_count++;
+    }
+
+    std::array<char, c_ringSize>          m_ring;
+    std::array<char, c_maxLineLength+1>   m_line;     // linearised copy of the last line read
+
+    size_t m_head;          // write position
+    size_t m_tail;          // read position
+    size_t m_count;         // number of bytes in the ring
+    size_t m_lines;         // number of complete lines in the ring
+    size_t m_lineLength;    // length of the partial line being received
+    size_t m_overflows;
+};
@@ -1,9 +1,117 @@
+#include <cstring>
+#include <iostream>
 #include <QApplication>
+#include <QCoreApplication>
+#include <QCommandLineParser>
 #include <QDesktopWidget>
+#include <QTimer>
 #include "mainwindow.h"
+#include "headlessrunner.h"
+#include "sweepplan.h"
+
+/** the headless mode must be known before the application
+    object is created, it doesn't need a display. */
+static bool isHeadless(int argc, char **argv)
+{
+    for(int i=1; i<argc; i++)
+    {
+        if (std::strcmp(argv[i], "--headless") == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int runHeadless(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("POSTracer curve tracer");
+    parser.addHelpOption();
+
+    QCommandLineOption headlessOption("headless", "Run the sweeps without a GUI.");
+    QCommandLineOption portOption("port", "Serial port of a tracer, repeat for several tracers.", "port");
+    QCommandLineOption jobsOption("jobs", "Number of parts to sweep, one per tracer by default.", "N");
+    QCommandLineOption sweepOption("sweep", "Sweep type: transistor or diode.", "type", "transistor");
+    QCommandLineOption tracesOption("traces", "Number of traces per part.", "N", "4");
+    QCommandLineOption outOption("out", "Trace archive (.ptra) to write, numbered per part for several parts.", "file");
+    QCommandLineOption baseStartOption("base-start", "Base current of the first trace in uA.", "uA", "10");
+    QCommandLineOption baseStopOption("base-stop", "Base current of the last trace in uA.", "uA", "20");
+    QCommandLineOption adaptiveOption("adaptive", "Refine the collector sweeps where the curves bend.");
+    QCommandLineOption maxCurrentOption("max-current", "End a sweep above this collector current in mA.", "mA", "0");
+    QCommandLineOption maxVoltageOption("max-voltage", "End a sweep above this device voltage in V.", "V", "0");
+    QCommandLineOption maxPowerOption("max-power", "End a sweep above this device power in mW.", "mW", "0");
+    QCommandLineOption timeoutOption("timeout", "Maximum time without a response in ms.", "ms", "5000");
+    parser.addOptions({headlessOption, portOption, jobsOption, sweepOption, tracesOption, outOption,
+        baseStartOption, baseStopOption, adaptiveOption, maxCurrentOption, maxVoltageOption, maxPowerOption,
+        timeoutOption});
+
+    if (!parser.parse(app.arguments()))
+    {
+        std::cerr << parser.errorText().toStdString() << "\n";
+        return HeadlessRunner::c_exitUsage;
+    }
+
+    if (parser.isSet("help"))
+    {
+        std::cout << parser.helpText().toStdString();
+        return HeadlessRunner::c_exitOk;
+    }
+
+    HeadlessRunner::Options options;
+    for(const auto &port : parser.values(portOption))
+    {
+        options.m_ports.push_back(port.toStdString());
+    }
+    options.m_out   = parser.value(outOption).toStdString();
+    options.m_setup = SweepPlan::defaultSetup();
+
+    bool jobsOk = true;
+    options.m_jobs = static_cast<uint32_t>(options.m_ports.size());
+    if (parser.isSet(jobsOption))
+    {
+        options.m_jobs = parser.value(jobsOption).toUInt(&jobsOk);
+    }
+
+    bool tracesOk, startOk, stopOk, currentOk, voltageOk, powerOk, timeoutOk;
+    options.m_setup.m_numberOfTraces   = parser.value(tracesOption).toUInt(&tracesOk);
+    options.m_setup.m_baseCurrentStart = parser.value(baseStartOption).toInt(&startOk);
+    options.m_setup.m_baseCurrentStop  = parser.value(baseStopOption).toInt(&stopOk);
+    options.m_setup.m_adaptiveSweep    = parser.isSet(adaptiveOption);
+    options.m_setup.m_maxCurrent       = parser.value(maxCurrentOption).toFloat(&currentOk);
+    options.m_setup.m_maxVoltage       = parser.value(maxVoltageOption).toFloat(&voltageOk);
+    options.m_setup.m_maxPower         = parser.value(maxPowerOption).toFloat(&powerOk);
+    options.m_timeoutMs = parser.value(timeoutOption).toInt(&timeoutOk);
+
+    const auto sweep = parser.value(sweepOption);
+    options.m_sweep = (sweep == "diode") ? HeadlessRunner::SweepType::Diode : HeadlessRunner::SweepType::Transistor;
+
+    if (options.m_ports.empty() || options.m_out.empty() ||
+        !jobsOk || (options.m_jobs == 0) ||
+        ((sweep != "transistor") && (sweep != "diode")) ||
+        !tracesOk || (options.m_setup.m_numberOfTraces == 0) ||
+        !startOk || !stopOk || !timeoutOk || (options.m_timeoutMs <= 0) ||
+        !currentOk || !voltageOk || !powerOk ||
+        (options.m_setup.m_maxCurrent < 0.0f) || (options.m_setup.m_maxVoltage < 0.0f) || (options.m_setup.m_maxPower < 0.0f))
+    {
+        std::cerr << parser.helpText().toStdString();
+        return HeadlessRunner::c_exitUsage;
+    }
+
+    HeadlessRunner runner(options);
+    QTimer::singleShot(0, &runner, &HeadlessRunner::start);
+    return app.exec();
+}
 
 int main(int argc, char **argv)
 {
+    if (isHeadless(argc, argv))
+    {
+        return runHeadless(argc, argv);
+    }
+
     QApplication app(argc, argv);
     QApplication::setAttribute(Qt::AA_DontUseNativeMenuBar);
 
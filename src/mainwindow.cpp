@@ -2,31 +2,30 @@
 #include <fstream>
 #include <sstream>
 #include <algorithm>
+#include <cstdlib>
 
 #include <QScreen>
 #include <QApplication>
 #include <QMessageBox>
 #include <QMenuBar>
-#include <QImage>
-#include <QPixmap>
-#include <QPainter>
 #include <QVariant>
 #include <QFileDialog>
+#include <QFileInfo>
+#include <QStatusBar>
 #include <QHBoxLayout>
 
 
 #include "mainwindow.h"
 #include "serialportdialog.h"
 #include "sweepdialog.h"
+#include "conversion.h"
+#include "sweepplan.h"
 
 MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent)
 {
-    m_sweepSetup.m_baseLimitResistor = 100.0;   // 100k
-    m_sweepSetup.m_baseSenseResistor = 3.3;     // 3k3
-    m_sweepSetup.m_collectorResistor = 1.0;     // 1k
-    m_sweepSetup.m_baseCurrentStart  = 10;       // 10 uA
-    m_sweepSetup.m_baseCurrentStop   = 20;       // 20 uA
-    m_sweepSetup.m_numberOfTraces    = 4;
+    m_sweepSetup = SweepPlan::defaultSetup();
+
+    m_baseSample = AdcPair{0,0};
 
     createActions();
     createMenus();
@@ -37,13 +36,25 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent)
     auto hLayout = new QHBoxLayout();
     mainWidget->setLayout(hLayout);
 
-    m_traceList = new QListWidget();
-    connect(m_traceList, SIGNAL(itemSelectionChanged()), this, SLOT(onSelectedTraceChanged()) );
+    m_traceList = new QListView();
     hLayout->addWidget(m_traceList, 1);
 
     m_graph = new Graph(this);
     m_graph->selectTrace(0);
+    m_graph->setSweepSetup(m_sweepSetup);
+    applyTraceLimits();
     hLayout->addWidget(m_graph, 5);  
+
+    m_traceModel = new TraceListModel(m_graph, this);
+    m_traceList->setModel(m_traceModel);
+    connect(m_traceList->selectionModel(), SIGNAL(currentChanged(QModelIndex,QModelIndex)), this, SLOT(onSelectedTraceChanged()) );
+
+    // samples from the serial I/O thread are
+    // collected once per display frame.
+    m_dataBlock.reserve(4096);
+    m_frameTimer = new QTimer(this);
+    connect(m_frameTimer, &QTimer::timeout, this, &MainWindow::onFrameTimer);
+    m_frameTimer->start(16);
 }
 
 MainWindow::~MainWindow()
@@ -58,6 +69,14 @@ void MainWindow::createActions()
     m_saveAction = new QAction("&Save As...");
     connect(m_saveAction, &QAction::triggered, this, &MainWindow::onSave);
 
+    m_openArchiveAction = new QAction("&Open archive...");
+    connect(m_openArchiveAction, &QAction::triggered, this, &MainWindow::onOpenArchive);
+
+    m_recordArchiveAction = new QAction("&Record to archive...");
+    m_recordArchiveAction->setCheckable(true);
+    m_recordArchiveAction->setChecked(false);
+    connect(m_recordArchiveAction, &QAction::triggered, this, &MainWindow::onRecordArchive);
+
     m_connectAction = new QAction("Connect");
     connect(m_connectAction, &QAction::triggered, this, &MainWindow::onConnect);
 
@@ -69,6 +88,9 @@ void MainWindow::createActions()
 
     m_sweepTransistorAction = new QAction("Transistor");
     connect(m_sweepTransistorAction, &QAction::triggered, this, &MainWindow::onSweepTransistor);
+
+    m_stopSweepAction = new QAction("Stop");
+    connect(m_stopSweepAction, &QAction::triggered, this, &MainWindow::onStopSweep);
     
     m_persistanceAction = new QAction("Trace persistance");
     m_persistanceAction->setCheckable(true);
@@ -88,6 +110,8 @@ void MainWindow::createActions()
 void MainWindow::createMenus()
 {
     QMenu *fileMenu = menuBar()->addMenu(tr("&File"));
+    fileMenu->addAction(m_openArchiveAction);
+    fileMenu->addAction(m_recordArchiveAction);
     fileMenu->addAction(m_saveAction);
     fileMenu->addAction(m_quitAction);
 
@@ -99,6 +123,7 @@ void MainWindow::createMenus()
     sweepMenu->addAction(m_sweepSetupAction);
     sweepMenu->addAction(m_sweepDiodeAction);
     sweepMenu->addAction(m_sweepTransistorAction);
+    sweepMenu->addAction(m_stopSweepAction);
     sweepMenu->addSeparator();
     sweepMenu->addAction(m_clearTracesAction);
     sweepMenu->addAction(m_persistanceAction);
@@ -107,144 +132,310 @@ void MainWindow::createMenus()
     helpMenu->addAction(m_aboutAction);
 }
 
-bool MainWindow::event(QEvent *event)
+void MainWindow::onFrameTimer()
 {
-    if(event->type() == QEvent::User)
+    updateExport();
+    drainSamples();
+}
+
+void MainWindow::drainSamples()
+{
+    if (!m_serial)
+    {
+        return;
+    }
+
+    // consecutive responses of the same type are
+    // collected and handled as a single block.
+    AdcSample sample;
+    while(m_serial->samples().pop(sample))
     {
-        auto evt = static_cast<DataEvent*>(event);
-        switch(evt->dataType())
+        switch(sample.m_type)
         {
         case DataEvent::DataType::Base:
-            handleBaseData(evt->data());
-            break;
         case DataEvent::DataType::Collector:
-            handleCollectorData(evt->data());
-            break;
         case DataEvent::DataType::Diode:
-            handleDiodeData(evt->data());
-            break;            
+            if (sample.m_type != m_dataBlock.dataType())
+            {
+                flushDataBlock();
+                m_dataBlock.setDataType(sample.m_type);
+            }
+            m_dataBlock.append(sample.m_v1, sample.m_v2);
+            break;
         case DataEvent::DataType::EndSweep:
-            // add label to the curve
-            m_graph->addLabel(QString::asprintf("%.2f uA", m_baseCurrent*1.0e6f),
-                m_lastCurvePoint);            
+            flushDataBlock();
+            reportSweepStop(sample.m_v1, sample.m_v2);
+            handleEndSweep();
             break;
         case DataEvent::DataType::StartSweep:
-            {
-                size_t numberOfTraces = m_graph->newTrace();
-
-                auto item = new QListWidgetItem();
-                item->setFlags(Qt::ItemIsEditable | Qt::ItemIsEnabled | Qt::ItemIsSelectable);
-                item->setData(Qt::DisplayRole, QString::asprintf("Trace %ld", numberOfTraces));
-                item->setData(Qt::UserRole, static_cast<int>(numberOfTraces));
-
-                QImage image(12,12, QImage::Format::Format_RGB888);
-                QPainter painter(&image);
-                painter.setPen(Qt::black);
-                painter.setBrush(QColor(m_graph->traces().back().m_color));
-                auto r = image.rect();
-                r.adjust(0,0,-1,-1);
-                painter.drawRect(r);
-                auto pixmap = QPixmap::fromImage(image);
-                item->setIcon(QIcon(pixmap));
-
-                m_traceList->addItem(item);
-            }
+            flushDataBlock();
+            handleStartSweep();
+            break;
+        case DataEvent::DataType::BaseSearch:
+            reportBaseSearch(sample.m_v1, sample.m_v2);
             break;
         default:
-            return false;
+            break;
         }
+    }
+
+    flushDataBlock();
+}
 
-        return true;        
+void MainWindow::flushDataBlock()
+{
+    if (!m_dataBlock.empty())
+    {
+        handleDataBlock(m_dataBlock);
+        m_dataBlock.clear();
     }
-    
-    return QMainWindow::event(event);
 }
 
+void MainWindow::handleDataBlock(const DataBlock &block)
+{
+    if (block.empty())
+    {
+        return;
+    }
+
+    switch(block.dataType())
+    {
+    case DataEvent::DataType::Base:
+        handleBaseData(block.data(), block.size());
+        break;
+    case DataEvent::DataType::Collector:
+        handleCollectorData(block.data(), block.size());
+        break;
+    case DataEvent::DataType::Diode:
+        handleDiodeData(block.data(), block.size());
+        break;            
+    default:
+        break;
+    }
+}
+
+void MainWindow::handleEndSweep()
+{
+    const auto numberOfTraces = m_graph->getNumberOfTraces();
+    if (numberOfTraces == 0)
+    {
+        return;
+    }
+
+    // the base measurement belongs to the trace that was just
+    // swept, it is converted again when the setup changes.
+    m_graph->setTraceBase(numberOfTraces-1, m_baseSample);
+    addBaseLabel(numberOfTraces-1, m_baseSample);
 
-void MainWindow::handleBaseData(const std::string &data)
+    if (m_serial)
+    {
+        const auto stats = m_serial->settleStats();
+        if (stats.m_steps != 0)
+        {
+            std::cout << "Settling: " << static_cast<float>(stats.m_measurements) / stats.m_steps
+                << " measurements per step, at most " << stats.m_maxMeasurements
+                << ", " << stats.m_unsettled << " of " << stats.m_steps << " steps unsettled\n";
+        }
+    }
+
+    if (m_archiveWriter.isOpen() && !writeTraceToArchive(numberOfTraces-1))
+    {
+        std::cout << "Cannot write to the archive, recording stopped\n";
+        m_archiveWriter.close();
+        m_recordArchiveAction->setChecked(false);
+    }
+}
+
+bool MainWindow::writeTraceToArchive(size_t trace)
 {
-    int32_t v1,v2;
-    sscanf(data.c_str(), "%d\t%d", &v1, &v2);
+    const auto &store = m_graph->traceStore();
+
+    std::vector<AdcPair> pairs;
+    std::vector<float> x;
+    std::vector<float> y;
+    if (!store.readRaw(trace, pairs) || !store.read(trace, x, y))
+    {
+        return false;
+    }
 
-    m_baseCurrent = (v1-v2) / 3300.0f / 256.0f / 1024.0f * 5.0f;
-    //std::cout << "Base: " << v1 << " " << v2 << " -> " << m_baseCurrent*1.0e6 << "uA \n";
-    //std::cout << std::flush;
+    AdcPair base;
+    const bool hasBase = store.base(trace, base);
+    return m_archiveWriter.append(store.setup(trace), hasBase ? &base : nullptr,
+        pairs.data(), x.data(), y.data(), pairs.size());
 }
 
-void MainWindow::handleDiodeData(const std::string &data)
+void MainWindow::addBaseLabel(size_t trace, const AdcPair &base)
 {
-    int32_t v1,v2;
-    sscanf(data.c_str(), "%d\t%d", &v1, &v2);    
+    // converted with the setup the trace was measured with
+    AdcConversion conversion(m_graph->traceStore().setup(trace));
+    m_graph->addLabel(QString::asprintf("%.2f uA", conversion.baseCurrent(base)*1.0e6f), trace);
+}
 
-    float collectorCurrent = (v1-v2) / 1000.0f / 256.0f / 1024.0f * 5.0f;
-    float collectorVoltage = v2 / 256.0f / 1024.0f * 5.0f;    
+void MainWindow::reportBaseSearch(int32_t measurements, int32_t microseconds)
+{
+    std::cout << "Base current search: " << std::abs(measurements) << " measurements, "
+        << microseconds / 1000.0f << " ms" << ((measurements < 0) ? ", tolerance not reached" : "") << "\n";
+}
 
-    m_lastCurvePoint = QPointF(collectorVoltage, collectorCurrent);
-    m_graph->addDataPoint(m_lastCurvePoint);    
+void MainWindow::reportSweepStop(int32_t reason, int32_t pwm)
+{
+    const auto stop = static_cast<SerialCtrl::SweepStop>(reason);
+    if (stop == SerialCtrl::SweepStop::Cancelled)
+    {
+        std::cout << "Sweep cancelled\n";
+    }
+    else if (stop != SerialCtrl::SweepStop::Complete)
+    {
+        std::cout << "Sweep stopped at the " << SweepPlan::sweepStopName(stop) << " limit, PWM " << pwm << "\n";
+    }
 }
 
-void MainWindow::handleCollectorData(const std::string &data)
+void MainWindow::handleStartSweep()
 {
-    int32_t v1,v2;
-    sscanf(data.c_str(), "%d\t%d", &v1, &v2);
+    m_traceModel->setNumberOfTraces(m_graph->newTrace());
+}
 
-    float collectorCurrent = (v1-v2) / 1000.0f / 256.0f / 1024.0f * 5.0f;
-    float collectorVoltage = v2 / 256.0f / 1024.0f * 5.0f;
-    //std::cout << "Collector: " << v1 << " " << v2 << " -> " << collectorCurrent*1.0e6 << " uA   voltage: " << collectorVoltage << " V\n";
-    //std::cout << std::flush;
+void MainWindow::handleBaseData(const AdcPair *pairs, size_t count)
+{
+    // only the last measurement is of interest,
+    // the others were taken while settling.
+    m_baseSample = pairs[count-1];
+}
+
+void MainWindow::handleDiodeData(const AdcPair *pairs, size_t count)
+{
+    m_graph->addSamples(pairs, count);
+}
 
-    m_lastCurvePoint = QPointF(collectorVoltage, collectorCurrent);
-    m_graph->addDataPoint(m_lastCurvePoint);
+void MainWindow::handleCollectorData(const AdcPair *pairs, size_t count)
+{
+    m_graph->addSamples(pairs, count);
 }
 
 void MainWindow::onSave()
 {
-    // save the traces as JSON file
-    auto filename = QFileDialog::getSaveFileName(this, tr("Save traces as JSON"), "", tr("JSON files (*.json)"));
+    if (m_exporter.isBusy())
+    {
+        statusBar()->showMessage(tr("An export is in progress"), 2000);
+        return;
+    }
+
+    const QString jsonFilter = tr("JSON files (*.json)");
+    const QString csvFilter  = tr("CSV files (*.csv)");
+    const QString ptraFilter = tr("Trace archives (*.ptra)");
+
+    QString selectedFilter;
+    auto filename = QFileDialog::getSaveFileName(this, tr("Save traces"), "",
+        jsonFilter + ";;" + csvFilter + ";;" + ptraFilter, &selectedFilter);
 
-    if (!filename.isEmpty())
+    if (filename.isEmpty())
     {
-        std::ofstream json(filename.toStdString());
+        return;
+    }
 
-        if (!json.is_open())
+    // the extension wins, the filter is used when there is none
+    auto format = TraceExporter::formatFromFilename(filename.toStdString());
+    if (QFileInfo(filename).suffix().isEmpty())
+    {
+        if (selectedFilter == csvFilter)
         {
-            return;
+            format = TraceExporter::Format::Csv;
+        }
+        else if (selectedFilter == ptraFilter)
+        {
+            format = TraceExporter::Format::Archive;
         }
+    }
 
-        json << "{\n";
+    // the traces are written from snapshots on a worker
+    // thread, measuring continues while they are saved.
+    m_exporter.start(m_graph->snapshot(), filename.toStdString(), format);
+    updateExport();
+}
 
-        size_t index = 1;
-        for(auto & trace : m_graph->traces())
-        {
-            std::stringstream ss;
-            ss << "    \"trace" << index << "\": [";
-            json << ss.str();
+void MainWindow::updateExport()
+{
+    if (!m_exporter.isBusy())
+    {
+        return;
+    }
 
-            bool first = true;
-            for(auto &pt : trace.m_data)
-            {
-                if (!first) 
-                {
-                    json << ",";
-                }
+    if (!m_exporter.isDone())
+    {
+        statusBar()->showMessage(tr("Saving trace %1 of %2")
+            .arg(m_exporter.progress() + 1)
+            .arg(m_exporter.numberOfTraces()));
+        return;
+    }
 
-                json << "[" << pt.x() << " ," << pt.y() << "]";
-                first = false;
-            }
+    if (m_exporter.finish())
+    {
+        statusBar()->showMessage(tr("Traces saved"), 2000);
+    }
+    else
+    {
+        statusBar()->showMessage(tr("Saving the traces failed"), 5000);
+    }
+}
 
-            if (index != m_graph->traces().size())
-            {
-                json << "],\n";
-            }    
-            else
-            {
-                json << "]\n";
-            }
-            
-            index++;
+void MainWindow::onOpenArchive()
+{
+    auto filename = QFileDialog::getOpenFileName(this, tr("Open trace archive"), "", tr("Trace archives (*.ptra)"));
+
+    if (filename.isEmpty())
+    {
+        return;
+    }
+
+    if (!m_graph->openArchive(filename))
+    {
+        std::cout << "Cannot open archive " << filename.toStdString() << "\n";
+        return;
+    }
+
+    const auto &store = m_graph->traceStore();
+    m_traceModel->clear();
+    m_traceModel->setNumberOfTraces(store.numberOfTraces());
+    for(size_t trace=0; trace < store.numberOfTraces(); trace++)
+    {
+        AdcPair base;
+        if (store.base(trace, base))
+        {
+            addBaseLabel(trace, base);
         }
+    }
 
-        json << "}\n";
+    // the traces are loaded when selected, show the last one
+    m_traceList->setCurrentIndex(m_traceModel->index(m_traceModel->rowCount()-1));
+}
+
+void MainWindow::onRecordArchive()
+{
+    if (!m_recordArchiveAction->isChecked())
+    {
+        m_archiveWriter.close();
+        return;
+    }
+
+    auto filename = QFileDialog::getSaveFileName(this, tr("Record traces to archive"), "", tr("Trace archives (*.ptra)"));
+
+    if (filename.isEmpty() || !m_archiveWriter.open(filename.toStdString()))
+    {
+        m_recordArchiveAction->setChecked(false);
+        return;
+    }
+
+    // the traces so far, new traces are appended when their sweep ends
+    const auto numberOfTraces = m_graph->getNumberOfTraces();
+    for(size_t trace=0; trace < numberOfTraces; trace++)
+    {
+        if (!writeTraceToArchive(trace))
+        {
+            std::cout << "Cannot write to the archive\n";
+            m_archiveWriter.close();
+            m_recordArchiveAction->setChecked(false);
+            return;
+        }
     }
 }
 
@@ -266,9 +457,32 @@ void MainWindow::onSweepSetup()
     if (status == QDialog::Accepted)
     {
         m_sweepSetup = dialog.getSetup();
+        applyTraceLimits();
+
+        // a corrected resistor value applies to the
+        // traces that have been measured already.
+        m_graph->setSweepSetup(m_sweepSetup);
+        m_graph->clearLabels();
+
+        const auto &store = m_graph->traceStore();
+        for(size_t trace=0; trace < store.numberOfTraces(); trace++)
+        {
+            AdcPair base;
+            if (store.base(trace, base))
+            {
+                addBaseLabel(trace, base);
+            }
+        }
     }
 }
 
+void MainWindow::applyTraceLimits()
+{
+    // older traces are spilled to disk beyond these limits
+    m_graph->setTraceLimits(m_sweepSetup.m_maxTracesInMemory,
+        static_cast<size_t>(m_sweepSetup.m_maxTraceMemory) * 1024 * 1024);
+}
+
 void MainWindow::onConnect()
 {
     SerialPortDialog dialog;
@@ -278,12 +492,17 @@ void MainWindow::onConnect()
         auto serialPortLocation = dialog.getSerialPortLocation().toStdString();
         if (!m_serial)        
         {
-            auto ctrl = SerialCtrl::open(serialPortLocation, this);
+            auto ctrl = SerialCtrl::open(serialPortLocation);
             m_serial.reset(ctrl);
 
             if (m_serial)
             {
-                std::cout << "Serial port " << serialPortLocation << " open ok\n";
+                std::cout << "Serial port " << serialPortLocation << " open ok";
+                if (m_serial->protocol() == SerialCtrl::Protocol::Binary)
+                {
+                    std::cout << " (binary protocol)";
+                }
+                std::cout << "\n";
             }
             else
             {
@@ -306,29 +525,53 @@ void MainWindow::onDisconnect()
     }
 }
 
+void MainWindow::cancelSweeps()
+{
+    // an idle tracer isn't sent the PWM 0 commands of cancel()
+    if (!m_serial || !m_serial->isBusy())
+    {
+        return;
+    }
+
+    // the cancelled sweep has ended once cancel() returns,
+    // its trace is completed before anything is cleared.
+    m_serial->cancel();
+    drainSamples();
+}
+
+void MainWindow::onStopSweep()
+{
+    cancelSweeps();
+}
+
 void MainWindow::onSweepDiode()
 {
+    // a new sweep replaces the one that is running
+    cancelSweeps();
+
     if (!m_persistance)
     {
         m_graph->clearData();
-        m_traceList->clear();
+        m_traceModel->clear();
     }
 
     if (m_serial)
     {   
-        m_serial->setBasePWM(0, false);
-        m_serial->setBasePWM(0);
-        m_serial->sweepDiode(0,1023, 10);
+        // the settling is reported per sweep
+        m_serial->resetSettleStats();
+        SweepPlan::queueDiodeSweep(*m_serial, m_sweepSetup);
         m_serial->run();
     }
 }
 
 void MainWindow::onSweepTransistor()
 {
+    cancelSweeps();
+
     if (!m_persistance)
     {
         m_graph->clearData();
-        m_traceList->clear();
+        m_traceModel->clear();
     }
 
     if (!m_serial)
@@ -336,48 +579,17 @@ void MainWindow::onSweepTransistor()
         return;
     }
 
-    m_sweepSetup.m_numberOfTraces = std::max(1U, m_sweepSetup.m_numberOfTraces);
-    float baseCurrentStep = 0.0f;
-    if (m_sweepSetup.m_numberOfTraces > 1)
-    {
-        baseCurrentStep = (m_sweepSetup.m_baseCurrentStop - m_sweepSetup.m_baseCurrentStart) / (m_sweepSetup.m_numberOfTraces-1);
-    }
-    
-    const float totalBaseResistance = m_sweepSetup.m_baseLimitResistor + m_sweepSetup.m_baseSenseResistor;
-
-    for(uint32_t sweep = 0; sweep < m_sweepSetup.m_numberOfTraces; sweep++)
-    {   
-        // calculate the required PWM / voltage to achieve the
-        // desired base current (in uA)
-
-        float desiredBaseCurrent = static_cast<float>(m_sweepSetup.m_baseCurrentStart) + static_cast<float>(sweep)*baseCurrentStep;
-
-        std::cout << "Base current    : " << desiredBaseCurrent << " uA\n";
-
-        float baseVoltage = (desiredBaseCurrent*1e-6f) * (totalBaseResistance*1e3f);
-        baseVoltage += 0.65f;
-
-        int32_t pwm = static_cast<int32_t>((baseVoltage / 5.0f) * 1023);
-        pwm = std::max(pwm, 0);
-        pwm = std::min(pwm, 1023);
-
-        std::cout << "Base PWM voltage: " << baseVoltage << "  pwm = " << pwm << "\n";
-
-        m_serial->setBasePWM(pwm, false);
-        m_serial->setBasePWM(pwm, false);
-        m_serial->setBasePWM(pwm);
-        m_serial->sweepCollector(0,1023, 10);        
-    }
-
+    m_serial->resetSettleStats();
+    SweepPlan::queueTransistorSweep(*m_serial, m_sweepSetup);
     m_serial->run();
 }
 
 void MainWindow::onSelectedTraceChanged()
 {
-    auto item = m_traceList->currentItem();
-    if (item != nullptr)
+    auto index = m_traceList->currentIndex();
+    if (index.isValid())
     {
-        QVariant userData = item->data(Qt::UserRole);
+        QVariant userData = index.data(Qt::UserRole);
         int32_t traceIndex = userData.toInt() - 1;
         m_graph->selectTrace(traceIndex);
     }
@@ -386,7 +598,7 @@ void MainWindow::onSelectedTraceChanged()
 void MainWindow::onClearTraces()
 {
     m_graph->clearData();
-    m_traceList->clear();
+    m_traceModel->clear();
 }
 
 void MainWindow::onAbout()
@@ -2,12 +2,16 @@
 
 #include <thread>
 #include <QMainWindow>
-#include <QListWidget>
+#include <QListView>
 #include <QAction>
+#include <QTimer>
 
 #include "customevent.h"
 #include "serialctrl.h"
 #include "graph.h"
+#include "tracelistmodel.h"
+#include "tracearchive.h"
+#include "traceexport.h"
 
 class MainWindow : public QMainWindow
 {
@@ -17,50 +21,91 @@ public:
     explicit MainWindow(QWidget *parent = 0);
     virtual ~MainWindow();
 
-    bool event(QEvent *event) override;
-
 signals:
 
 public slots:
     void onSweepSetup();
     void onSweepDiode();
     void onSweepTransistor();
+    void onStopSweep();
     void onConnect();
     void onDisconnect();
     void onQuit();
     void onSave();
+    void onOpenArchive();
+    void onRecordArchive();
     void onPersistanceChanged();
     void onSelectedTraceChanged();
     void onClearTraces();
     void onAbout();
+    void onFrameTimer();
 
 protected:
-    void handleBaseData(const std::string &data);
-    void handleCollectorData(const std::string &data);
-    void handleDiodeData(const std::string &data);
+    /** process a block of tracer responses in one go */
+    void handleDataBlock(const DataBlock &block);
+
+    /** deliver the samples collected in m_dataBlock */
+    void flushDataBlock();
+
+    /** handle the samples in the serial sample ring */
+    void drainSamples();
+
+    /** cancel the running sweeps and handle what they have reported */
+    void cancelSweeps();
+
+    void handleBaseData(const AdcPair *pairs, size_t count);
+    void handleCollectorData(const AdcPair *pairs, size_t count);
+    void handleDiodeData(const AdcPair *pairs, size_t count);
+    void handleStartSweep();
+
+    /** print the result of a closed-loop base current search, see SerialCtrl::seekBaseCurrent() */
+    void reportBaseSearch(int32_t measurements, int32_t microseconds);
+    void reportSweepStop(int32_t reason, int32_t pwm);
+    void handleEndSweep();
+
+    /** pass the persistence limits of m_sweepSetup to the graph */
+    void applyTraceLimits();
+
+    /** label a trace with the base current */
+    void addBaseLabel(size_t trace, const AdcPair &base);
+
+    /** append a trace to the archive that is being recorded */
+    bool writeTraceToArchive(size_t trace);
+
+    /** show the progress of a background export and finish it when done */
+    void updateExport();
 
     void createMenus();
     void createActions();
 
     QAction *m_quitAction;
     QAction *m_saveAction;
+    QAction *m_openArchiveAction;
+    QAction *m_recordArchiveAction;
     QAction *m_connectAction;
     QAction *m_disconnectAction;
     QAction *m_sweepTransistorAction;
     QAction *m_sweepDiodeAction;
+    QAction *m_stopSweepAction;
     QAction *m_persistanceAction;
     QAction *m_sweepSetupAction;
     QAction *m_clearTracesAction;
     QAction *m_aboutAction;
 
-    float   m_baseCurrent;
-    QPointF m_lastCurvePoint;
+    AdcPair m_baseSample;       // last base measurement
     
     SweepSetup m_sweepSetup;
     bool    m_persistance;
 
     Graph *m_graph;
-    QListWidget *m_traceList;
+    QListView   *m_traceList;
+    TraceListModel *m_traceModel;   // rows of m_traceList, made when shown
+    QTimer      *m_frameTimer;      // drains the serial sample ring
+
+    DataBlock    m_dataBlock;       // samples drained from the ring, reused every frame
+
+    TraceArchiveWriter m_archiveWriter;   // open while recording
+    TraceExporter      m_exporter;        // writes saved traces in the background
 
     std::unique_ptr<SerialCtrl> m_serial;
 };
@@ -0,0 +1,114 @@
+#include <algorithm>
+#include "pointindex.h"
+
+void PointIndex::clear()
+{
+    m_trees.clear();
+    m_numberOfPoints = 0;
+}
+
+void PointIndex::update(const float *x, const float *y, size_t count)
+{
+    for(size_t i = m_numberOfPoints; i < count; i++)
+    {
+        add(x[i], y[i], static_cast<uint32_t>(i));
+    }
+}
+
+void PointIndex::add(float x, float y, uint32_t index)
+{
+    Tree carry{Node{x, y, index}};
+
+    // like a binary counter: merge full trees until
+    // an empty slot is found.
+    size_t k = 0;
+    for(; k < m_trees.size(); k++)
+    {
+        if (m_trees[k].empty())
+        {
+            break;
+        }
+
+        carry.insert(carry.end(), m_trees[k].begin(), m_trees[k].end());
+        m_trees[k].clear();
+    }
+
+    if (k == m_trees.size())
+    {
+        m_trees.emplace_back();
+    }
+
+    build(carry, 0, carry.size(), true);
+    m_trees[k] = std::move(carry);
+    m_numberOfPoints++;
+}
+
+void PointIndex::build(Tree &nodes, size_t lo, size_t hi, bool splitOnX)
+{
+    if ((hi - lo) <= 1)
+    {
+        return;
+    }
+
+    const size_t mid = lo + (hi - lo) / 2;
+    std::nth_element(nodes.begin() + lo, nodes.begin() + mid, nodes.begin() + hi,
+        [splitOnX](const Node &lhs, const Node &rhs)
+        {
+            return splitOnX ? (lhs.m_x < rhs.m_x) : (lhs.m_y < rhs.m_y);
+        });
+
+    build(nodes, lo, mid, !splitOnX);
+    build(nodes, mid+1, hi, !splitOnX);
+}
+
+bool PointIndex::search(const Tree &nodes, size_t lo, size_t hi, bool splitOnX,
+    double px, double py, double xscale, double yscale,
+    uint32_t &index, double &distance2)
+{
+    if (lo >= hi)
+    {
+        return false;
+    }
+
+    const size_t mid = lo + (hi - lo) / 2;
+    const auto &node = nodes[mid];
+
+    bool found = false;
+    const double dx = (node.m_x - px) * xscale;
+    const double dy = (node.m_y - py) * yscale;
+    const double d2 = dx*dx + dy*dy;
+    if (d2 < distance2)
+    {
+        distance2 = d2;
+        index = node.m_index;
+        found = true;
+    }
+
+    // visit the side of the split that holds p first
+    const double delta = splitOnX ? dx : dy;
+    const bool nearIsLow = (delta > 0);
+    const size_t nearLo = nearIsLow ? lo : mid+1;
+    const size_t nearHi = nearIsLow ? mid : hi;
+    const size_t farLo  = nearIsLow ? mid+1 : lo;
+    const size_t farHi  = nearIsLow ? hi : mid;
+
+    found |= search(nodes, nearLo, nearHi, !splitOnX, px, py, xscale, yscale, index, distance2);
+
+    if ((delta*delta) < distance2)
+    {
+        found |= search(nodes, farLo, farHi, !splitOnX, px, py, xscale, yscale, index, distance2);
+    }
+
+    return found;
+}
+
+bool PointIndex::nearest(const QPointF &p, double xscale, double yscale,
+    uint32_t &index, double &distance2) const
+{
+    bool found = false;
+    for(auto const& tree : m_trees)
+    {
+        found |= search(tree, 0, tree.size(), true, p.x(), p.y(), xscale, yscale, index, distance2);
+    }
+    return found;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <QPointF>
+
+/** spatial index for nearest-point queries on a trace.
+
+    Points are kept in a set of static k-d trees with sizes that
+    are powers of two (the logarithmic method): appending a point
+    merges the trees of equal size, which costs O(log n) amortised
+    rebuilds. A query visits O(log n) trees, each in O(log n).
+
+    The distance metric is weighted per axis so queries can be
+    done in screen space while the index stores data coordinates.
+*/
+class PointIndex
+{
+public:
+    void clear();
+
+    /** index the points from numberOfPoints() up to count */
+    void update(const float *x, const float *y, size_t count);
+
+    /** add a single point with the given trace index */
+    void add(float x, float y, uint32_t index);
+
+    size_t numberOfPoints() const noexcept
+    {
+        return m_numberOfPoints;
+    }
+
+    /** find the point nearest to p, where the distance is
+        (dx*xscale)^2 + (dy*yscale)^2. Only points closer than
+        distance2 are considered; on success index and distance2
+        are updated and true is returned. */
+    bool nearest(const QPointF &p, double xscale, double yscale,
+        uint32_t &index, double &distance2) const;
+
+protected:
+    struct Node
+    {
+        float    m_x;
+        float    m_y;
+        uint32_t m_index;
+    };
+
+    using Tree = std::vector<Node>;
+
+    /** arrange nodes[lo..hi) as an implicit k-d tree */
+    static void build(Tree &nodes, size_t lo, size_t hi, bool splitOnX);
+
+    static bool search(const Tree &nodes, size_t lo, size_t hi, bool splitOnX,
+        double px, double py, double xscale, double yscale,
+        uint32_t &index, double &distance2);
+
+    std::vector<Tree> m_trees;  // tree k is empty or holds 2^k nodes
+    size_t m_numberOfPoints = 0;
+};
@@ -3,27 +3,66 @@
 #include <sstream>
 #include <iostream>
 #include <thread>
-#include <QApplication>
+#include <future>
+#include <algorithm>
+#include <cstdlib>
+#include <QElapsedTimer>
 #include "serialctrl.h"
 
-SerialCtrl::SerialCtrl(QSerialPort *port, QObject *eventReceiver)
-    : m_port(port), m_eventReceiver(eventReceiver)
+SerialCtrl::SerialCtrl()
+    : m_isOpen(false), m_droppedSamples(0), m_badLines(0), m_protocol(Protocol::ASCII), m_firmwareFeatures(0)
 {
-    m_pendingResponse = false;
-    connect(m_port.get(), &QSerialPort::readyRead, this, &SerialCtrl::handleReadyRead);
-    connect(m_port.get(), &QSerialPort::errorOccurred, this, &SerialCtrl::handleError);
-
-    // timer used to fix a bug in QSerialPort that causes readyRead to be broken
-    // 
-#if 0    
-    m_timer = new QTimer(this);    
-    connect(m_timer, &QTimer::timeout, this, &SerialCtrl::onTimer);
-    m_timer->start(50);
-#endif
+    m_outstanding = 0;
+    m_windowSize  = 4;    // the tracer buffers a few commands in its UART FIFO
+    m_holding     = false;
+    m_searchFinal = false;
+    m_sweepLimits = SweepLimits{};
+    m_sweepStop   = SweepStop::Complete;
+    m_sweepStopPwm = 0;
+    m_sweepEndsInFlight = 0;
+    m_sweepOpen   = false;
+    m_cancelling  = false;
+    m_cancelTimer = nullptr;
+    resetSettleStats();
 
+    m_thread.setObjectName("SerialCtrl");
+    moveToThread(&m_thread);
+    m_thread.start();
 };
 
-SerialCtrl* SerialCtrl::open(const std::string &devname, QObject *eventReceiver)
+SerialCtrl* SerialCtrl::open(const std::string &devname)
+{
+    return open(std::vector<std::string>{devname}).front();
+}
+
+std::vector<SerialCtrl*> SerialCtrl::open(const std::vector<std::string> &devnames)
+{
+    // the port must be created on the I/O thread so its
+    // notifications are handled there.
+    std::vector<std::unique_ptr<SerialCtrl>> ctrls;
+    std::vector<std::future<bool>> opened;
+    for(const auto &devname : devnames)
+    {
+        ctrls.emplace_back(new SerialCtrl());
+        auto ctrl = ctrls.back().get();
+
+        auto ok = std::make_shared<std::promise<bool>>();
+        opened.push_back(ok->get_future());
+        QMetaObject::invokeMethod(ctrl, [ctrl, ok, devname]()
+            {
+                ok->set_value(ctrl->openPort(devname));
+            }, Qt::QueuedConnection);
+    }
+
+    std::vector<SerialCtrl*> result;
+    for(size_t i=0; i<ctrls.size(); i++)
+    {
+        result.push_back(opened[i].get() ? ctrls[i].release() : nullptr);
+    }
+    return result;
+}
+
+bool SerialCtrl::openPort(const std::string &devname)
 {
     std::unique_ptr<QSerialPort> port(new QSerialPort());
 
@@ -34,191 +73,606 @@ SerialCtrl* SerialCtrl::open(const std::string &devname, QObject *eventReceiver)
 
     if (!port->open(QIODevice::ReadWrite))
     {
-        return nullptr;
-    }
-    else
-    {
-        port->readAll();
-        return new SerialCtrl(port.release(), eventReceiver);
+        return false;
     }
+
+    port->clear(QSerialPort::Input);
+    port->readAll();
+
+    m_protocol = negotiateProtocol(port.get(), m_firmwareFeatures);
+
+    m_port = std::move(port);
+    connect(m_port.get(), &QSerialPort::readyRead, this, &SerialCtrl::handleReadyRead);
+    connect(m_port.get(), &QSerialPort::errorOccurred, this, &SerialCtrl::handleError);
+
+    m_cancelTimer = new QTimer(this);
+    m_cancelTimer->setSingleShot(true);
+    connect(m_cancelTimer, &QTimer::timeout, this, &SerialCtrl::handleTimeout);
+
+    // timer used to fix a bug in QSerialPort that causes readyRead to be broken
+    // 
+#if 0    
+    m_timer = new QTimer(this);    
+    connect(m_timer, &QTimer::timeout, this, &SerialCtrl::onTimer);
+    m_timer->start(50);
+#endif
+
+    m_isOpen = true;
+    return true;
 }
 
-SerialCtrl::~SerialCtrl()
+void SerialCtrl::closePort()
 {
+    m_isOpen = false;
     if (m_port)
     {
         if (m_port->isOpen())
         {
             m_port->close();
         }
+        m_port.reset();
     }
 }
 
-bool SerialCtrl::isOpen() const
+SerialCtrl::Protocol SerialCtrl::negotiateProtocol(QSerialPort *port, uint32_t &firmwareFeatures)
 {
-    if (!m_port)
+    const int timeoutMs = 200;
+
+    const char request[] = "1P \n";
+    port->write(request, sizeof(request)-1);
+    port->waitForBytesWritten(timeoutMs);
+
+    // firmware that supports binary framing acknowledges with a
+    // response record holding the protocol magic. Older firmware
+    // doesn't, so we wait for it until the timeout.
+    BinaryFramer framer;
+    QElapsedTimer timer;
+    timer.start();
+
+    auto protocol = Protocol::ASCII;
+    while((timer.elapsed() < timeoutMs) && (protocol == Protocol::ASCII))
     {
-        return false;
+        if (!port->waitForReadyRead(timeoutMs - timer.elapsed()))
+        {
+            break;
+        }
+
+        auto buf = port->readAll();
+        const char *data = buf.constData();
+        size_t remaining = buf.size();
+        while(remaining > 0)
+        {
+            auto consumed = framer.write(data, remaining);
+            data += consumed;
+            remaining -= consumed;
+
+            int32_t v1, v2;
+            while(framer.readFrame(v1, v2))
+            {
+                if (v1 == BinaryFramer::c_protocolMagic)
+                {
+                    firmwareFeatures = static_cast<uint32_t>(v2);
+                    protocol = Protocol::Binary;
+                }
+            }
+        }
     }
 
-    return m_port->isOpen();
+    // discard whatever an older firmware may have
+    // sent in response to the unknown command.
+    if (protocol == Protocol::ASCII)
+    {
+        port->clear(QSerialPort::Input);
+        port->readAll();
+    }
+
+#ifdef DEBUGSERIAL
+    std::cout << "Serial protocol: " << ((protocol == Protocol::Binary) ? "binary" : "ASCII") << "\n";
+#endif
+
+    return protocol;
 }
 
-void SerialCtrl::close()
+SerialCtrl::~SerialCtrl()
 {
-    if (m_port)
+    if (m_thread.isRunning())
     {
-        m_port->close();
+        close();
+        m_thread.quit();
+        m_thread.wait();
     }
 }
 
-void SerialCtrl::run()
+bool SerialCtrl::isOpen() const
 {
-    if ((!m_pendingResponse) && m_port)
-    {
-        transmitCommand();
-    }
+    return m_isOpen;
+}
+
+void SerialCtrl::close()
+{
+    QMetaObject::invokeMethod(this, [this]()
+        {
+            closePort();
+        }, Qt::BlockingQueuedConnection);
+}
+
+void SerialCtrl::cancel()
+{
+    QMetaObject::invokeMethod(this, [this]()
+        {
+            cancelCommands();
+        }, Qt::BlockingQueuedConnection);
 }
 
-void SerialCtrl::transmitCommand()
+bool SerialCtrl::isBusy()
+{
+    bool busy = false;
+    QMetaObject::invokeMethod(this, [this, &busy]()
+        {
+            std::unique_lock<std::mutex> lock(m_commandMutex);
+            busy = m_sweepOpen || m_cancelling || !m_commands.empty() || !m_inFlight.empty();
+        }, Qt::BlockingQueuedConnection);
+    return busy;
+}
+
+void SerialCtrl::cancelCommands()
 {
-    if (m_commands.empty())
     {
-        #ifdef DEBUGSERIAL
-        std::cout << "TransmitCommand: queue empty\n";
-        #endif
-        return;
+        std::unique_lock<std::mutex> lock(m_commandMutex);
+        m_commands.clear();
+        if (!m_port)
+        {
+            return;
+        }
+
+        // leave the device without drive
+        m_commands.push_back(pwmCommand(CommandType::SETCOLLECTORPWM, 0, false));
+        m_commands.push_back(pwmCommand(CommandType::SETBASEPWM, 0, false));
+    }
+
+    // the tracer answers the commands that were sent, the
+    // responses are matched as usual but not reported. The
+    // markers behind them are dropped.
+    std::deque<Command> inFlight;
+    for(auto cmd : m_inFlight)
+    {
+        if (cmd.m_responsesLeft == 0)
+        {
+            continue;
+        }
+
+        if (cmd.m_type == CommandType::SEEKBASE)
+        {
+            cmd.m_type = CommandType::SETBASEPWM;
+        }
+        cmd.m_settle = SettleLimits{0, 1};
+        cmd.m_reportResponse = false;
+        inFlight.push_back(cmd);
+    }
+    m_inFlight.swap(inFlight);
+
+    m_sweepEndsInFlight = 0;
+    m_searchFinal = false;
+    if (m_sweepOpen)
+    {
+        pushSample(DataEvent::DataType::EndSweep, static_cast<int32_t>(SweepStop::Cancelled));
+        m_sweepOpen = false;
+    }
+    m_sweepLimits = SweepLimits{};
+    m_sweepStop   = SweepStop::Complete;
+
+    // nothing else is sent until the tracer has answered, so the
+    // responses can't be mistaken for those of the new commands.
+    m_cancelling = (m_outstanding != 0);
+    m_holding    = m_cancelling;
+    if (m_cancelling)
+    {
+        m_cancelTimer->start(c_cancelTimeoutMs);
     }
 
+    transmitCommands();
+}
+
+void SerialCtrl::finishCancel()
+{
+    m_cancelling = false;
+    m_holding    = false;
+    m_cancelTimer->stop();
+}
+
+void SerialCtrl::setWindowSize(uint32_t windowSize)
+{
+    m_windowSize = std::max(windowSize, 1U);
+}
+
+void SerialCtrl::run()
+{
+    QMetaObject::invokeMethod(this, [this]()
+        {
+            transmitCommands();
+        }, Qt::QueuedConnection);
+}
+
+void SerialCtrl::transmitCommands()
+{
+    std::unique_lock<std::mutex> lock(m_commandMutex);
+
     if (!m_port)
     {
-        // remove everything from the queue!
-        std::queue<Command> empty;
-        std::swap(m_commands, empty);
+        // remove everything from the queues!
+        m_commands.clear();
+        m_inFlight.clear();
+        m_outstanding = 0;
+        m_holding = false;
+        m_sweepEndsInFlight = 0;
+        m_cancelling = false;
         return;
     }
 
-    auto cmd = m_commands.front();
+    // the next reading of a settling command or a base current
+    // search depends on the last one, nothing else is sent meanwhile.
+    while(!m_commands.empty() && (m_outstanding < m_windowSize) && !m_holding)
+    {
+        auto cmd = m_commands.front();
+        m_commands.pop_front();
 
 #ifdef DEBUGSERIAL    
+        switch(cmd.m_type)
+        {
+        case CommandType::SETBASEPWM:
+            std::cout << "TransmitCommand: SETBASEPWM\n";
+            break;
+        case CommandType::SETCOLLECTORPWM:
+            std::cout << "TransmitCommand: SETCOLLECTORPWM\n";
+            break;
+        case CommandType::SETDIODEPWM:
+            std::cout << "TransmitCommand: SETDIODEPWM\n";
+            break;
+        case CommandType::STARTSWEEP:
+            std::cout << "TransmitCommand: STARTSWEEP\n";
+            break;
+        case CommandType::ENDSWEEP:
+            std::cout << "TransmitCommand: ENDSWEEP\n";
+            break;        
+        case CommandType::SWEEPCOLLECTOR:
+            std::cout << "TransmitCommand: SWEEPCOLLECTOR\n";
+            break;
+        case CommandType::SWEEPDIODE:
+            std::cout << "TransmitCommand: SWEEPDIODE\n";
+            break;
+        case CommandType::SEEKBASE:
+            std::cout << "TransmitCommand: SEEKBASE\n";
+            break;
+        case CommandType::ADAPTIVESWEEP:
+            std::cout << "TransmitCommand: ADAPTIVESWEEP\n";
+            break;
+        case CommandType::ADAPTIVEPOINT:
+            std::cout << "TransmitCommand: ADAPTIVEPOINT\n";
+            break;
+        case CommandType::ADAPTIVEROUND:
+            std::cout << "TransmitCommand: ADAPTIVEROUND\n";
+            break;
+        }
+#endif    
+
+        switch(cmd.m_type)
+        {
+        case CommandType::SETBASEPWM:
+        case CommandType::SETCOLLECTORPWM:
+        case CommandType::SETDIODEPWM:
+        case CommandType::ADAPTIVEPOINT:
+            m_holding = (cmd.m_settle.m_maxMeasurements > 1);
+            writeCommand(cmd);
+            m_outstanding++;
+            m_inFlight.push_back(cmd);
+            break;
+        case CommandType::SWEEPCOLLECTOR:
+        case CommandType::SWEEPDIODE:
+            writeCommand(cmd);
+            m_outstanding += cmd.m_responsesLeft;
+            m_inFlight.push_back(cmd);
+            break;
+        case CommandType::SEEKBASE:
+            cmd.m_pwm    = m_baseSearch.start(cmd.m_target);
+            cmd.m_pwmEnd = cmd.m_pwm;
+            m_holding     = true;
+            m_searchFinal = false;
+            m_searchTimer.start();
+            writeCommand(cmd);
+            m_outstanding++;
+            m_inFlight.push_back(cmd);
+            break;
+        case CommandType::ADAPTIVESWEEP:
+            queueAdaptiveRound(m_adaptiveSweep.start(cmd.m_adaptive));
+            break;
+        case CommandType::ADAPTIVEROUND:
+            // the next round depends on all points of this one
+            m_holding = true;
+            m_inFlight.push_back(cmd);
+            break;
+        case CommandType::ENDSWEEP:
+            m_sweepEndsInFlight++;
+            m_inFlight.push_back(cmd);
+            break;
+        case CommandType::STARTSWEEP:
+            // markers are not sent to the tracer but they must be
+            // reported in order with the responses.
+            m_inFlight.push_back(cmd);
+            break;
+        default:
+            // invalid command!
+            break;
+        }
+    }
+
+#ifdef DEBUGSERIAL
+    if (m_commands.empty() && m_inFlight.empty())
+    {
+        std::cout << "TransmitCommand: queue empty\n";
+    }
+#endif
+
+    lock.unlock();
+
+    m_port->flush();
+
+    retireCommands();
+}
+
+void SerialCtrl::writeCommand(const Command &cmd)
+{
+    char command;
     switch(cmd.m_type)
     {
     case CommandType::SETBASEPWM:
-        std::cout << "TransmitCommand: SETBASEPWM\n";
+    case CommandType::SEEKBASE:
+        command = 'B';
         break;
     case CommandType::SETCOLLECTORPWM:
-        std::cout << "TransmitCommand: SETCOLLECTORPWM\n";
-        break;
     case CommandType::SETDIODEPWM:
-        std::cout << "TransmitCommand: SETDIODEPWM\n";
+    case CommandType::ADAPTIVEPOINT:
+        command = 'C';
         break;
-    case CommandType::STARTSWEEP:
-        std::cout << "TransmitCommand: STARTSWEEP\n";
+    case CommandType::SWEEPCOLLECTOR:
+    case CommandType::SWEEPDIODE:
+        command = 'S';
         break;
-    case CommandType::ENDSWEEP:
-        std::cout << "TransmitCommand: ENDSWEEP\n";
-        break;        
+    default:
+        return;
     }
-#endif    
 
-    std::stringstream ss;
-    std::string txstr;
-    switch(cmd.m_type)
+    if (m_protocol == Protocol::Binary)
     {
-    case CommandType::SETBASEPWM:
-        ss << cmd.m_pwm << "B \n";
-        txstr = ss.str();
-        m_port->write(txstr.c_str(), txstr.size());
-        m_port->flush();
-        m_pendingResponse = true;
-        break;
-    case CommandType::SETCOLLECTORPWM:
-        ss << cmd.m_pwm << "C \n";
-        txstr = ss.str();
-        m_port->write(txstr.c_str(), txstr.size());
-        m_port->flush();
-        m_pendingResponse = true;
-        break; 
-    case CommandType::SETDIODEPWM:
-        ss << cmd.m_pwm << "C \n";
-        txstr = ss.str();
+        auto record = BinaryFramer::encodeCommand(command, cmd.m_pwm, cmd.m_pwmEnd, cmd.m_pwmStep);
+        m_port->write(reinterpret_cast<const char*>(record.data()), record.size());
+    }
+    else
+    {
+        std::stringstream ss;
+        if (command == 'S')
+        {
+            ss << cmd.m_pwm << " " << cmd.m_pwmEnd << " " << cmd.m_pwmStep;
+        }
+        else
+        {
+            ss << cmd.m_pwm;
+        }
+        ss << command << " \n";
+        auto txstr = ss.str();
         m_port->write(txstr.c_str(), txstr.size());
-        m_port->flush();
-        m_pendingResponse = true;
-        break;         
-    case CommandType::STARTSWEEP:
-        QApplication::postEvent(m_eventReceiver, new DataEvent("", DataEvent::DataType::StartSweep));
-        m_commands.pop();
-        transmitCommand();
-        break;
-    case CommandType::ENDSWEEP:
-        QApplication::postEvent(m_eventReceiver, new DataEvent("", DataEvent::DataType::EndSweep));
-        m_commands.pop();
-        transmitCommand();
-        break;        
-    default:
-        // invalid command!
-        break;
     }
 }
 
-void SerialCtrl::setBasePWM(uint16_t dutyCycle, bool noMeasurement)
+void SerialCtrl::retireCommands()
 {
-    Command cmd;
-    cmd.m_pwm = dutyCycle;
-    cmd.m_reportResponse = !noMeasurement;
-    cmd.m_type = CommandType::SETBASEPWM;
-    cmd.m_response[0] = 0;
-    cmd.m_response[1] = 0;
+    while(!m_inFlight.empty())
+    {
+        auto const& cmd = m_inFlight.front();
+        if (cmd.m_type == CommandType::STARTSWEEP)
+        {
+            m_sweepLimits = cmd.m_limits;
+            m_sweepStop   = SweepStop::Complete;
+            m_sweepOpen   = true;
+            pushSample(DataEvent::DataType::StartSweep);
+        }
+        else if (cmd.m_type == CommandType::ENDSWEEP)
+        {
+            pushSample(DataEvent::DataType::EndSweep, static_cast<int32_t>(m_sweepStop),
+                (m_sweepStop != SweepStop::Complete) ? m_sweepStopPwm : 0);
+            m_sweepLimits = SweepLimits{};
+            m_sweepStop   = SweepStop::Complete;
+            m_sweepOpen   = false;
+            m_sweepEndsInFlight--;
+        }
+        else if (cmd.m_type == CommandType::ADAPTIVEROUND)
+        {
+            m_inFlight.pop_front();
+            finishAdaptiveRound();
+            continue;
+        }
+        else
+        {
+            // still waiting for a response
+            return;
+        }
+        m_inFlight.pop_front();
+    }
+}
+
+void SerialCtrl::queueAdaptiveRound(const std::vector<uint16_t> &pwms)
+{
+    Command marker;
+    marker.m_type = CommandType::ADAPTIVEROUND;
+    marker.m_reportResponse = true;
+    marker.m_responsesLeft = 0;
+    m_commands.push_front(marker);
+
+    for(auto pwm = pwms.rbegin(); pwm != pwms.rend(); ++pwm)
+    {
+        m_commands.push_front(pwmCommand(CommandType::ADAPTIVEPOINT, *pwm, true));
+    }
+}
 
-    m_commands.push(cmd);
+void SerialCtrl::finishAdaptiveRound()
+{
+    const auto &round = m_adaptiveSweep.refine();
+    if (round.empty())
+    {
+        for(const auto &point : m_adaptiveSweep.points())
+        {
+            pushSample(DataEvent::DataType::Collector, point.m_reading.m_v1, point.m_reading.m_v2);
+        }
+    }
+    else
+    {
+        std::unique_lock<std::mutex> lock(m_commandMutex);
+        queueAdaptiveRound(round);
+    }
+
+    // the commands are sent from the event loop, this
+    // can be called while the queue is being transmitted.
+    m_holding = false;
+    run();
 }
 
-void SerialCtrl::setCollectorPWM(uint16_t dutyCycle, bool noMeasurement)
+void SerialCtrl::pushSample(DataEvent::DataType type, int32_t v1, int32_t v2)
+{
+    // never block the I/O thread on a stalled consumer
+    if (!m_samples.push(AdcSample{type, v1, v2}))
+    {
+        m_droppedSamples++;
+    }
+}
+
+void SerialCtrl::pushCommand(const Command &cmd)
+{
+    std::unique_lock<std::mutex> lock(m_commandMutex);
+    m_commands.push_back(cmd);
+}
+
+SerialCtrl::Command SerialCtrl::pwmCommand(CommandType type, uint16_t dutyCycle, bool reportResponse)
 {
     Command cmd;
     cmd.m_pwm = dutyCycle;
-    cmd.m_reportResponse = !noMeasurement;
-    cmd.m_type = CommandType::SETCOLLECTORPWM;
+    cmd.m_reportResponse = reportResponse;
+    cmd.m_type = type;
+    cmd.m_pwmEnd  = dutyCycle;
+    cmd.m_pwmStep = 0;
+    cmd.m_responsesLeft = 1;
     cmd.m_response[0] = 0;
     cmd.m_response[1] = 0;
+    return cmd;
+}
 
-    m_commands.push(cmd);  
+void SerialCtrl::setBasePWM(uint16_t dutyCycle, bool noMeasurement)
+{
+    pushCommand(pwmCommand(CommandType::SETBASEPWM, dutyCycle, !noMeasurement));
+}
+
+void SerialCtrl::setCollectorPWM(uint16_t dutyCycle, bool noMeasurement)
+{
+    pushCommand(pwmCommand(CommandType::SETCOLLECTORPWM, dutyCycle, !noMeasurement));
 }
 
 void SerialCtrl::setDiodePWM(uint16_t dutyCycle, bool noMeasurement)
 {
-    Command cmd;
-    cmd.m_pwm = dutyCycle;
-    cmd.m_reportResponse = !noMeasurement;
-    cmd.m_type = CommandType::SETDIODEPWM;
-    cmd.m_response[0] = 0;
-    cmd.m_response[1] = 0;
+    pushCommand(pwmCommand(CommandType::SETDIODEPWM, dutyCycle, !noMeasurement));
+}
 
-    m_commands.push(cmd);
+void SerialCtrl::settleBasePWM(uint16_t dutyCycle, const SettleLimits &settle)
+{
+    auto cmd = pwmCommand(CommandType::SETBASEPWM, dutyCycle, true);
+    cmd.m_settle = settle;
+    pushCommand(cmd);
 }
 
+void SerialCtrl::seekBaseCurrent(const BaseCurrentSearch::Target &target, const SettleLimits &settle)
+{
+    auto cmd = pwmCommand(CommandType::SEEKBASE, target.m_pwm, true);
+    cmd.m_settle = settle;
+    cmd.m_target = target;
+    pushCommand(cmd);
+}
+
+SerialCtrl::SettleStats SerialCtrl::settleStats() const noexcept
+{
+    SettleStats stats;
+    stats.m_steps           = m_settleSteps;
+    stats.m_measurements    = m_settleMeasurements;
+    stats.m_unsettled       = m_settleUnsettled;
+    stats.m_maxMeasurements = m_settleMaxMeasurements;
+    return stats;
+}
 
-void SerialCtrl::startSweep()
+void SerialCtrl::resetSettleStats() noexcept
+{
+    m_settleSteps = 0;
+    m_settleMeasurements = 0;
+    m_settleUnsettled = 0;
+    m_settleMaxMeasurements = 0;
+}
+
+void SerialCtrl::startSweep(const SweepLimits &limits)
 {
     Command cmd;
     cmd.m_reportResponse = true;
+    cmd.m_responsesLeft = 0;
     cmd.m_type = CommandType::STARTSWEEP;
-    m_commands.push(cmd);
+    cmd.m_limits = limits;
+    pushCommand(cmd);
 }
 
 void SerialCtrl::endSweep()
 {
     Command cmd;
     cmd.m_reportResponse = true;
+    cmd.m_responsesLeft = 0;
     cmd.m_type = CommandType::ENDSWEEP;
-    m_commands.push(cmd);
+    pushCommand(cmd);
 }
 
 
-void SerialCtrl::sweepCollector(uint16_t dutyStart, uint16_t dutyEnd, uint16_t step)
+bool SerialCtrl::deviceSweep(CommandType type, uint16_t dutyStart, uint16_t dutyEnd, uint16_t step, const SweepLimits &limits)
 {
-    startSweep();
+    if (((m_firmwareFeatures & BinaryFramer::c_featureSweep) == 0) || (step == 0) || (dutyEnd < dutyStart))
+    {
+        return false;
+    }
+
+    // the tracer can't be stopped during a device-side sweep, it
+    // would drive the part up to dutyEnd past a limit. The host
+    // steps a sweep with limits and stops sending at the limit.
+    if ((limits.m_maxCurrent > 0.0f) || (limits.m_maxVoltage > 0.0f) || (limits.m_maxPower > 0.0f))
+    {
+        return false;
+    }
+
+    Command cmd;
+    cmd.m_type    = type;
+    cmd.m_pwm     = dutyStart;
+    cmd.m_pwmEnd  = dutyEnd;
+    cmd.m_pwmStep = step;
+    cmd.m_responsesLeft = (dutyEnd - dutyStart) / step + 1;
+    cmd.m_reportResponse = true;
+    cmd.m_response[0] = 0;
+    cmd.m_response[1] = 0;
+
+    startSweep(limits);
+    pushCommand(cmd);
+    endSweep();
+    return true;
+}
+
+void SerialCtrl::sweepCollector(uint16_t dutyStart, uint16_t dutyEnd, uint16_t step, const SweepLimits &limits)
+{
+    // a single request with a streamed response burst
+    // avoids a round trip per step.
+    if (deviceSweep(CommandType::SWEEPCOLLECTOR, dutyStart, dutyEnd, step, limits))
+    {
+        return;
+    }
+
+    startSweep(limits);
     for(uint16_t duty = dutyStart; duty <= dutyEnd; duty += step)
     {
         setCollectorPWM(duty);        
@@ -226,6 +680,19 @@ void SerialCtrl::sweepCollector(uint16_t dutyStart, uint16_t dutyEnd, uint16_t s
     endSweep();
 }
 
+void SerialCtrl::sweepCollectorAdaptive(const AdaptiveSweep::Limits &limits, const SweepLimits &sweepLimits)
+{
+    Command cmd;
+    cmd.m_type = CommandType::ADAPTIVESWEEP;
+    cmd.m_reportResponse = true;
+    cmd.m_responsesLeft = 0;
+    cmd.m_adaptive = limits;
+
+    startSweep(sweepLimits);
+    pushCommand(cmd);
+    endSweep();
+}
+
 void SerialCtrl::sweepBase(uint16_t dutyStart, uint16_t dutyEnd, uint16_t step)
 {
     startSweep();
@@ -236,9 +703,14 @@ void SerialCtrl::sweepBase(uint16_t dutyStart, uint16_t dutyEnd, uint16_t step)
     endSweep();
 }
 
-void SerialCtrl::sweepDiode(uint16_t dutyStart, uint16_t dutyEnd, uint16_t step)
+void SerialCtrl::sweepDiode(uint16_t dutyStart, uint16_t dutyEnd, uint16_t step, const SweepLimits &limits)
 {
-    startSweep();
+    if (deviceSweep(CommandType::SWEEPDIODE, dutyStart, dutyEnd, step, limits))
+    {
+        return;
+    }
+
+    startSweep(limits);
     for(uint16_t duty = dutyStart; duty <= dutyEnd; duty += step)
     {
         setDiodePWM(duty);
@@ -249,47 +721,316 @@ void SerialCtrl::sweepDiode(uint16_t dutyStart, uint16_t dutyEnd, uint16_t step)
 
 void SerialCtrl::handleReadyRead()
 {
+    if (!m_port)
+    {
+        return;
+    }
+
     auto buf = m_port->readAll();
 
     //std::cout << "serial read: '" << buf.toStdString() << "'\n";
 
-    std::string response;
-    for(char c : buf)
+    // a read can hold a partial response or several responses,
+    // every complete response is the answer to exactly one command.
+    const char *data = buf.constData();
+    size_t remaining = buf.size();
+    while(remaining > 0)
     {
-        if (isAcceptableChar(c))
+        if (m_protocol == Protocol::Binary)
         {
-            response += c;
+            auto consumed = m_binaryFramer.write(data, remaining);
+            data += consumed;
+            remaining -= consumed;
+
+            int32_t v1, v2;
+            while(m_binaryFramer.readFrame(v1, v2))
+            {
+                handleResponse(v1, v2);
+            }
         }
-        
-        if (isEOL(c))
+        else
         {
-            break;
+            auto consumed = m_framer.write(data, remaining);
+            data += consumed;
+            remaining -= consumed;
+
+            const char *line;
+            size_t len;
+            while(m_framer.readLine(line, len))
+            {
+                int32_t v1, v2;
+                if (!LineFramer::parseValues(line, len, v1, v2))
+                {
+                    m_badLines++;
+                    discardResponse();
+                    continue;
+                }
+                handleResponse(v1, v2);
+            }
+        }
+    }
+
+    if (m_cancelling)
+    {
+        if (m_outstanding == 0)
+        {
+            finishCancel();
+        }
+        else
+        {
+            m_cancelTimer->start(c_cancelTimeoutMs);
+        }
+    }
+
+    transmitCommands();  // refill the window
+}
+
+void SerialCtrl::handleResponse(int32_t v1, int32_t v2)
+{
+    if (m_inFlight.empty())
+    {
+        // unsolicited data, nothing to match it with
+        return;
+    }
+
+    // responses arrive in the order the commands were sent,
+    // a device-side sweep produces several responses.
+    m_outstanding--;
+    if ((m_inFlight.front().m_settle.m_maxMeasurements > 1) && !settle(m_inFlight.front(), AdcPair{v1, v2}))
+    {
+        return;
+    }
+
+    auto cmd = m_inFlight.front();
+    if (cmd.m_type == CommandType::SEEKBASE)
+    {
+        continueBaseSearch(AdcPair{v1, v2});
+        retireCommands();
+        return;
+    }
+
+    // points sent before a limit was reached are measured
+    // but not reported, the device may be out of bounds.
+    bool report = cmd.m_reportResponse;
+    switch(cmd.m_type)
+    {
+    case CommandType::SETCOLLECTORPWM:
+    case CommandType::SETDIODEPWM:
+    case CommandType::SWEEPCOLLECTOR:
+    case CommandType::SWEEPDIODE:
+    case CommandType::ADAPTIVEPOINT:
+        if (report && (m_sweepStop != SweepStop::Complete))
+        {
+            report = (responsePwm(cmd) <= m_sweepStopPwm);
+        }
+        else if (report)
+        {
+            const auto stop = checkLimits(m_sweepLimits, AdcPair{v1, v2});
+            if (stop != SweepStop::Complete)
+            {
+                stopSweep(stop, responsePwm(cmd));
+            }
         }
+        break;
+    default:
+        break;
     }
 
-    auto cmd = m_commands.front();
-    m_commands.pop();
+    if (--m_inFlight.front().m_responsesLeft == 0)
+    {
+        if (cmd.m_settle.m_maxMeasurements > 1)
+        {
+            m_holding = false;
+        }
+        m_inFlight.pop_front();
+    }
 
-    if (cmd.m_reportResponse)
+    if (report)
     {
         switch(cmd.m_type)       
         {
         case CommandType::SETCOLLECTORPWM:
-            QApplication::postEvent(m_eventReceiver, new DataEvent(response, DataEvent::DataType::Collector));
+        case CommandType::SWEEPCOLLECTOR:
+            pushSample(DataEvent::DataType::Collector, v1, v2);
             break;
         case CommandType::SETBASEPWM:
-            QApplication::postEvent(m_eventReceiver, new DataEvent(response, DataEvent::DataType::Base));
+            pushSample(DataEvent::DataType::Base, v1, v2);
             break;
         case CommandType::SETDIODEPWM:
-            QApplication::postEvent(m_eventReceiver, new DataEvent(response, DataEvent::DataType::Diode));
+        case CommandType::SWEEPDIODE:
+            pushSample(DataEvent::DataType::Diode, v1, v2);
+            break;
+        case CommandType::ADAPTIVEPOINT:
+            // reported sorted when the sweep is complete
+            m_adaptiveSweep.addPoint(static_cast<uint16_t>(cmd.m_pwm), AdcPair{v1, v2});
+            break;
+        default:
             break;
         }
     }
 
-    //std::cout << "Response RX: " << response << " queue=" << m_commands.size() << "\n";
-    m_pendingResponse = false;
+    //std::cout << "Response RX: " << v1 << " " << v2 << " queue=" << m_commands.size() << "\n";
 
-    run();  // trigger next command TX
+    retireCommands();
+}
+
+void SerialCtrl::discardResponse()
+{
+    if (m_inFlight.empty())
+    {
+        return;
+    }
+
+    m_outstanding--;
+    auto &cmd = m_inFlight.front();
+    if ((cmd.m_type == CommandType::SEEKBASE) || (cmd.m_settle.m_maxMeasurements > 1))
+    {
+        writeCommand(cmd);
+        m_outstanding++;
+        return;
+    }
+
+    if (--cmd.m_responsesLeft == 0)
+    {
+        m_inFlight.pop_front();
+    }
+
+    retireCommands();
+}
+
+void SerialCtrl::continueBaseSearch(const AdcPair &measurement)
+{
+    auto &cmd = m_inFlight.front();
+
+    uint16_t pwm;
+    if (!m_searchFinal && m_baseSearch.next(measurement, pwm))
+    {
+        cmd.m_pwm    = pwm;
+        cmd.m_pwmEnd = pwm;
+        writeCommand(cmd);
+        m_outstanding++;
+        return;
+    }
+
+    // the tolerance wasn't reached, go back to the closest PWM
+    if (!m_searchFinal && (m_baseSearch.bestPwm() != cmd.m_pwm))
+    {
+        m_searchFinal = true;
+        cmd.m_pwm    = m_baseSearch.bestPwm();
+        cmd.m_pwmEnd = cmd.m_pwm;
+        writeCommand(cmd);
+        m_outstanding++;
+        return;
+    }
+
+    const auto measurements = static_cast<int32_t>(m_baseSearch.iterations() + (m_searchFinal ? 1 : 0));
+    pushSample(DataEvent::DataType::BaseSearch, m_baseSearch.converged() ? measurements : -measurements,
+        static_cast<int32_t>(m_searchTimer.nsecsElapsed() / 1000));
+    pushSample(DataEvent::DataType::Base, measurement.m_v1, measurement.m_v2);
+
+    m_inFlight.pop_front();
+    m_holding     = false;
+    m_searchFinal = false;
+}
+
+SerialCtrl::SweepStop SerialCtrl::checkLimits(const SweepLimits &limits, const AdcPair &reading)
+{
+    const float c1 = limits.m_gain[0] * static_cast<float>(reading.m_v1) + limits.m_offset[0];
+    const float c2 = limits.m_gain[1] * static_cast<float>(reading.m_v2) + limits.m_offset[1];
+    const float current = c1 - c2;
+
+    if ((limits.m_maxCurrent > 0.0f) && (current > limits.m_maxCurrent))
+    {
+        return SweepStop::Current;
+    }
+
+    if ((limits.m_maxVoltage > 0.0f) && (c2 > limits.m_maxVoltage))
+    {
+        return SweepStop::Voltage;
+    }
+
+    if ((limits.m_maxPower > 0.0f) && (c2 * current > limits.m_maxPower))
+    {
+        return SweepStop::Power;
+    }
+
+    return SweepStop::Complete;
+}
+
+int32_t SerialCtrl::responsePwm(const Command &cmd)
+{
+    if (((cmd.m_type != CommandType::SWEEPCOLLECTOR) && (cmd.m_type != CommandType::SWEEPDIODE)) || (cmd.m_pwmStep == 0))
+    {
+        return cmd.m_pwm;
+    }
+
+    // device-side sweeps answer in PWM order
+    const int32_t responses = (cmd.m_pwmEnd - cmd.m_pwm) / cmd.m_pwmStep + 1;
+    return cmd.m_pwm + (responses - static_cast<int32_t>(cmd.m_responsesLeft)) * cmd.m_pwmStep;
+}
+
+void SerialCtrl::stopSweep(SweepStop reason, int32_t pwm)
+{
+    m_sweepStop    = reason;
+    m_sweepStopPwm = pwm;
+
+    std::unique_lock<std::mutex> lock(m_commandMutex);
+
+    // the end of the sweep is still queued unless it was sent,
+    // anything queued before it belongs to this sweep.
+    auto end = m_commands.begin();
+    if (m_sweepEndsInFlight == 0)
+    {
+        end = std::find_if(m_commands.begin(), m_commands.end(),
+            [](const Command &cmd) { return cmd.m_type == CommandType::ENDSWEEP; });
+    }
+
+    // an adaptive sweep keeps its round markers, it is
+    // refined below the limit and reported as usual.
+    m_commands.erase(std::remove_if(m_commands.begin(), end, [](const Command &cmd)
+        {
+            return (cmd.m_type == CommandType::SETCOLLECTORPWM) ||
+                (cmd.m_type == CommandType::SETDIODEPWM) ||
+                (cmd.m_type == CommandType::ADAPTIVEPOINT);
+        }), end);
+
+    m_commands.push_front(pwmCommand(CommandType::SETCOLLECTORPWM, 0, false));
+}
+
+bool SerialCtrl::settle(Command &cmd, const AdcPair &reading)
+{
+    cmd.m_readings++;
+
+    const bool agree = (cmd.m_readings > 1) &&
+        (std::abs(reading.m_v1 - cmd.m_response[0]) <= cmd.m_settle.m_tolerance) &&
+        (std::abs(reading.m_v2 - cmd.m_response[1]) <= cmd.m_settle.m_tolerance);
+
+    cmd.m_response[0] = reading.m_v1;
+    cmd.m_response[1] = reading.m_v2;
+
+    if (agree || (cmd.m_readings >= cmd.m_settle.m_maxMeasurements))
+    {
+        m_settleSteps++;
+        m_settleMeasurements += cmd.m_readings;
+        if (!agree)
+        {
+            m_settleUnsettled++;
+        }
+
+        if (cmd.m_readings > m_settleMaxMeasurements)
+        {
+            m_settleMaxMeasurements = cmd.m_readings;
+        }
+
+        // the next PWM of a base current search is settled again
+        cmd.m_readings = 0;
+        return true;
+    }
+
+    // measure again at the same PWM
+    writeCommand(cmd);
+    m_outstanding++;
+    return false;
 }
 
 void SerialCtrl::handleError(QSerialPort::SerialPortError error)
@@ -318,7 +1059,25 @@ void SerialCtrl::handleError(QSerialPort::SerialPortError error)
 
 void SerialCtrl::handleTimeout()
 {
+    if (!m_cancelling)
+    {
+        return;
+    }
+
+    // the tracer stopped answering the cancelled commands,
+    // forget them along with anything partially received.
+    m_inFlight.clear();
+    m_outstanding = 0;
+    if (m_port)
+    {
+        m_port->clear(QSerialPort::Input);
+        m_port->readAll();
+    }
+    m_framer.clear();
+    m_binaryFramer.clear();
 
+    finishCancel();
+    transmitCommands();
 }
 
 void SerialCtrl::onTimer()
@@ -1,33 +1,189 @@
 #pragma once
 #include <string>
+#include <vector>
 #include <memory>
-#include <queue>
+#include <deque>
+#include <mutex>
+#include <atomic>
 #include "customevent.h"
+#include "lineframer.h"
+#include "binaryframer.h"
+#include "spscring.h"
+#include "basecurrentsearch.h"
+#include "adaptivesweep.h"
 #include <QtSerialPort/QSerialPort>
+#include <QThread>
 #include <QTimer>
+#include <QElapsedTimer>
 
+/** controls the curve tracer over a serial port.
+
+    The serial port is serviced by a dedicated I/O thread so that
+    acquisition doesn't depend on the GUI event loop. Commands can be
+    queued from the GUI thread, parsed responses are delivered through
+    a lock-free ring that the GUI drains with samples().
+*/
 class SerialCtrl : public QObject
 {
     Q_OBJECT
 
 public:
     virtual ~SerialCtrl();
+
+    enum class Protocol
+    {
+        ASCII,      // "123C \n" commands, tab separated decimal responses
+        Binary      // fixed-size records, see binaryframer.h
+    };
     
-    static SerialCtrl* open(const std::string &devname, QObject *eventReceiver);
+    using SampleRing = SpscRing<AdcSample, 65536>;
+
+    /** a settled measurement is repeated until two consecutive readings
+        agree within m_tolerance counts on both channels, or until
+        m_maxMeasurements readings were taken. Only the last reading
+        is reported. */
+    struct SettleLimits
+    {
+        int32_t  m_tolerance;
+        uint16_t m_maxMeasurements;     // 1 disables settling
+    };
+
+    /** totals of all settled measurements since the last reset */
+    struct SettleStats
+    {
+        uint64_t m_steps;               // number of settled measurements
+        uint64_t m_measurements;        // readings taken for them
+        uint64_t m_unsettled;           // steps that ran out of readings
+        uint32_t m_maxMeasurements;     // most readings needed by a step
+    };
+
+    /** conditions that end a collector or diode sweep early. They are
+        checked on every response of the sweep, after the gain and
+        offset of the setup are applied: v2 is the voltage across the
+        device, v1-v2 the voltage across the collector resistor and
+        their product is proportional to the power. A limit of 0 is
+        not checked. */
+    struct SweepLimits
+    {
+        float m_gain[2];
+        float m_offset[2];
+        float m_maxCurrent;     // counts across the collector resistor
+        float m_maxVoltage;     // counts across the device
+        float m_maxPower;       // counts squared
+    };
+
+    /** reason a sweep ended, reported in v1 of the EndSweep sample.
+        v2 holds the PWM of the response that reached the limit. */
+    enum class SweepStop : int32_t
+    {
+        Complete = 0,
+        Current,
+        Voltage,
+        Power,
+        Cancelled       // see cancel()
+    };
+
+    /** the commands queued after cancel() wait at most this long
+        for a response to one of the cancelled commands */
+    static constexpr int c_cancelTimeoutMs = 100;
+
+    static SerialCtrl* open(const std::string &devname);
+
+    /** open several tracers at once. The protocol of each is negotiated
+        on its own I/O thread, so the time that older firmware takes to
+        not answer is spent once. The entries of the ports that can't be
+        opened are null. */
+    static std::vector<SerialCtrl*> open(const std::vector<std::string> &devnames);
 
-    void sweepCollector(uint16_t dutyStart, uint16_t dutyEnd, uint16_t step);
+    /** the sweeps end early when a response exceeds the limits.
+        The queued points of the sweep are dropped and the collector
+        PWM is set to 0 before the commands of the next sweep are sent.
+        Responses of points that were already sent are not reported.
+        A sweep with limits is stepped by the host, also when the
+        firmware has the device-side sweep. */
+    void sweepCollector(uint16_t dutyStart, uint16_t dutyEnd, uint16_t step, const SweepLimits &limits = SweepLimits{});
+
+    /** collector sweep that is refined where the curve bends, see
+        AdaptiveSweep. Each round is measured before the next one is
+        planned and the commands behind the sweep wait until it is
+        complete. The responses are reported sorted by PWM. */
+    void sweepCollectorAdaptive(const AdaptiveSweep::Limits &limits, const SweepLimits &sweepLimits = SweepLimits{});
     void sweepBase(uint16_t dutyStart, uint16_t dutyEnd, uint16_t step);
-    void sweepDiode(uint16_t dutyStart, uint16_t dutyEnd, uint16_t step);
+    void sweepDiode(uint16_t dutyStart, uint16_t dutyEnd, uint16_t step, const SweepLimits &limits = SweepLimits{});
         
     void setBasePWM(uint16_t dutyCycle, bool noMeasurement = false);
     void setCollectorPWM(uint16_t dutyCycle, bool noMeasurement = false);
     void setDiodePWM(uint16_t dutyCycle, bool noMeasurement = false);
 
+    /** set the base PWM and measure until the reading has settled.
+        The commands behind it wait until it has settled. */
+    void settleBasePWM(uint16_t dutyCycle, const SettleLimits &settle);
+
+    /** set the base PWM that results in the target base current, see
+        BaseCurrentSearch. Every measurement of the search is settled.
+        The commands behind it wait until the search has ended. The search is reported as a BaseSearch sample with the
+        number of measurements in v1, negative if the tolerance wasn't
+        reached, and the time taken in microseconds in v2. It is followed
+        by a Base sample with the last measurement. */
+    void seekBaseCurrent(const BaseCurrentSearch::Target &target, const SettleLimits &settle);
+
+    SettleStats settleStats() const noexcept;
+    void resetSettleStats() noexcept;
+
+    /** drop all queued commands and set the base and collector PWM
+        to 0. The responses to the commands that were already sent are
+        not reported. Commands that are queued after cancel() are sent
+        once the tracer has answered those, or hasn't answered for
+        c_cancelTimeoutMs. A sweep that was being reported ends with
+        SweepStop::Cancelled, before cancel() returns. */
+    void cancel();
+
+    /** returns true if commands are queued or in flight, or a sweep
+        is being reported. Waits for the I/O thread, like cancel(). */
+    bool isBusy();
+
     bool isOpen() const;
     void close();
 
+    /** set the maximum number of commands that can be in flight,
+        i.e. transmitted but not yet answered by the tracer.
+        A window size of 1 results in stop-and-wait behaviour. */
+    void setWindowSize(uint32_t windowSize);
+
+    uint32_t windowSize() const noexcept
+    {
+        return m_windowSize.load();
+    }
+
+    /** protocol negotiated with the tracer when the port was opened */
+    Protocol protocol() const noexcept
+    {
+        return m_protocol;
+    }
+
+    /** start transmitting the queued commands */
     void run();
 
+    /** parsed responses and sweep markers, in command order.
+        only a single thread may pop from the ring. */
+    SampleRing& samples() noexcept
+    {
+        return m_samples;
+    }
+
+    /** number of samples lost because the ring was full */
+    uint32_t droppedSamples() const noexcept
+    {
+        return m_droppedSamples.load();
+    }
+
+    /** number of ASCII response lines that didn't hold two values.
+        They answer a command, but nothing is reported for them. */
+    uint32_t badLines() const noexcept
+    {
+        return m_badLines.load();
+    }
+
 protected slots:
     void handleReadyRead();
     void handleError(QSerialPort::SerialPortError error);
@@ -36,25 +192,58 @@ protected slots:
     void onTimer();
 
 protected:
-    SerialCtrl(QSerialPort *port, QObject *eventReceiver);
+    SerialCtrl();
+
+    /** open the port and negotiate the protocol, runs on the I/O thread */
+    bool openPort(const std::string &devname);
+
+    /** close the port, runs on the I/O thread */
+    void closePort();
+
+    /** try to switch the tracer to binary framing, falls back to ASCII */
+    static Protocol negotiateProtocol(QSerialPort *port, uint32_t &firmwareFeatures);
     
-    void startSweep();
+    void startSweep(const SweepLimits &limits = SweepLimits{});
     void endSweep();
 
-    void transmitCommand();
+    /** transmit commands until the window is full or the queue is empty */
+    void transmitCommands();
 
-    constexpr bool isEOL(char c) const noexcept
-    {
-        return ((c==10) || (c==13));
-    }
+    /** match a single response with the oldest in-flight command */
+    void handleResponse(int32_t v1, int32_t v2);
 
-    constexpr bool isAcceptableChar(char c) const noexcept
-    {
-        return ((c >= '0') && (c <= '9')) || (c=='\t') || (c==' ');
-    }
+    /** retire the response of the oldest in-flight command without
+        a reading. A command that repeats itself measures again. */
+    void discardResponse();
+
+    /** handle a measurement of the base current search at the head of the in-flight queue */
+    void continueBaseSearch(const AdcPair &measurement);
+
+    /** report sweep markers that are at the head of the in-flight queue */
+    void retireCommands();
+
+    /** cancel the queued and in-flight commands, runs on the I/O thread */
+    void cancelCommands();
 
+    /** resume transmission after the cancelled commands were answered */
+    void finishCancel();
+
+    /** hand a sample to the consumer of samples() */
+    void pushSample(DataEvent::DataType type, int32_t v1 = 0, int32_t v2 = 0);
+
+    QThread m_thread;
     std::unique_ptr<QSerialPort> m_port;
-    QObject *m_eventReceiver;
+    std::atomic<bool> m_isOpen;
+
+    SampleRing m_samples;
+    std::atomic<uint32_t> m_droppedSamples;
+    std::atomic<uint32_t> m_badLines;
+
+    LineFramer m_framer;
+    BinaryFramer m_binaryFramer;
+
+    Protocol m_protocol;
+    uint32_t m_firmwareFeatures;    // feature flags reported in the binary mode acknowledge
 
     enum class CommandType
     {
@@ -63,19 +252,92 @@ protected:
         SETCOLLECTORPWM,
         SETDIODEPWM,
         STARTSWEEP,
-        ENDSWEEP
+        ENDSWEEP,
+        SWEEPCOLLECTOR,     // device-side sweep, streams a response per step
+        SWEEPDIODE,
+        SEEKBASE,           // closed-loop base PWM, one measurement in flight at a time
+        ADAPTIVESWEEP,      // plans the first round of an adaptive collector sweep
+        ADAPTIVEPOINT,      // collector measurement of an adaptive sweep
+        ADAPTIVEROUND       // marks the end of a round of an adaptive sweep
     };
 
     struct Command
     {
         CommandType m_type;
-        int32_t     m_pwm;
+        int32_t     m_pwm;              // PWM or sweep start
+        int32_t     m_pwmEnd;           // device-side sweeps only
+        int32_t     m_pwmStep;          // device-side sweeps only
+        uint32_t    m_responsesLeft;    // number of responses still expected
         int32_t     m_response[2];
         bool        m_reportResponse;
+        SettleLimits m_settle{0, 1};
+        uint32_t    m_readings = 0;     // readings taken while settling
+        BaseCurrentSearch::Target m_target; // SEEKBASE only
+        AdaptiveSweep::Limits m_adaptive;   // ADAPTIVESWEEP only
+        SweepLimits m_limits{};             // STARTSWEEP only
     };
 
-    std::queue<Command> m_commands;
-    bool m_pendingResponse;
+    /** returns the limit that the reading exceeds, if any */
+    static SweepStop checkLimits(const SweepLimits &limits, const AdcPair &reading);
+
+    /** PWM of the next response of a command */
+    static int32_t responsePwm(const Command &cmd);
+
+    /** drop the queued points of the sweep being reported after
+        a response at pwm exceeded its limits */
+    void stopSweep(SweepStop reason, int32_t pwm);
+
+    /** returns true if the reading of the command at the head of the
+        in-flight queue has settled, otherwise it is measured again. */
+    bool settle(Command &cmd, const AdcPair &reading);
+
+    /** queue the PWMs of a round of the adaptive sweep in front
+        of the other commands, m_commandMutex must be held. */
+    void queueAdaptiveRound(const std::vector<uint16_t> &pwms);
+
+    /** plan the next round of the adaptive sweep or report its points */
+    void finishAdaptiveRound();
+
+    /** initialise a single PWM command */
+    static Command pwmCommand(CommandType type, uint16_t dutyCycle, bool reportResponse);
+
+    /** queue a device-side sweep if the firmware supports it and
+        there are no limits, returns false otherwise. */
+    bool deviceSweep(CommandType type, uint16_t dutyStart, uint16_t dutyEnd, uint16_t step, const SweepLimits &limits);
+
+    void writeCommand(const Command &cmd);
+
+    /** add a command to the transmit queue, thread safe */
+    void pushCommand(const Command &cmd);
+
+    std::mutex m_commandMutex;          // guards m_commands, it is filled by the GUI thread
+    std::deque<Command> m_commands;     // commands waiting for transmission
+    std::deque<Command> m_inFlight;     // transmitted commands waiting for a response, in order
+
+    uint32_t m_outstanding;             // number of responses we're still waiting for
+    std::atomic<uint32_t> m_windowSize; // maximum number of outstanding responses
+
+    bool m_holding;                     // a command that repeats itself is in flight, hold back the others
+
+    BaseCurrentSearch m_baseSearch;     // the SEEKBASE command in flight
+    bool m_searchFinal;                 // the best PWM is being set again after the search ended
+    QElapsedTimer m_searchTimer;
+
+    AdaptiveSweep m_adaptiveSweep;      // the adaptive sweep in flight
+
+    SweepLimits m_sweepLimits;          // limits of the sweep being reported
+    SweepStop   m_sweepStop;            // limit that ended the sweep being reported
+    int32_t     m_sweepStopPwm;         // responses above this PWM are not reported
+    uint32_t    m_sweepEndsInFlight;    // ENDSWEEP markers in m_inFlight
+    bool        m_sweepOpen;            // StartSweep was reported but EndSweep wasn't
+
+    bool    m_cancelling;               // waiting for the responses to cancelled commands
+    QTimer *m_cancelTimer;
+
+    std::atomic<uint64_t> m_settleSteps;
+    std::atomic<uint64_t> m_settleMeasurements;
+    std::atomic<uint64_t> m_settleUnsettled;
+    std::atomic<uint32_t> m_settleMaxMeasurements;
 
     QTimer *m_timer;
 };
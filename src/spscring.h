@@ -0,0 +1,64 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+/** lock-free single-producer/single-consumer ring buffer.
+
+    push() may only be called from one thread and pop() from one
+    other thread. Capacity must be a power of two; the ring holds
+    at most Capacity-1 items. No memory is allocated after
+    construction.
+*/
+template<typename T, size_t Capacity>
+class SpscRing
+{
+public:
+    static_assert((Capacity & (Capacity-1)) == 0, "Capacity must be a power of two");
+
+    SpscRing() : m_head(0), m_tail(0) {}
+
+    /** producer side: returns false if the ring is full */
+    bool push(const T &item) noexcept
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        const size_t next = (head + 1) & (Capacity-1);
+        if (next == m_tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        m_items[head] = item;
+        m_head.store(next, std::memory_order_release);
+        return true;
+    }
+
+    /** consumer side: returns false if the ring is empty */
+    bool pop(T &item) noexcept
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail == m_head.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        item = m_items[tail];
+        m_tail.store((tail + 1) & (Capacity-1), std::memory_order_release);
+        return true;
+    }
+
+    /** consumer side: true if there is nothing to pop */
+    bool empty() const noexcept
+    {
+        return m_tail.load(std::memory_order_relaxed) == m_head.load(std::memory_order_acquire);
+    }
+
+protected:
+    std::array<T, Capacity> m_items;
+
+    // head and tail are written by different threads,
+    // keep them on separate cache lines.
+    alignas(64) std::atomic<size_t> m_head;
+    alignas(64) std::atomic<size_t> m_tail;
+};
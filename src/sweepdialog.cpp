@@ -25,6 +25,12 @@ SweepDialog::SweepDialog(const SweepSetup &setup, QWidget *parent) : QDialog(par
     configLayout->addWidget(new QLabel(tr("µA")), 2, 2);
     configLayout->addWidget(new QLabel(tr("Collector resistor")), 3, 0);
     configLayout->addWidget(new QLabel(tr("kOhm")), 3, 2);
+    configLayout->addWidget(new QLabel(tr("ADC 1 gain")), 4, 0);
+    configLayout->addWidget(new QLabel(tr("ADC 1 offset")), 5, 0);
+    configLayout->addWidget(new QLabel(tr("counts")), 5, 2);
+    configLayout->addWidget(new QLabel(tr("ADC 2 gain")), 6, 0);
+    configLayout->addWidget(new QLabel(tr("ADC 2 offset")), 7, 0);
+    configLayout->addWidget(new QLabel(tr("counts")), 7, 2);
 
     m_maxBaseLabel = new QLabel();
     configLayout->addWidget(m_maxBaseLabel, 2, 1);
@@ -41,9 +47,25 @@ SweepDialog::SweepDialog(const SweepSetup &setup, QWidget *parent) : QDialog(par
     sweepLayout->addWidget(new QLabel(tr("Base current stop")), 1, 0);
     sweepLayout->addWidget(new QLabel(tr("µA")), 1, 2);
     sweepLayout->addWidget(new QLabel(tr("Number of sweeps")), 2, 0);
+    sweepLayout->addWidget(new QLabel(tr("Max. collector current")), 4, 0);
+    sweepLayout->addWidget(new QLabel(tr("mA, 0 = no limit")), 4, 2);
+    sweepLayout->addWidget(new QLabel(tr("Max. device voltage")), 5, 0);
+    sweepLayout->addWidget(new QLabel(tr("V, 0 = no limit")), 5, 2);
+    sweepLayout->addWidget(new QLabel(tr("Max. device power")), 6, 0);
+    sweepLayout->addWidget(new QLabel(tr("mW, 0 = no limit")), 6, 2);
 
     sweepBox->setLayout(sweepLayout);
 
+    auto persistenceBox = new QGroupBox("Trace persistence");
+
+    auto persistenceLayout = new QGridLayout();
+    persistenceLayout->addWidget(new QLabel(tr("Max. traces in memory")), 0, 0);
+    persistenceLayout->addWidget(new QLabel(tr("0 = no limit")), 0, 2);
+    persistenceLayout->addWidget(new QLabel(tr("Max. trace memory")), 1, 0);
+    persistenceLayout->addWidget(new QLabel(tr("MB")), 1, 2);
+
+    persistenceBox->setLayout(persistenceLayout);
+
 
     m_baseResistorEdit = new QLineEdit(QString::asprintf("%.3f", m_setup.m_baseSenseResistor));
     m_baseLimitResistorEdit = new QLineEdit(QString::asprintf("%.3f", m_setup.m_baseLimitResistor));
@@ -60,6 +82,16 @@ SweepDialog::SweepDialog(const SweepSetup &setup, QWidget *parent) : QDialog(par
     configLayout->addWidget(m_baseLimitResistorEdit, 1,1);
     configLayout->addWidget(m_collectorResistorEdit, 3,1);
 
+    for(int channel=0; channel<2; channel++)
+    {
+        m_adcGainEdit[channel]   = new QLineEdit(QString::asprintf("%.5f", m_setup.m_adcGain[channel]));
+        m_adcOffsetEdit[channel] = new QLineEdit(QString::asprintf("%.1f", m_setup.m_adcOffset[channel]));
+        m_adcGainEdit[channel]->setValidator(new QDoubleValidator(0.5, 2.0, 5));
+        m_adcOffsetEdit[channel]->setValidator(new QDoubleValidator(-10000.0, 10000.0, 1));
+        configLayout->addWidget(m_adcGainEdit[channel], 4 + channel*2, 1);
+        configLayout->addWidget(m_adcOffsetEdit[channel], 5 + channel*2, 1);
+    }
+
     m_baseStartEdit = new QLineEdit(QString::asprintf("%d", m_setup.m_baseCurrentStart));
     m_baseStopEdit  = new QLineEdit(QString::asprintf("%d", m_setup.m_baseCurrentStop));
     m_numSweepsEdit = new QLineEdit(QString::asprintf("%d", m_setup.m_numberOfTraces));
@@ -72,10 +104,36 @@ SweepDialog::SweepDialog(const SweepSetup &setup, QWidget *parent) : QDialog(par
     sweepLayout->addWidget(m_baseStopEdit, 1,1);
     sweepLayout->addWidget(m_numSweepsEdit, 2,1);
 
+    m_adaptiveSweepCheck = new QCheckBox(tr("Adaptive collector sweep"));
+    m_adaptiveSweepCheck->setChecked(m_setup.m_adaptiveSweep);
+    sweepLayout->addWidget(m_adaptiveSweepCheck, 3,0,1,3);
+
+    m_maxCurrentEdit = new QLineEdit(QString::asprintf("%.3f", m_setup.m_maxCurrent));
+    m_maxVoltageEdit = new QLineEdit(QString::asprintf("%.3f", m_setup.m_maxVoltage));
+    m_maxPowerEdit   = new QLineEdit(QString::asprintf("%.3f", m_setup.m_maxPower));
+
+    m_maxCurrentEdit->setValidator(new QDoubleValidator(0.0, 1000.0, 3));
+    m_maxVoltageEdit->setValidator(new QDoubleValidator(0.0, 5.0, 3));
+    m_maxPowerEdit->setValidator(new QDoubleValidator(0.0, 10000.0, 3));
+
+    sweepLayout->addWidget(m_maxCurrentEdit, 4,1);
+    sweepLayout->addWidget(m_maxVoltageEdit, 5,1);
+    sweepLayout->addWidget(m_maxPowerEdit, 6,1);
+
+    m_maxTracesEdit = new QLineEdit(QString::asprintf("%u", m_setup.m_maxTracesInMemory));
+    m_maxMemoryEdit = new QLineEdit(QString::asprintf("%u", m_setup.m_maxTraceMemory));
+
+    m_maxTracesEdit->setValidator(new QIntValidator(0, 1000000));
+    m_maxMemoryEdit->setValidator(new QIntValidator(0, 1000000));
+
+    persistenceLayout->addWidget(m_maxTracesEdit, 0,1);
+    persistenceLayout->addWidget(m_maxMemoryEdit, 1,1);
+
     updateMaxBaseLabel();
 
     mainLayout->addWidget(deviceBox);
     mainLayout->addWidget(sweepBox);
+    mainLayout->addWidget(persistenceBox);
 
     auto buttonBox = new QDialogButtonBox(QDialogButtonBox::Ok
                                      | QDialogButtonBox::Cancel);
@@ -108,7 +166,18 @@ void SweepDialog::onOk()
     m_setup.m_baseLimitResistor  = m_baseLimitResistorEdit->text().toDouble();
     m_setup.m_baseSenseResistor  = m_baseResistorEdit->text().toDouble();
     m_setup.m_collectorResistor  = m_collectorResistorEdit->text().toDouble();
+    for(int channel=0; channel<2; channel++)
+    {
+        m_setup.m_adcGain[channel]   = m_adcGainEdit[channel]->text().toDouble();
+        m_setup.m_adcOffset[channel] = m_adcOffsetEdit[channel]->text().toDouble();
+    }
     m_setup.m_numberOfTraces  = m_numSweepsEdit->text().toInt();
+    m_setup.m_adaptiveSweep   = m_adaptiveSweepCheck->isChecked();
+    m_setup.m_maxCurrent      = m_maxCurrentEdit->text().toDouble();
+    m_setup.m_maxVoltage      = m_maxVoltageEdit->text().toDouble();
+    m_setup.m_maxPower        = m_maxPowerEdit->text().toDouble();
+    m_setup.m_maxTracesInMemory = m_maxTracesEdit->text().toUInt();
+    m_setup.m_maxTraceMemory    = m_maxMemoryEdit->text().toUInt();
 
     QDialog::accept();
 }
@@ -1,5 +1,6 @@
 #pragma once
 #include <QLineEdit>
+#include <QCheckBox>
 #include <QDialog>
 
 #include "customevent.h"
@@ -21,9 +22,17 @@ protected:
     QLineEdit  *m_baseResistorEdit;
     QLineEdit  *m_baseLimitResistorEdit;
     QLineEdit  *m_collectorResistorEdit;
+    QLineEdit  *m_adcGainEdit[2];
+    QLineEdit  *m_adcOffsetEdit[2];
     QLineEdit  *m_baseStartEdit;
     QLineEdit  *m_baseStopEdit;
     QLineEdit  *m_numSweepsEdit;
+    QCheckBox  *m_adaptiveSweepCheck;
+    QLineEdit  *m_maxCurrentEdit;
+    QLineEdit  *m_maxVoltageEdit;
+    QLineEdit  *m_maxPowerEdit;
+    QLineEdit  *m_maxTracesEdit;
+    QLineEdit  *m_maxMemoryEdit;
     QLabel     *m_maxBaseLabel;
 
     SweepSetup m_setup;
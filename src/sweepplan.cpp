@@ -0,0 +1,155 @@
+#include <algorithm>
+#include "conversion.h"
+#include "sweepplan.h"
+
+SweepSetup SweepPlan::defaultSetup()
+{
+    SweepSetup setup;
+    setup.m_baseLimitResistor = 100.0;   // 100k
+    setup.m_baseSenseResistor = 3.3;     // 3k3
+    setup.m_collectorResistor = 1.0;     // 1k
+    setup.m_adcGain[0]        = 1.0f;    // uncalibrated
+    setup.m_adcGain[1]        = 1.0f;
+    setup.m_adcOffset[0]      = 0.0f;
+    setup.m_adcOffset[1]      = 0.0f;
+    setup.m_baseCurrentStart  = 10;       // 10 uA
+    setup.m_baseCurrentStop   = 20;       // 20 uA
+    setup.m_numberOfTraces    = 4;
+    setup.m_adaptiveSweep     = false;
+    setup.m_maxCurrent        = 0.0f;   // no limits
+    setup.m_maxVoltage        = 0.0f;
+    setup.m_maxPower          = 0.0f;
+    setup.m_maxTracesInMemory = 1000;
+    setup.m_maxTraceMemory    = 256;    // 256 MB
+    return setup;
+}
+
+uint16_t SweepPlan::basePWM(const SweepSetup &setup, float baseCurrent)
+{
+    // calculate the required PWM / voltage to achieve the
+    // desired base current (in uA)
+    const float totalBaseResistance = setup.m_baseLimitResistor + setup.m_baseSenseResistor;
+
+    float baseVoltage = (baseCurrent*1e-6f) * (totalBaseResistance*1e3f);
+    baseVoltage += 0.65f;
+
+    int32_t pwm = static_cast<int32_t>((baseVoltage / 5.0f) * 1023);
+    pwm = std::max(pwm, 0);
+    pwm = std::min(pwm, 1023);
+
+    return static_cast<uint16_t>(pwm);
+}
+
+BaseCurrentSearch::Target SweepPlan::baseTarget(const SweepSetup &setup, float baseCurrent)
+{
+    // the resistors are in kilo ohms
+    const float senseResistance = setup.m_baseSenseResistor * 1e3f;
+    const float totalBaseResistance = (setup.m_baseLimitResistor + setup.m_baseSenseResistor) * 1e3f;
+    const float countsPerAmp = senseResistance / AdcConversion::c_adcVoltsPerCount;
+
+    BaseCurrentSearch::Target target;
+    target.m_counts       = baseCurrent * 1e-6f * countsPerAmp;
+    target.m_countsPerPwm = (5.0f / 1023.0f) / totalBaseResistance * countsPerAmp;
+
+    // 1% is well within the spread of a transistor, but it
+    // must not be finer than a single PWM step.
+    target.m_tolerance    = std::max(0.01f * target.m_counts, target.m_countsPerPwm);
+    target.m_gain[0]      = setup.m_adcGain[0];
+    target.m_gain[1]      = setup.m_adcGain[1];
+    target.m_offset[0]    = setup.m_adcOffset[0];
+    target.m_offset[1]    = setup.m_adcOffset[1];
+    target.m_pwm          = basePWM(setup, baseCurrent);
+    target.m_maxIterations = 8;
+    return target;
+}
+
+float SweepPlan::baseCurrent(const SweepSetup &setup, uint32_t trace)
+{
+    float baseCurrentStep = 0.0f;
+    if (setup.m_numberOfTraces > 1)
+    {
+        baseCurrentStep = static_cast<float>(setup.m_baseCurrentStop - setup.m_baseCurrentStart) / (setup.m_numberOfTraces-1);
+    }
+
+    return static_cast<float>(setup.m_baseCurrentStart) + static_cast<float>(trace)*baseCurrentStep;
+}
+
+AdaptiveSweep::Limits SweepPlan::adaptiveLimits()
+{
+    AdaptiveSweep::Limits limits;
+    limits.m_start      = 0;
+    limits.m_end        = 1023;
+    limits.m_coarseStep = 32;
+    limits.m_minStep    = 1;
+    limits.m_tolerance  = 0.003f;   // 0.3% of the curve span
+    limits.m_maxPoints  = 128;
+    return limits;
+}
+
+SerialCtrl::SweepLimits SweepPlan::sweepLimits(const SweepSetup &setup)
+{
+    // the collector resistor is in kilo ohms, the limits in mA, V and mW
+    const float volts = AdcConversion::c_adcVoltsPerCount;
+    const float collectorResistance = setup.m_collectorResistor * 1e3f;
+
+    SerialCtrl::SweepLimits limits;
+    limits.m_gain[0]    = setup.m_adcGain[0];
+    limits.m_gain[1]    = setup.m_adcGain[1];
+    limits.m_offset[0]  = setup.m_adcOffset[0];
+    limits.m_offset[1]  = setup.m_adcOffset[1];
+    limits.m_maxCurrent = setup.m_maxCurrent * 1e-3f * collectorResistance / volts;
+    limits.m_maxVoltage = setup.m_maxVoltage / volts;
+    limits.m_maxPower   = setup.m_maxPower * 1e-3f * collectorResistance / (volts * volts);
+    return limits;
+}
+
+const char* SweepPlan::sweepStopName(SerialCtrl::SweepStop stop)
+{
+    switch(stop)
+    {
+    case SerialCtrl::SweepStop::Current:
+        return "current";
+    case SerialCtrl::SweepStop::Voltage:
+        return "voltage";
+    case SerialCtrl::SweepStop::Power:
+        return "power";
+    case SerialCtrl::SweepStop::Cancelled:
+        return "cancelled";
+    default:
+        return "none";
+    }
+}
+
+void SweepPlan::queueDiodeSweep(SerialCtrl &serial, const SweepSetup &setup)
+{
+    serial.settleBasePWM(0, SerialCtrl::SettleLimits{c_settleTolerance, c_settleMeasurements});
+    serial.sweepDiode(0,1023, 10, sweepLimits(setup));
+}
+
+uint32_t SweepPlan::queueTransistorSweep(SerialCtrl &serial, const SweepSetup &setup)
+{
+    const uint32_t numberOfTraces = std::max(1U, setup.m_numberOfTraces);
+    const auto limits = sweepLimits(setup);
+
+    for(uint32_t sweep = 0; sweep < numberOfTraces; sweep++)
+    {
+        const float desiredBaseCurrent = baseCurrent(setup, sweep);
+
+        // readings of the search only have to agree as
+        // well as the search has to reach the target.
+        const auto target = baseTarget(setup, desiredBaseCurrent);
+        const auto tolerance = std::min(c_settleTolerance, std::max(1, static_cast<int32_t>(target.m_tolerance)));
+        serial.seekBaseCurrent(target, SerialCtrl::SettleLimits{tolerance, c_settleMeasurements});
+
+        if (setup.m_adaptiveSweep)
+        {
+            serial.sweepCollectorAdaptive(adaptiveLimits(), limits);
+        }
+        else
+        {
+            serial.sweepCollector(0,1023, 10, limits);
+        }
+    }
+
+    return numberOfTraces;
+}
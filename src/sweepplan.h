@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include "customevent.h"
+#include "serialctrl.h"
+
+/** the command sequences of the sweeps, shared by the
+    GUI and the headless mode. The commands are only queued,
+    SerialCtrl::run() starts transmitting them. */
+struct SweepPlan
+{
+    /** base measurements are repeated until they agree within
+        c_settleTolerance counts (about 1.2mV), at most
+        c_settleMeasurements times */
+    static constexpr int32_t  c_settleTolerance    = 64;
+    static constexpr uint16_t c_settleMeasurements = 5;
+
+    /** setup used until the user changes it */
+    static SweepSetup defaultSetup();
+
+    /** base PWM that is expected to result in baseCurrent (uA).
+        assumes a 0.65V base-emitter voltage. */
+    static uint16_t basePWM(const SweepSetup &setup, float baseCurrent);
+
+    /** closed-loop search for baseCurrent (uA), starts at basePWM() */
+    static BaseCurrentSearch::Target baseTarget(const SweepSetup &setup, float baseCurrent);
+
+    /** base current (uA) of a trace of a transistor sweep */
+    static float baseCurrent(const SweepSetup &setup, uint32_t trace);
+
+    /** limits of the adaptive collector sweep, about 40 instead of 103 points */
+    static AdaptiveSweep::Limits adaptiveLimits();
+
+    /** stop conditions of the setup in ADC counts */
+    static SerialCtrl::SweepLimits sweepLimits(const SweepSetup &setup);
+
+    /** name of the limit that ended a sweep */
+    static const char* sweepStopName(SerialCtrl::SweepStop stop);
+
+    /** queue a single diode sweep */
+    static void queueDiodeSweep(SerialCtrl &serial, const SweepSetup &setup);
+
+    /** queue a collector sweep for each of the base currents in
+        setup, returns the number of traces that will be produced.
+        The base current of each trace is set in a closed loop. The
+        collector sweep is uniform or adaptive, see SweepSetup. */
+    static uint32_t queueTransistorSweep(SerialCtrl &serial, const SweepSetup &setup);
+};
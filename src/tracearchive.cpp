@@ -0,0 +1,225 @@
+#include <cstring>
+#include <algorithm>
+#include "tracearchive.h"
+
+using Format = TraceArchiveFormat;
+
+bool TraceArchiveWriter::open(const std::string &filename)
+{
+    close();
+
+    m_file.open(filename, std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!m_file.is_open())
+    {
+        return false;
+    }
+
+    Format::FileHeader header{};
+    header.m_magic      = Format::c_fileMagic;
+    header.m_version    = Format::c_version;
+    header.m_headerSize = sizeof(Format::FileHeader);
+    header.m_byteOrder  = Format::c_byteOrder;
+    m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    m_file.flush();
+
+    return static_cast<bool>(m_file);
+}
+
+void TraceArchiveWriter::close()
+{
+    if (m_file.is_open())
+    {
+        m_file.close();
+    }
+}
+
+bool TraceArchiveWriter::append(const SweepSetup &setup, const AdcPair *base,
+    const AdcPair *pairs, const float *x, const float *y, size_t count)
+{
+    if (!m_file.is_open())
+    {
+        return false;
+    }
+
+    Format::TraceHeader header{};
+    header.m_magic      = Format::c_traceMagic;
+    header.m_headerSize = sizeof(Format::TraceHeader);
+    header.m_count      = count;
+    header.m_baseSenseResistor = setup.m_baseSenseResistor;
+    header.m_baseLimitResistor = setup.m_baseLimitResistor;
+    header.m_collectorResistor = setup.m_collectorResistor;
+    std::copy(setup.m_adcGain, setup.m_adcGain + 2, header.m_adcGain);
+    std::copy(setup.m_adcOffset, setup.m_adcOffset + 2, header.m_adcOffset);
+
+    if (base != nullptr)
+    {
+        header.m_base[0] = base->m_v1;
+        header.m_base[1] = base->m_v2;
+        header.m_flags  |= Format::c_hasBase;
+    }
+
+    if (count > 0)
+    {
+        header.m_minx = *std::min_element(x, x + count);
+        header.m_maxx = *std::max_element(x, x + count);
+        header.m_miny = *std::min_element(y, y + count);
+        header.m_maxy = *std::max_element(y, y + count);
+    }
+
+    m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    const auto bytes = static_cast<std::streamsize>(count * sizeof(int32_t));
+    m_column.resize(count);
+    for(size_t i=0; i<count; i++)
+    {
+        m_column[i] = pairs[i].m_v1;
+    }
+    m_file.write(reinterpret_cast<const char*>(m_column.data()), bytes);
+
+    for(size_t i=0; i<count; i++)
+    {
+        m_column[i] = pairs[i].m_v2;
+    }
+    m_file.write(reinterpret_cast<const char*>(m_column.data()), bytes);
+
+    m_file.write(reinterpret_cast<const char*>(x), bytes);
+    m_file.write(reinterpret_cast<const char*>(y), bytes);
+    m_file.flush();
+
+    return static_cast<bool>(m_file);
+}
+
+TraceArchive::~TraceArchive()
+{
+    if (m_map != nullptr)
+    {
+        m_file.unmap(m_map);
+    }
+}
+
+bool TraceArchive::open(const QString &filename)
+{
+    m_file.setFileName(filename);
+    if (!m_file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+
+    const auto fileSize = static_cast<size_t>(m_file.size());
+    if (fileSize < sizeof(Format::FileHeader))
+    {
+        return false;
+    }
+
+    m_map = m_file.map(0, m_file.size());
+    if (m_map == nullptr)
+    {
+        return false;
+    }
+
+    Format::FileHeader fileHeader;
+    std::memcpy(&fileHeader, m_map, sizeof(fileHeader));
+    if ((fileHeader.m_magic != Format::c_fileMagic) || (fileHeader.m_version > Format::c_version))
+    {
+        return false;
+    }
+
+    // the columns are used in place, they must be in the byte order
+    // of this machine. version 1 archives are little endian.
+    const uint32_t one = 1;
+    const bool littleEndian = (*reinterpret_cast<const uint8_t*>(&one) == 1);
+    const bool sameByteOrder = (fileHeader.m_version < 2) ? littleEndian :
+        (fileHeader.m_byteOrder == Format::c_byteOrder);
+    if (!sameByteOrder || (fileHeader.m_headerSize < sizeof(Format::FileHeader)))
+    {
+        return false;
+    }
+
+    // only the record headers are read, they
+    // give the position of the next record.
+    size_t offset = fileHeader.m_headerSize;
+    while(offset + sizeof(Format::TraceHeader) <= fileSize)
+    {
+        Entry entry;
+        std::memcpy(&entry.m_header, m_map + offset, sizeof(entry.m_header));
+
+        const auto &header = entry.m_header;
+        if ((header.m_magic != Format::c_traceMagic) || (header.m_headerSize < sizeof(Format::TraceHeader)))
+        {
+            break;
+        }
+
+        // four columns of 4 byte values
+        const size_t available = fileSize - offset;
+        if ((header.m_headerSize > available) || (header.m_count > (available - header.m_headerSize) / 16))
+        {
+            // truncated record
+            break;
+        }
+        const size_t recordSize = header.m_headerSize + 16*header.m_count;
+
+        // the columns are accessed as int32 and float arrays
+        entry.m_columns = m_map + offset + header.m_headerSize;
+        if ((reinterpret_cast<uintptr_t>(entry.m_columns) % alignof(float)) != 0)
+        {
+            break;
+        }
+
+        entry.m_count   = header.m_count;
+        m_traces.push_back(entry);
+
+        offset += recordSize;
+    }
+
+    return true;
+}
+
+SweepSetup TraceArchive::setup(size_t trace) const
+{
+    const auto &header = m_traces.at(trace).m_header;
+
+    SweepSetup setup{};
+    setup.m_baseSenseResistor = header.m_baseSenseResistor;
+    setup.m_baseLimitResistor = header.m_baseLimitResistor;
+    setup.m_collectorResistor = header.m_collectorResistor;
+    std::copy(header.m_adcGain, header.m_adcGain + 2, setup.m_adcGain);
+    std::copy(header.m_adcOffset, header.m_adcOffset + 2, setup.m_adcOffset);
+    return setup;
+}
+
+bool TraceArchive::base(size_t trace, AdcPair &base) const
+{
+    const auto &header = m_traces.at(trace).m_header;
+    base = AdcPair{header.m_base[0], header.m_base[1]};
+    return (header.m_flags & Format::c_hasBase) != 0;
+}
+
+QRectF TraceArchive::bounds(size_t trace) const
+{
+    const auto &header = m_traces.at(trace).m_header;
+    return QRectF{QPointF{header.m_minx, header.m_miny}, QPointF{header.m_maxx, header.m_maxy}};
+}
+
+const int32_t* TraceArchive::v1(size_t trace) const
+{
+    const auto &entry = m_traces.at(trace);
+    return reinterpret_cast<const int32_t*>(entry.m_columns);
+}
+
+const int32_t* TraceArchive::v2(size_t trace) const
+{
+    const auto &entry = m_traces.at(trace);
+    return reinterpret_cast<const int32_t*>(entry.m_columns) + entry.m_count;
+}
+
+const float* TraceArchive::x(size_t trace) const
+{
+    const auto &entry = m_traces.at(trace);
+    return reinterpret_cast<const float*>(entry.m_columns) + 2*entry.m_count;
+}
+
+const float* TraceArchive::y(size_t trace) const
+{
+    const auto &entry = m_traces.at(trace);
+    return reinterpret_cast<const float*>(entry.m_columns) + 3*entry.m_count;
+}
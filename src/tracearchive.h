@@ -0,0 +1,143 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <cstddef>
+#include <QFile>
+#include <QRectF>
+#include "customevent.h"
+
+/** binary trace archive.
+
+    The archive starts with a file header followed by one record per
+    trace, so it can be written while measuring: a record is appended
+    when a sweep ends. A record holds a fixed header with the setup,
+    base measurement and bounding box of the trace, followed by four
+    columns of its samples: raw v1 and v2 as int32 and the derived
+    voltage and current as float.
+
+    The values are stored in the byte order of the machine that wrote
+    the archive so the columns can be used directly from the mapping.
+    The file header records the byte order, an archive written with
+    the other byte order is rejected. Version 1 archives don't record
+    it, they were written on little endian machines.
+
+    A truncated last record, e.g. after a crash, is ignored on load.
+*/
+struct TraceArchiveFormat
+{
+    static constexpr uint32_t c_fileMagic   = 0x41525450;  // "PTRA"
+    static constexpr uint32_t c_traceMagic  = 0x45435254;  // "TRCE"
+    static constexpr uint32_t c_byteOrder   = 0x01020304;  // reads back as 0x04030201 with the other byte order
+    static constexpr uint32_t c_version     = 2;
+
+    struct FileHeader
+    {
+        uint32_t m_magic;
+        uint32_t m_version;
+        uint32_t m_headerSize;  // offset of the first record
+        uint32_t m_byteOrder;   // c_byteOrder, 0 in version 1
+    };
+
+    struct TraceHeader
+    {
+        uint32_t m_magic;
+        uint32_t m_headerSize;  // offset of the columns from the start of the record
+        uint64_t m_count;       // number of samples
+        float    m_baseSenseResistor;
+        float    m_baseLimitResistor;
+        float    m_collectorResistor;
+        float    m_adcGain[2];
+        float    m_adcOffset[2];
+        int32_t  m_base[2];     // base measurement, if m_flags has c_hasBase
+        uint32_t m_flags;
+        float    m_minx;        // bounding box of the derived values
+        float    m_maxx;
+        float    m_miny;
+        float    m_maxy;
+    };
+
+    static constexpr uint32_t c_hasBase = 1;
+
+    static_assert(sizeof(FileHeader) == 16, "unexpected archive file header size");
+    static_assert(sizeof(TraceHeader) == 72, "unexpected archive trace header size");
+    static_assert((alignof(int32_t) == 4) && (alignof(float) == 4), "the columns are 4 byte aligned");
+};
+
+/** appends traces to an archive while measuring */
+class TraceArchiveWriter
+{
+public:
+    /** create an archive, an existing file is overwritten */
+    bool open(const std::string &filename);
+    void close();
+
+    bool isOpen() const
+    {
+        return m_file.is_open();
+    }
+
+    /** append a trace, base may be null. the record is
+        flushed so the archive is usable while measuring. */
+    bool append(const SweepSetup &setup, const AdcPair *base,
+        const AdcPair *pairs, const float *x, const float *y, size_t count);
+
+protected:
+    std::ofstream m_file;
+    std::vector<int32_t> m_column;  // re-used to split the raw pairs
+};
+
+/** read-only access to an archive through a memory mapping.
+
+    Opening only walks the record headers, the samples are read
+    through the mapping when a trace is used so large archives
+    open quickly.
+*/
+class TraceArchive
+{
+public:
+    ~TraceArchive();
+
+    bool open(const QString &filename);
+
+    size_t numberOfTraces() const noexcept
+    {
+        return m_traces.size();
+    }
+
+    size_t size(size_t trace) const
+    {
+        return m_traces.at(trace).m_count;
+    }
+
+    /** the setup the trace was measured with, only the
+        resistors and the calibration are stored */
+    SweepSetup setup(size_t trace) const;
+
+    /** base measurement of a trace, returns false if there is none */
+    bool base(size_t trace, AdcPair &base) const;
+
+    /** bounding box of the derived values of a trace */
+    QRectF bounds(size_t trace) const;
+
+    /** columns of a trace, they point into the mapping.
+        open() only accepts records whose columns are aligned. */
+    const int32_t* v1(size_t trace) const;
+    const int32_t* v2(size_t trace) const;
+    const float* x(size_t trace) const;
+    const float* y(size_t trace) const;
+
+protected:
+    struct Entry
+    {
+        TraceArchiveFormat::TraceHeader m_header;
+        const uchar *m_columns;
+        size_t       m_count;
+    };
+
+    QFile   m_file;
+    uchar  *m_map = nullptr;
+    std::vector<Entry> m_traces;
+};
@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <cctype>
+#include "tracearchive.h"
+#include "traceexport.h"
+
+TraceExporter::~TraceExporter()
+{
+    cancel();
+    finish();
+}
+
+TraceExporter::Format TraceExporter::formatFromFilename(const std::string &filename)
+{
+    const auto dot = filename.rfind('.');
+    if (dot == std::string::npos)
+    {
+        return Format::Json;
+    }
+
+    auto extension = filename.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+        [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    if (extension == "csv")
+    {
+        return Format::Csv;
+    }
+    else if (extension == "ptra")
+    {
+        return Format::Archive;
+    }
+    return Format::Json;
+}
+
+bool TraceExporter::start(std::vector<TraceSnapshotPtr> traces, const std::string &filename, Format format)
+{
+    if (isBusy())
+    {
+        return false;
+    }
+
+    m_traces   = std::move(traces);
+    m_filename = filename;
+    m_format   = format;
+    m_ok       = false;
+    m_written  = 0;
+    m_done     = false;
+    m_cancel   = false;
+
+    m_thread = std::thread(&TraceExporter::run, this);
+    return true;
+}
+
+void TraceExporter::cancel()
+{
+    m_cancel = true;
+}
+
+bool TraceExporter::finish()
+{
+    if (!m_thread.joinable())
+    {
+        return false;
+    }
+
+    m_thread.join();
+
+    // release the snapshots, and with them the spill files of cleared sessions
+    m_traces.clear();
+    return m_ok;
+}
+
+void TraceExporter::run()
+{
+    if (m_format == Format::Archive)
+    {
+        m_ok = writeArchive();
+    }
+    else
+    {
+        std::ofstream file(m_filename);
+        if (file.is_open())
+        {
+            m_ok = (m_format == Format::Csv) ? writeCsv(file) : writeJson(file);
+            m_ok = m_ok && file.good();
+        }
+    }
+
+    m_done = true;
+}
+
+bool TraceExporter::writeJson(std::ofstream &file)
+{
+    std::vector<float> x;
+    std::vector<float> y;
+
+    file << "{\n";
+    for(size_t trace=0; trace < m_traces.size(); trace++)
+    {
+        if (m_cancel || !m_traces[trace]->read(x, y))
+        {
+            return false;
+        }
+
+        file << "    \"trace" << trace+1 << "\": [";
+        for(size_t i=0; i<x.size(); i++)
+        {
+            if (i != 0)
+            {
+                file << ",";
+            }
+
+            file << "[" << x[i] << " ," << y[i] << "]";
+        }
+
+        if (trace+1 != m_traces.size())
+        {
+            file << "],\n";
+        }
+        else
+        {
+            file << "]\n";
+        }
+
+        m_written++;
+    }
+    file << "}\n";
+    return true;
+}
+
+bool TraceExporter::writeCsv(std::ofstream &file)
+{
+    std::vector<float> x;
+    std::vector<float> y;
+
+    file << "trace,voltage,current\n";
+    for(size_t trace=0; trace < m_traces.size(); trace++)
+    {
+        if (m_cancel || !m_traces[trace]->read(x, y))
+        {
+            return false;
+        }
+
+        for(size_t i=0; i<x.size(); i++)
+        {
+            file << trace+1 << "," << x[i] << "," << y[i] << "\n";
+        }
+
+        m_written++;
+    }
+    return true;
+}
+
+bool TraceExporter::writeArchive()
+{
+    TraceArchiveWriter writer;
+    if (!writer.open(m_filename))
+    {
+        return false;
+    }
+
+    std::vector<AdcPair> pairs;
+    std::vector<float> x;
+    std::vector<float> y;
+    for(const auto &trace : m_traces)
+    {
+        if (m_cancel || !trace->readRaw(pairs) || !trace->read(x, y))
+        {
+            return false;
+        }
+
+        const AdcPair *base = trace->m_hasBase ? &trace->m_base : nullptr;
+        if (!writer.append(trace->m_setup, base, pairs.data(), x.data(), y.data(), pairs.size()))
+        {
+            return false;
+        }
+
+        m_written++;
+    }
+
+    writer.close();
+    return true;
+}
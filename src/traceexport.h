@@ -0,0 +1,81 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <cstddef>
+#include "tracesnapshot.h"
+
+/** writes traces to a file on a worker thread.
+
+    The exporter works on snapshots of the traces, so measuring and
+    drawing continue while a large session is written. The GUI polls
+    progress() and calls finish() when isDone() becomes true.
+*/
+class TraceExporter
+{
+public:
+    enum class Format
+    {
+        Json,       // {"trace1": [[x ,y], ...], ...}
+        Csv,        // trace,voltage,current per line
+        Archive     // see TraceArchiveFormat
+    };
+
+    ~TraceExporter();
+
+    /** format that belongs to the extension of filename, JSON if unknown */
+    static Format formatFromFilename(const std::string &filename);
+
+    /** start writing traces to filename. returns false
+        if the previous export has not been finished. */
+    bool start(std::vector<TraceSnapshotPtr> traces, const std::string &filename, Format format);
+
+    /** stop the export at the next trace, the file is incomplete */
+    void cancel();
+
+    /** true if an export was started and not finished */
+    bool isBusy() const noexcept
+    {
+        return m_thread.joinable();
+    }
+
+    /** true if the worker has stopped and finish() won't block */
+    bool isDone() const noexcept
+    {
+        return m_done;
+    }
+
+    /** wait for the worker, returns true if all traces were written */
+    bool finish();
+
+    /** number of traces written so far */
+    size_t progress() const noexcept
+    {
+        return m_written;
+    }
+
+    size_t numberOfTraces() const noexcept
+    {
+        return m_traces.size();
+    }
+
+protected:
+    void run();
+
+    bool writeJson(std::ofstream &file);
+    bool writeCsv(std::ofstream &file);
+    bool writeArchive();
+
+    std::vector<TraceSnapshotPtr> m_traces;
+    std::string m_filename;
+    Format      m_format = Format::Json;
+    bool        m_ok = false;       // set by the worker, read after joining
+
+    std::thread         m_thread;
+    std::atomic<size_t> m_written{0};
+    std::atomic<bool>   m_done{false};
+    std::atomic<bool>   m_cancel{false};
+};
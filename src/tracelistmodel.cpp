@@ -0,0 +1,103 @@
+#include <QImage>
+#include <QPixmap>
+#include <QPainter>
+#include <QIcon>
+
+#include "tracelistmodel.h"
+
+TraceListModel::TraceListModel(const Graph *graph, QObject *parent)
+    : QAbstractListModel(parent), m_graph(graph)
+{
+}
+
+void TraceListModel::setNumberOfTraces(size_t traces)
+{
+    if (traces < m_numberOfTraces)
+    {
+        beginResetModel();
+        m_numberOfTraces = traces;
+        m_names.erase(m_names.lower_bound(traces), m_names.end());
+        endResetModel();
+    }
+    else if (traces > m_numberOfTraces)
+    {
+        beginInsertRows(QModelIndex(), static_cast<int>(m_numberOfTraces), static_cast<int>(traces - 1));
+        m_numberOfTraces = traces;
+        endInsertRows();
+    }
+}
+
+void TraceListModel::clear()
+{
+    setNumberOfTraces(0);
+}
+
+int TraceListModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+    {
+        return 0;
+    }
+    return static_cast<int>(m_numberOfTraces);
+}
+
+QVariant TraceListModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || (static_cast<size_t>(index.row()) >= m_numberOfTraces))
+    {
+        return QVariant();
+    }
+
+    const size_t trace = index.row();
+    switch(role)
+    {
+    case Qt::DisplayRole:
+    case Qt::EditRole:
+        {
+            auto name = m_names.find(trace);
+            if (name != m_names.end())
+            {
+                return name->second;
+            }
+            return QString::asprintf("Trace %ld", trace+1);
+        }
+    case Qt::DecorationRole:
+        {
+            // only the visible rows are drawn
+            QImage image(12,12, QImage::Format::Format_RGB888);
+            QPainter painter(&image);
+            painter.setPen(Qt::black);
+            painter.setBrush(m_graph->traceColor(trace));
+            auto r = image.rect();
+            r.adjust(0,0,-1,-1);
+            painter.drawRect(r);
+            painter.end();
+            return QIcon(QPixmap::fromImage(image));
+        }
+    case Qt::UserRole:
+        return static_cast<int>(trace+1);
+    default:
+        return QVariant();
+    }
+}
+
+bool TraceListModel::setData(const QModelIndex &index, const QVariant &value, int role)
+{
+    if (!index.isValid() || (role != Qt::EditRole) || (static_cast<size_t>(index.row()) >= m_numberOfTraces))
+    {
+        return false;
+    }
+
+    m_names[index.row()] = value.toString();
+    emit dataChanged(index, index, {Qt::DisplayRole, Qt::EditRole});
+    return true;
+}
+
+Qt::ItemFlags TraceListModel::flags(const QModelIndex &index) const
+{
+    if (!index.isValid())
+    {
+        return Qt::NoItemFlags;
+    }
+    return Qt::ItemIsEditable | Qt::ItemIsEnabled | Qt::ItemIsSelectable;
+}
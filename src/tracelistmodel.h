@@ -0,0 +1,37 @@
+#pragma once
+
+#include <map>
+#include <QAbstractListModel>
+#include <QString>
+
+#include "graph.h"
+
+/** the traces of a graph, for the trace list.
+
+    The rows are made when they are shown, so a long persistence run
+    or a large archive doesn't create a list item and an icon per
+    trace. Row n is trace n of the graph, its Qt::UserRole data is
+    the trace number, which starts at 1. Only the names of renamed
+    traces are kept.
+*/
+class TraceListModel : public QAbstractListModel
+{
+public:
+    TraceListModel(const Graph *graph, QObject *parent = nullptr);
+
+    /** show the first traces of the graph, the new rows are appended */
+    void setNumberOfTraces(size_t traces);
+
+    /** remove all rows */
+    void clear();
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole) override;
+    Qt::ItemFlags flags(const QModelIndex &index) const override;
+
+protected:
+    const Graph *m_graph;
+    size_t m_numberOfTraces = 0;
+    std::map<size_t, QString> m_names;  // traces renamed in the list
+};
@@ -0,0 +1,98 @@
+#include <algorithm>
+#include "tracelod.h"
+
+void TraceLod::clear()
+{
+    m_levels.clear();
+    m_numberOfPoints = 0;
+}
+
+void TraceLod::extend(Bucket &bucket, float x, float y, uint32_t index)
+{
+    bucket.m_minx = std::min(bucket.m_minx, x);
+    bucket.m_maxx = std::max(bucket.m_maxx, x);
+    bucket.m_last = index;
+
+    if (y < bucket.m_miny)
+    {
+        bucket.m_miny = y;
+        bucket.m_min  = index;
+    }
+
+    if (y > bucket.m_maxy)
+    {
+        bucket.m_maxy = y;
+        bucket.m_max  = index;
+    }
+}
+
+TraceLod::Bucket TraceLod::merge(const Bucket &lhs, const Bucket &rhs)
+{
+    Bucket bucket;
+    bucket.m_minx  = std::min(lhs.m_minx, rhs.m_minx);
+    bucket.m_maxx  = std::max(lhs.m_maxx, rhs.m_maxx);
+    bucket.m_first = lhs.m_first;
+    bucket.m_last  = rhs.m_last;
+
+    if (rhs.m_miny < lhs.m_miny)
+    {
+        bucket.m_miny = rhs.m_miny;
+        bucket.m_min  = rhs.m_min;
+    }
+    else
+    {
+        bucket.m_miny = lhs.m_miny;
+        bucket.m_min  = lhs.m_min;
+    }
+
+    if (rhs.m_maxy > lhs.m_maxy)
+    {
+        bucket.m_maxy = rhs.m_maxy;
+        bucket.m_max  = rhs.m_max;
+    }
+    else
+    {
+        bucket.m_maxy = lhs.m_maxy;
+        bucket.m_max  = lhs.m_max;
+    }
+
+    return bucket;
+}
+
+void TraceLod::update(const float *x, const float *y, size_t count)
+{
+    for(size_t i = m_numberOfPoints; i < count; i++)
+    {
+        const auto index = static_cast<uint32_t>(i);
+
+        if (m_levels.empty())
+        {
+            m_levels.emplace_back();
+        }
+
+        for(size_t level = 0; level < m_levels.size(); level++)
+        {
+            auto &buckets = m_levels[level];
+            const size_t bucketIndex = i >> (level + c_lowestLevel);
+
+            if (bucketIndex == buckets.size())
+            {
+                buckets.push_back(Bucket{x[i], x[i], y[i], y[i], index, index, index, index});
+            }
+            else
+            {
+                extend(buckets[bucketIndex], x[i], y[i], index);
+            }
+        }
+
+        // keep a single bucket at the top so the
+        // whole trace can be traversed from one root.
+        if (m_levels.back().size() > 1)
+        {
+            const auto &top = m_levels.back();
+            m_levels.emplace_back(1, merge(top[0], top[1]));
+        }
+    }
+
+    m_numberOfPoints = count;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/** multi-resolution level-of-detail pyramid for a single trace.
+
+    Level k holds a bucket for every 2^k consecutive points of the
+    trace. A bucket stores the bounding box of its points and the
+    indices of the first, last, minimum-y and maximum-y point so it
+    can be drawn as (at most) four vertices. The pyramid is extended
+    incrementally as points are appended, at O(log n) per point.
+*/
+class TraceLod
+{
+public:
+    struct Bucket
+    {
+        float    m_minx;
+        float    m_maxx;
+        float    m_miny;
+        float    m_maxy;
+        uint32_t m_first;   // index of the first point
+        uint32_t m_last;    // index of the last point
+        uint32_t m_min;     // index of the point with the minimum y
+        uint32_t m_max;     // index of the point with the maximum y
+    };
+
+    static constexpr uint32_t c_lowestLevel = 2;   // 4 points per bucket
+
+    void clear();
+
+    /** extend the pyramid with the points from
+        index numberOfPoints() up to count */
+    void update(const float *x, const float *y, size_t count);
+
+    size_t numberOfPoints() const noexcept
+    {
+        return m_numberOfPoints;
+    }
+
+    /** number of levels, level 0 of the pyramid is c_lowestLevel */
+    size_t numberOfLevels() const noexcept
+    {
+        return m_levels.size();
+    }
+
+    const std::vector<Bucket>& level(size_t index) const
+    {
+        return m_levels.at(index);
+    }
+
+protected:
+    void extend(Bucket &bucket, float x, float y, uint32_t index);
+    static Bucket merge(const Bucket &lhs, const Bucket &rhs);
+
+    std::vector<std::vector<Bucket> > m_levels;
+    size_t m_numberOfPoints = 0;
+};
@@ -0,0 +1,106 @@
+#include <cstdio>
+#include "conversion.h"
+#include "tracesnapshot.h"
+
+SpillFile::SpillFile(const std::string &filename) : m_filename(filename)
+{
+    m_file.open(m_filename, std::ios::out | std::ios::trunc | std::ios::binary);
+}
+
+SpillFile::~SpillFile()
+{
+    if (m_file.is_open())
+    {
+        m_file.close();
+        std::remove(m_filename.c_str());
+    }
+}
+
+bool SpillFile::append(const AdcPair *pairs, size_t count, std::streamoff &offset)
+{
+    offset = m_file.tellp();
+    m_file.write(reinterpret_cast<const char*>(pairs),
+        static_cast<std::streamsize>(count * sizeof(AdcPair)));
+
+    // readers use their own stream
+    m_file.flush();
+
+    if (!m_file)
+    {
+        // drop the partial write, the trace stays in memory
+        m_file.clear();
+        m_file.seekp(offset);
+        return false;
+    }
+    return true;
+}
+
+bool SpillFile::read(std::streamoff offset, size_t count, std::vector<AdcPair> &pairs) const
+{
+    std::ifstream file(m_filename, std::ios::in | std::ios::binary);
+
+    pairs.resize(count);
+    file.seekg(offset);
+    file.read(reinterpret_cast<char*>(pairs.data()),
+        static_cast<std::streamsize>(count * sizeof(AdcPair)));
+
+    if (!file)
+    {
+        pairs.clear();
+        return false;
+    }
+    return true;
+}
+
+bool TraceSnapshot::readRaw(std::vector<AdcPair> &pairs) const
+{
+    if (m_archive)
+    {
+        // the archive stores v1 and v2 as separate columns
+        const auto v1 = m_archive->v1(m_archiveTrace);
+        const auto v2 = m_archive->v2(m_archiveTrace);
+        pairs.resize(m_count);
+        for(size_t i=0; i<m_count; i++)
+        {
+            pairs[i] = AdcPair{v1[i], v2[i]};
+        }
+        return true;
+    }
+
+    if (m_spill)
+    {
+        return m_spill->read(m_spillOffset, m_count, pairs);
+    }
+
+    pairs = m_pairs;
+    return true;
+}
+
+bool TraceSnapshot::read(std::vector<float> &x, std::vector<float> &y) const
+{
+    if (m_archive && m_archiveValues)
+    {
+        x.assign(m_archive->x(m_archiveTrace), m_archive->x(m_archiveTrace) + m_count);
+        y.assign(m_archive->y(m_archiveTrace), m_archive->y(m_archiveTrace) + m_count);
+        return true;
+    }
+
+    std::vector<AdcPair> spilled;
+    const std::vector<AdcPair> *pairs = &m_pairs;
+    if (m_archive || m_spill)
+    {
+        if (!readRaw(spilled))
+        {
+            x.clear();
+            y.clear();
+            return false;
+        }
+        pairs = &spilled;
+    }
+
+    x.resize(pairs->size());
+    y.resize(pairs->size());
+    AdcConversion conversion(m_setup);
+    conversion.convert(pairs->data(), pairs->size(), x.data(), y.data());
+    return true;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <cstddef>
+#include "customevent.h"
+#include "tracearchive.h"
+
+/** append-only file that holds the raw samples of spilled traces.
+
+    The file is removed when the last owner releases it, so
+    snapshots can keep reading it after the store was cleared.
+    Reads use their own stream and can be done from any thread.
+*/
+class SpillFile
+{
+public:
+    explicit SpillFile(const std::string &filename);
+    ~SpillFile();
+
+    bool isOpen() const
+    {
+        return m_file.is_open();
+    }
+
+    /** append raw samples and return their position in offset */
+    bool append(const AdcPair *pairs, size_t count, std::streamoff &offset);
+
+    /** read count raw samples at offset, thread safe */
+    bool read(std::streamoff offset, size_t count, std::vector<AdcPair> &pairs) const;
+
+protected:
+    std::string   m_filename;
+    std::ofstream m_file;
+};
+
+/** immutable copy of a single trace that can be used from any thread.
+
+    Traces in memory are copied, spilled and archived traces only keep
+    a reference to their file, which is read when the samples are
+    requested. Snapshots are shared through TraceSnapshotPtr: as long
+    as a trace doesn't change the same snapshot is handed out again.
+*/
+struct TraceSnapshot
+{
+    SweepSetup  m_setup;
+    AdcPair     m_base;
+    bool        m_hasBase;
+    size_t      m_count;
+
+    std::vector<AdcPair> m_pairs;           // traces that were in memory
+
+    std::shared_ptr<const SpillFile> m_spill;   // spilled traces
+    std::streamoff m_spillOffset;
+
+    std::shared_ptr<const TraceArchive> m_archive;  // archived traces
+    size_t      m_archiveTrace;
+    bool        m_archiveValues;            // the archived values match m_setup
+
+    /** get the raw samples */
+    bool readRaw(std::vector<AdcPair> &pairs) const;
+
+    /** get the voltage and current of the samples */
+    bool read(std::vector<float> &x, std::vector<float> &y) const;
+};
+
+using TraceSnapshotPtr = std::shared_ptr<const TraceSnapshot>;
@@ -0,0 +1,460 @@
+#include <cstdio>
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include "conversion.h"
+#include "tracestore.h"
+
+void TraceStore::clear()
+{
+    m_freeBlocks.clear();
+    for(size_t block=0; block < m_blocks.size(); block++)
+    {
+        releaseBlock(block);
+    }
+
+    m_traces.clear();
+    m_setups.clear();
+    m_archive.reset();
+    m_residentPoints = 0;
+    m_firstResident = 0;
+
+    m_pageRaw.clear();
+    m_pageX.clear();
+    m_pageY.clear();
+    m_pagedTrace = c_noTrace;
+
+    // start over with an empty spill file. snapshots of the
+    // cleared traces keep the old one until they are released.
+    if (m_spill)
+    {
+        m_spill = std::make_shared<SpillFile>(m_spillFilename + "." + std::to_string(++m_spillGeneration));
+    }
+}
+
+void TraceStore::setLimits(size_t maxTraces, size_t maxBytes)
+{
+    m_maxTraces = maxTraces;
+    m_maxBytes  = maxBytes;
+}
+
+bool TraceStore::setSpillFile(const std::string &filename)
+{
+    // spilled traces would be lost
+    if (m_firstResident != 0)
+    {
+        return false;
+    }
+
+    m_spillFilename = filename;
+    m_spill = std::make_shared<SpillFile>(m_spillFilename);
+    if (!m_spill->isOpen())
+    {
+        m_spill.reset();
+        return false;
+    }
+    return true;
+}
+
+void TraceStore::attachArchive(std::shared_ptr<const TraceArchive> archive)
+{
+    clear();
+    m_archive = archive;
+
+    for(size_t i=0; i<m_archive->numberOfTraces(); i++)
+    {
+        const auto setup = m_archive->setup(i);
+        if (m_setups.empty() || !(m_setups.back() == setup))
+        {
+            m_setups.push_back(setup);
+        }
+
+        Range range{};
+        range.m_block   = c_noTrace;
+        range.m_count   = m_archive->size(i);
+        range.m_setup   = m_setups.size() - 1;
+        range.m_hasBase = m_archive->base(i, range.m_base);
+        range.m_archiveTrace  = i;
+        range.m_archiveValues = true;
+        m_traces.push_back(range);
+    }
+
+    // none of the archived traces are in memory
+    m_firstResident = m_traces.size();
+}
+
+size_t TraceStore::newTrace(const SweepSetup &setup)
+{
+    // consecutive traces usually share their setup
+    if (m_setups.empty() || !(m_setups.back() == setup))
+    {
+        m_setups.push_back(setup);
+    }
+
+    // the new trace continues the block of the last trace,
+    // that trace can't grow anymore.
+    Range range{};
+    if (m_traces.empty() || (m_traces.back().m_block == c_noTrace))
+    {
+        range.m_block = allocateBlock(c_blockSize);
+    }
+    else
+    {
+        range.m_block = m_traces.back().m_block;
+    }
+    range.m_first = m_blocks[range.m_block].m_x.size();
+    range.m_setup = m_setups.size() - 1;
+    range.m_archiveTrace = c_noTrace;
+    m_traces.push_back(range);
+    m_blocks[range.m_block].m_traces++;
+
+    if (m_spill)
+    {
+        while((m_firstResident+1 < m_traces.size()) && exceedsLimits())
+        {
+            if (!spill())
+            {
+                break;
+            }
+        }
+    }
+
+    return m_traces.size() - 1;
+}
+
+void TraceStore::append(const AdcPair *pairs, size_t count)
+{
+    if (m_traces.empty())
+    {
+        return;
+    }
+
+    auto &range = m_traces.back();
+    if (m_blocks[range.m_block].m_x.size() + count > m_blocks[range.m_block].m_x.capacity())
+    {
+        // the trace is at the end of its block, move it to a
+        // block with room for twice its size so a long sweep is
+        // moved a logarithmic number of times.
+        const size_t oldIndex = range.m_block;
+        const size_t newIndex = allocateBlock(2*(range.m_count + count));
+        auto &oldBlock = m_blocks[oldIndex];
+        auto &newBlock = m_blocks[newIndex];
+
+        newBlock.m_raw.assign(oldBlock.m_raw.begin() + range.m_first, oldBlock.m_raw.end());
+        newBlock.m_x.assign(oldBlock.m_x.begin() + range.m_first, oldBlock.m_x.end());
+        newBlock.m_y.assign(oldBlock.m_y.begin() + range.m_first, oldBlock.m_y.end());
+        newBlock.m_traces = 1;
+
+        oldBlock.m_raw.resize(range.m_first);
+        oldBlock.m_x.resize(range.m_first);
+        oldBlock.m_y.resize(range.m_first);
+        if (--oldBlock.m_traces == 0)
+        {
+            releaseBlock(oldIndex);
+        }
+
+        range.m_block = newIndex;
+        range.m_first = 0;
+    }
+
+    auto &block = m_blocks[range.m_block];
+    const size_t first = block.m_x.size();
+    block.m_raw.insert(block.m_raw.end(), pairs, pairs + count);
+    block.m_x.resize(first + count);
+    block.m_y.resize(first + count);
+
+    AdcConversion conversion(m_setups.at(range.m_setup));
+    conversion.convert(pairs, count, block.m_x.data() + first, block.m_y.data() + first);
+
+    range.m_count += count;
+    range.m_snapshot.reset();
+    m_residentPoints += count;
+}
+
+bool TraceStore::setSetup(const SweepSetup &setup)
+{
+    // the setups of the measured traces get the new conversion,
+    // the traces of an archive may share them and keep the old one.
+    std::map<size_t, size_t> corrected;
+    for(auto &range : m_traces)
+    {
+        if ((range.m_archiveTrace != c_noTrace) || m_setups[range.m_setup].sameConversion(setup))
+        {
+            continue;
+        }
+
+        auto known = corrected.find(range.m_setup);
+        if (known == corrected.end())
+        {
+            auto correctedSetup = m_setups[range.m_setup];
+            correctedSetup.m_baseSenseResistor = setup.m_baseSenseResistor;
+            correctedSetup.m_baseLimitResistor = setup.m_baseLimitResistor;
+            correctedSetup.m_collectorResistor = setup.m_collectorResistor;
+            std::copy(std::begin(setup.m_adcGain), std::end(setup.m_adcGain), correctedSetup.m_adcGain);
+            std::copy(std::begin(setup.m_adcOffset), std::end(setup.m_adcOffset), correctedSetup.m_adcOffset);
+            m_setups.push_back(correctedSetup);
+            known = corrected.emplace(range.m_setup, m_setups.size() - 1).first;
+        }
+
+        range.m_setup = known->second;
+        range.m_snapshot.reset();
+    }
+
+    if (corrected.empty())
+    {
+        return false;
+    }
+
+    // the traces in memory and the paged in trace, spilled
+    // traces are converted when they are read.
+    AdcConversion conversion(setup);
+    for(size_t trace = m_firstResident; trace < m_traces.size(); trace++)
+    {
+        const auto &range = m_traces[trace];
+        auto &block = m_blocks[range.m_block];
+        conversion.convert(block.m_raw.data() + range.m_first, range.m_count,
+            block.m_x.data() + range.m_first, block.m_y.data() + range.m_first);
+    }
+
+    if ((m_pagedTrace != c_noTrace) && (m_traces[m_pagedTrace].m_archiveTrace == c_noTrace))
+    {
+        conversion.convert(m_pageRaw.data(), m_pageRaw.size(), m_pageX.data(), m_pageY.data());
+    }
+    return true;
+}
+
+bool TraceStore::exceedsLimits() const noexcept
+{
+    const size_t residentTraces = m_traces.size() - m_firstResident;
+    if ((m_maxTraces != 0) && (residentTraces > m_maxTraces))
+    {
+        return true;
+    }
+
+    const size_t residentBytes = m_residentPoints * (sizeof(AdcPair) + 2*sizeof(float));
+    return (m_maxBytes != 0) && (residentBytes > m_maxBytes);
+}
+
+size_t TraceStore::memoryUsage() const noexcept
+{
+    size_t bytes = (m_pageX.capacity() + m_pageY.capacity()) * sizeof(float) +
+        m_pageRaw.capacity() * sizeof(AdcPair) +
+        m_traces.capacity() * sizeof(Range);
+
+    for(const auto &block : m_blocks)
+    {
+        bytes += (block.m_x.capacity() + block.m_y.capacity()) * sizeof(float) +
+            block.m_raw.capacity() * sizeof(AdcPair);
+    }
+    return bytes;
+}
+
+size_t TraceStore::allocateBlock(size_t capacity)
+{
+    size_t index;
+    if (m_freeBlocks.empty())
+    {
+        index = m_blocks.size();
+        m_blocks.emplace_back();
+    }
+    else
+    {
+        index = m_freeBlocks.back();
+        m_freeBlocks.pop_back();
+    }
+
+    // reserve() keeps a larger capacity of a re-used block
+    auto &block = m_blocks[index];
+    capacity = std::max(capacity, c_blockSize);
+    block.m_raw.reserve(capacity);
+    block.m_x.reserve(capacity);
+    block.m_y.reserve(capacity);
+    return index;
+}
+
+void TraceStore::releaseBlock(size_t block)
+{
+    m_blocks[block].m_raw.clear();
+    m_blocks[block].m_x.clear();
+    m_blocks[block].m_y.clear();
+    m_blocks[block].m_traces = 0;
+    m_freeBlocks.push_back(block);
+}
+
+bool TraceStore::spill()
+{
+    auto &range = m_traces.at(m_firstResident);
+    auto &block = m_blocks[range.m_block];
+
+    // the spill file is append-only and holds the raw
+    // samples, the values are derived again when read.
+    if (!m_spill->append(block.m_raw.data() + range.m_first, range.m_count, range.m_fileOffset))
+    {
+        // keep the trace in memory, exceeding the limit
+        // is better than losing the data
+        return false;
+    }
+
+    // a snapshot of the trace holds a copy of its samples,
+    // the next one can read them from the spill file.
+    range.m_snapshot.reset();
+
+    // the samples stay where they are until the last trace
+    // of the block is spilled, the block is then re-used.
+    if (--block.m_traces == 0)
+    {
+        releaseBlock(range.m_block);
+    }
+    m_residentPoints -= range.m_count;
+    range.m_block = c_noTrace;
+    m_firstResident++;
+    return true;
+}
+
+bool TraceStore::pageIn(size_t trace)
+{
+    if (isAvailable(trace))
+    {
+        return true;
+    }
+
+    if ((trace >= m_traces.size()) || !readRaw(trace, m_pageRaw))
+    {
+        m_pagedTrace = c_noTrace;
+        m_pageRaw.clear();
+        return false;
+    }
+
+    const auto &range = m_traces[trace];
+    if (range.m_archiveValues)
+    {
+        m_pageX.assign(m_archive->x(range.m_archiveTrace), m_archive->x(range.m_archiveTrace) + range.m_count);
+        m_pageY.assign(m_archive->y(range.m_archiveTrace), m_archive->y(range.m_archiveTrace) + range.m_count);
+    }
+    else
+    {
+        m_pageX.resize(m_pageRaw.size());
+        m_pageY.resize(m_pageRaw.size());
+        AdcConversion conversion(setup(trace));
+        conversion.convert(m_pageRaw.data(), m_pageRaw.size(), m_pageX.data(), m_pageY.data());
+    }
+
+    m_pagedTrace = trace;
+    return true;
+}
+
+bool TraceStore::read(size_t trace, std::vector<float> &x, std::vector<float> &y) const
+{
+    const auto &range = m_traces.at(trace);
+    x.resize(range.m_count);
+    y.resize(range.m_count);
+
+    if (isAvailable(trace))
+    {
+        std::copy(this->x(trace), this->x(trace) + range.m_count, x.begin());
+        std::copy(this->y(trace), this->y(trace) + range.m_count, y.begin());
+        return true;
+    }
+
+    std::vector<AdcPair> pairs;
+    if (!readRaw(trace, pairs))
+    {
+        x.clear();
+        y.clear();
+        return false;
+    }
+
+    AdcConversion conversion(setup(trace));
+    conversion.convert(pairs.data(), pairs.size(), x.data(), y.data());
+    return true;
+}
+
+bool TraceStore::readRaw(size_t trace, std::vector<AdcPair> &pairs) const
+{
+    const auto &range = m_traces.at(trace);
+
+    if (isResident(trace))
+    {
+        const auto first = m_blocks[range.m_block].m_raw.begin() + range.m_first;
+        pairs.assign(first, first + range.m_count);
+        return true;
+    }
+
+    if (trace == m_pagedTrace)
+    {
+        pairs = m_pageRaw;
+        return true;
+    }
+
+    if (range.m_archiveTrace != c_noTrace)
+    {
+        // the archive stores v1 and v2 as separate columns
+        const auto v1 = m_archive->v1(range.m_archiveTrace);
+        const auto v2 = m_archive->v2(range.m_archiveTrace);
+        pairs.resize(range.m_count);
+        for(size_t i=0; i<range.m_count; i++)
+        {
+            pairs[i] = AdcPair{v1[i], v2[i]};
+        }
+        return true;
+    }
+
+    return m_spill && m_spill->read(range.m_fileOffset, range.m_count, pairs);
+}
+
+TraceSnapshotPtr TraceStore::snapshot(size_t trace) const
+{
+    const auto &range = m_traces.at(trace);
+    if (auto shared = range.m_snapshot.lock())
+    {
+        return shared;
+    }
+
+    auto snapshot = std::make_shared<TraceSnapshot>();
+    snapshot->m_setup   = setup(trace);
+    snapshot->m_base    = range.m_base;
+    snapshot->m_hasBase = range.m_hasBase;
+    snapshot->m_count   = range.m_count;
+    snapshot->m_spillOffset   = range.m_fileOffset;
+    snapshot->m_archiveTrace  = range.m_archiveTrace;
+    snapshot->m_archiveValues = range.m_archiveValues;
+
+    // only traces in memory are copied, the spill file
+    // and the archive are never changed once written.
+    if (range.m_archiveTrace != c_noTrace)
+    {
+        snapshot->m_archive = m_archive;
+    }
+    else if (isResident(trace))
+    {
+        const auto first = m_blocks[range.m_block].m_raw.begin() + range.m_first;
+        snapshot->m_pairs.assign(first, first + range.m_count);
+    }
+    else
+    {
+        snapshot->m_spill = m_spill;
+    }
+
+    range.m_snapshot = snapshot;
+    return snapshot;
+}
+
+const float* TraceStore::x(size_t trace) const
+{
+    if (trace == m_pagedTrace)
+    {
+        return m_pageX.data();
+    }
+    const auto &range = m_traces.at(trace);
+    return m_blocks[range.m_block].m_x.data() + range.m_first;
+}
+
+const float* TraceStore::y(size_t trace) const
+{
+    if (trace == m_pagedTrace)
+    {
+        return m_pageY.data();
+    }
+    const auto &range = m_traces.at(trace);
+    return m_blocks[range.m_block].m_y.data() + range.m_first;
+}
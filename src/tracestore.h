@@ -0,0 +1,226 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <memory>
+#include <limits>
+#include <cstdint>
+#include <cstddef>
+#include <QPointF>
+#include "customevent.h"
+#include "tracearchive.h"
+#include "tracesnapshot.h"
+
+/** storage for the samples of all traces in a session.
+
+    The raw ADC pairs of every sample are kept together with the sweep
+    setup they were measured with. The physical values are derived from
+    them and kept as floats in two arrays, one for x and one for y,
+    so a corrected setup can be applied to all traces without
+    measuring again. Every trace is a range of consecutive samples in
+    one of a set of blocks. Only the last trace can grow so appending
+    never moves the samples of the other traces; when the last trace
+    outgrows its block it is moved to a new one. A block is released
+    once all its traces are spilled and is used again for new traces,
+    so spilling never moves samples either. Clearing keeps the blocks
+    so the next session doesn't have to allocate them again.
+
+    The derived floats take half the memory of a QPointF and scans over
+    a single axis use the cache fully.
+
+    The number of traces and bytes kept in memory can be limited. The
+    oldest traces are then appended to a spill file and released, and
+    can be paged back in one at a time. This keeps the working set
+    constant during long persistence runs.
+
+    The store is not thread safe. Other threads work on immutable
+    snapshots of the traces, see snapshot().
+*/
+class TraceStore
+{
+public:
+    static constexpr size_t c_noTrace = std::numeric_limits<size_t>::max();
+
+    /** remove all traces, the memory is kept for re-use */
+    void clear();
+
+    /** limit the traces kept in memory to maxTraces traces and maxBytes
+        bytes of samples, zero disables a limit. The limits are applied
+        when a new trace is started by spilling the oldest traces. The
+        last trace always stays in memory. */
+    void setLimits(size_t maxTraces, size_t maxBytes);
+
+    /** create the file the spilled traces are appended to, it is
+        removed when the store and all snapshots that use it are
+        destroyed. Without a spill file the limits are not applied. */
+    bool setSpillFile(const std::string &filename);
+
+    /** add the traces of an archive to an empty store. they are
+        not loaded, like spilled traces they can be paged in. */
+    void attachArchive(std::shared_ptr<const TraceArchive> archive);
+
+    /** start a new, empty, trace measured with setup and return its index */
+    size_t newTrace(const SweepSetup &setup);
+
+    /** append raw samples to the last trace, they are converted
+        with the setup of the trace. newTrace() must be called first. */
+    void append(const AdcPair *pairs, size_t count);
+
+    /** apply the resistors and ADC calibration of setup to the traces
+        measured in this session and derive their values again. The
+        other sweep settings and archived traces keep their setup.
+        Returns true if any values changed. */
+    bool setSetup(const SweepSetup &setup);
+
+    /** setup a trace was measured with */
+    const SweepSetup& setup(size_t trace) const
+    {
+        return m_setups.at(m_traces.at(trace).m_setup);
+    }
+
+    /** set the base measurement that belongs to a trace */
+    void setBase(size_t trace, const AdcPair &base)
+    {
+        m_traces.at(trace).m_base = base;
+        m_traces.at(trace).m_hasBase = true;
+        m_traces.at(trace).m_snapshot.reset();
+    }
+
+    /** get the base measurement of a trace, returns false if there is none */
+    bool base(size_t trace, AdcPair &base) const
+    {
+        base = m_traces.at(trace).m_base;
+        return m_traces.at(trace).m_hasBase;
+    }
+
+    size_t numberOfTraces() const noexcept
+    {
+        return m_traces.size();
+    }
+
+    /** number of points in a trace */
+    size_t size(size_t trace) const
+    {
+        return m_traces.at(trace).m_count;
+    }
+
+    /** traces are spilled oldest first, all traces from
+        this index onwards are in memory */
+    size_t firstResident() const noexcept
+    {
+        return m_firstResident;
+    }
+
+    bool isResident(size_t trace) const noexcept
+    {
+        return (trace >= m_firstResident) && (trace < m_traces.size());
+    }
+
+    /** true if x() and y() can be used: the trace
+        is in memory or it has been paged in */
+    bool isAvailable(size_t trace) const noexcept
+    {
+        return isResident(trace) || (trace == m_pagedTrace);
+    }
+
+    /** spilled trace that is currently paged in, or c_noTrace */
+    size_t pagedTrace() const noexcept
+    {
+        return m_pagedTrace;
+    }
+
+    /** read a spilled trace back from the spill file. Only one
+        trace is paged in at a time, it replaces the previous one. */
+    bool pageIn(size_t trace);
+
+    /** copy the samples of any trace, spilled or not */
+    bool read(size_t trace, std::vector<float> &x, std::vector<float> &y) const;
+
+    /** copy the raw samples of any trace, spilled or not */
+    bool readRaw(size_t trace, std::vector<AdcPair> &pairs) const;
+
+    /** immutable copy of a trace that can be used from any thread.
+        The snapshot is shared until the trace changes, and a spilled
+        trace is only read from the spill file when the snapshot is used. */
+    TraceSnapshotPtr snapshot(size_t trace) const;
+
+    /** x coordinates of an available trace, invalidated by appending to the trace */
+    const float* x(size_t trace) const;
+
+    /** y coordinates of an available trace, invalidated by appending to the trace */
+    const float* y(size_t trace) const;
+
+    QPointF point(size_t trace, size_t index) const
+    {
+        return QPointF{x(trace)[index], y(trace)[index]};
+    }
+
+    /** number of points kept in memory */
+    size_t numberOfPoints() const noexcept
+    {
+        return m_residentPoints;
+    }
+
+    /** number of bytes allocated for the samples */
+    size_t memoryUsage() const noexcept;
+
+    /** samples per block, a longer trace gets a larger block */
+    static constexpr size_t c_blockSize = 65536;
+
+protected:
+    struct Block
+    {
+        std::vector<AdcPair> m_raw;     // the measurements
+        std::vector<float> m_x;         // derived from m_raw
+        std::vector<float> m_y;
+        size_t m_traces = 0;            // resident traces in the block
+    };
+
+    struct Range
+    {
+        size_t m_block;         // index in m_blocks, c_noTrace if not in memory
+        size_t m_first;         // index of the first sample in the block
+        size_t m_count;         // number of samples
+        std::streamoff m_fileOffset;    // position in the spill file, once spilled
+        size_t m_setup;         // index in m_setups
+        AdcPair m_base;         // base measurement, transistor sweeps only
+        bool m_hasBase;
+        size_t m_archiveTrace;  // trace in m_archive or c_noTrace
+        bool m_archiveValues;   // the derived values in the archive match m_setup
+        mutable std::weak_ptr<const TraceSnapshot> m_snapshot;  // last snapshot handed out
+    };
+
+    /** true if the samples in memory exceed the limits */
+    bool exceedsLimits() const noexcept;
+
+    /** move the oldest trace in memory to the spill file */
+    bool spill();
+
+    /** get an empty block with room for at least capacity samples */
+    size_t allocateBlock(size_t capacity);
+
+    /** empty a block and keep it for re-use */
+    void releaseBlock(size_t block);
+
+    std::vector<Block> m_blocks;
+    std::vector<size_t> m_freeBlocks;   // empty blocks, in m_blocks
+    std::vector<Range> m_traces;
+    std::vector<SweepSetup> m_setups;
+    size_t m_residentPoints = 0;
+    size_t m_firstResident = 0;
+
+    size_t m_maxTraces = 0;
+    size_t m_maxBytes  = 0;
+
+    std::string m_spillFilename;
+    unsigned    m_spillGeneration = 0;  // clear() starts a new file, snapshots may use the old one
+    std::shared_ptr<SpillFile> m_spill;
+
+    std::shared_ptr<const TraceArchive> m_archive;
+
+    std::vector<AdcPair> m_pageRaw; // samples of the paged in trace
+    std::vector<float> m_pageX;
+    std::vector<float> m_pageY;
+    size_t m_pagedTrace = c_noTrace;
+};
@@ -0,0 +1,147 @@
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "check.h"
+#include "tracermodel.h"
+#include "adaptivesweep.h"
+
+/** the adaptive collector sweep against uniform sweeps with a step
+    of 10 and with as many points as the adaptive sweep, on the
+    simulated tracer. A sweep is compared with a reference sweep over
+    every PWM: the collector current of each reference point is
+    interpolated from the points of the sweep, the largest difference
+    is the error of the sweep. The knee is where the device voltage is
+    below 0.3V. The limits are those of SweepPlan::adaptiveLimits(). */
+
+static constexpr float c_kneeVolts = 0.3f;
+
+struct Sweep
+{
+    std::vector<AdcPair> m_points;
+    size_t m_kneePoints;
+    float  m_error;         // as a fraction of the current span
+};
+
+static AdcPair measure(TracerModel &model, uint16_t pwm, char command)
+{
+    std::vector<std::string> responses;
+    const auto line = std::to_string(pwm) + command + " \n";
+    model.receive(line.data(), line.size(), responses);
+
+    AdcPair pair{0,0};
+    std::sscanf(responses.at(0).c_str(), "%d\t%d", &pair.m_v1, &pair.m_v2);
+    return pair;
+}
+
+/** collector current in counts at the device voltage v2, interpolated
+    between the points, which are sorted by PWM */
+static float interpolate(const std::vector<AdcPair> &points, int32_t v2)
+{
+    for(size_t i=1; i<points.size(); i++)
+    {
+        const auto &a = points[i-1];
+        const auto &b = points[i];
+        if ((v2 >= a.m_v2) && (v2 <= b.m_v2))
+        {
+            const float t = (b.m_v2 == a.m_v2) ? 0.0f : static_cast<float>(v2 - a.m_v2) / (b.m_v2 - a.m_v2);
+            return (a.m_v1 - a.m_v2) + t * ((b.m_v1 - b.m_v2) - (a.m_v1 - a.m_v2));
+        }
+    }
+    return static_cast<float>(points.back().m_v1 - points.back().m_v2);
+}
+
+static void evaluate(Sweep &sweep, const std::vector<AdcPair> &reference)
+{
+    int32_t span = 1;
+    for(const auto &point : reference)
+    {
+        span = std::max(span, point.m_v1 - point.m_v2);
+    }
+
+    sweep.m_error = 0.0f;
+    for(const auto &point : reference)
+    {
+        const float error = std::fabs(interpolate(sweep.m_points, point.m_v2) - (point.m_v1 - point.m_v2));
+        sweep.m_error = std::max(sweep.m_error, error / span);
+    }
+
+    const auto kneeCounts = static_cast<int32_t>(c_kneeVolts * TracerModel::c_countsPerVolt);
+    sweep.m_kneePoints = std::count_if(sweep.m_points.begin(), sweep.m_points.end(),
+        [kneeCounts](const AdcPair &point) { return point.m_v2 < kneeCounts; });
+}
+
+int main()
+{
+    AdaptiveSweep::Limits limits;
+    limits.m_start      = 0;
+    limits.m_end        = 1023;
+    limits.m_coarseStep = 32;
+    limits.m_minStep    = 1;
+    limits.m_tolerance  = 0.003f;
+    limits.m_maxPoints  = 128;
+
+    std::printf("%8s  %-8s  %6s  %11s  %9s\n", "base PWM", "sweep", "points", "knee points", "max error");
+
+    for(uint16_t basePwm : {300, 400, 550})
+    {
+        TracerModel model(TracerModel::defaultTransistor(), TracerModel::Firmware{false, false});
+        measure(model, basePwm, 'B');
+
+        std::vector<AdcPair> reference;
+        for(uint16_t pwm = 0; pwm <= 1023; pwm++)
+        {
+            reference.push_back(measure(model, pwm, 'C'));
+        }
+
+        Sweep uniform;
+        for(uint16_t pwm = 0; pwm <= 1023; pwm += 10)
+        {
+            uniform.m_points.push_back(measure(model, pwm, 'C'));
+        }
+        evaluate(uniform, reference);
+
+        // a round at a time, like SerialCtrl::sweepCollectorAdaptive()
+        AdaptiveSweep adaptiveSweep;
+        auto round = adaptiveSweep.start(limits);
+        while(!round.empty())
+        {
+            for(auto pwm : round)
+            {
+                adaptiveSweep.addPoint(pwm, measure(model, pwm, 'C'));
+            }
+            round = adaptiveSweep.refine();
+        }
+
+        Sweep adaptive;
+        for(const auto &point : adaptiveSweep.points())
+        {
+            adaptive.m_points.push_back(point.m_reading);
+        }
+        evaluate(adaptive, reference);
+
+        // a uniform sweep with as many points as the adaptive one
+        Sweep sparse;
+        const size_t count = adaptive.m_points.size();
+        for(size_t i=0; i<count; i++)
+        {
+            sparse.m_points.push_back(measure(model, static_cast<uint16_t>((i * 1023 + (count-1)/2) / (count-1)), 'C'));
+        }
+        evaluate(sparse, reference);
+
+        std::printf("%8u  %-8s  %6zu  %11zu  %8.2f%%\n", basePwm, "step 10",
+            uniform.m_points.size(), uniform.m_kneePoints, uniform.m_error * 100.0f);
+        std::printf("%8s  %-8s  %6zu  %11zu  %8.2f%%\n", "", "uniform",
+            sparse.m_points.size(), sparse.m_kneePoints, sparse.m_error * 100.0f);
+        std::printf("%8s  %-8s  %6zu  %11zu  %8.2f%%\n", "", "adaptive",
+            adaptive.m_points.size(), adaptive.m_kneePoints, adaptive.m_error * 100.0f);
+
+        // the knee is steep in the plane of the refinement,
+        // a uniform PWM step puts about as many points there.
+        CHECK(adaptive.m_points.size() < uniform.m_points.size());
+        CHECK(adaptive.m_error < sparse.m_error);
+    }
+
+    return checkFailures();
+}
@@ -0,0 +1,132 @@
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "check.h"
+#include "tracermodel.h"
+#include "basecurrentsearch.h"
+
+/** BaseCurrentSearch against the simulated tracer, for transistors
+    whose base-emitter voltage differs from the 0.65V the open-loop
+    PWM assumes. Every base measurement is repeated until two agree,
+    like SerialCtrl settles a base PWM. The table compares the error
+    of the open-loop PWM with the error after the search. */
+
+static constexpr float c_senseResistor = 3.3e3f;   // of TracerModel::defaultTransistor()
+static constexpr float c_limitResistor = 100e3f;
+static constexpr float c_voltsPerCount = 5.0f / 262144.0f;
+static constexpr int32_t  c_settleTolerance    = 64;
+static constexpr uint32_t c_settleMeasurements = 5;
+
+struct Result
+{
+    float    m_openLoopError;   // relative error of the base current
+    float    m_error;
+    bool     m_converged;
+    uint32_t m_iterations;
+    uint32_t m_measurements;    // including the settling
+};
+
+/** set the base PWM and measure until two readings agree */
+static AdcPair measureBase(TracerModel &model, uint16_t pwm, uint32_t &measurements)
+{
+    AdcPair last{0,0};
+    for(uint32_t i=0; i<c_settleMeasurements; i++)
+    {
+        std::vector<std::string> responses;
+        const auto command = std::to_string(pwm) + "B \n";
+        model.receive(command.data(), command.size(), responses);
+        measurements++;
+
+        AdcPair pair{0,0};
+        std::sscanf(responses.at(0).c_str(), "%d\t%d", &pair.m_v1, &pair.m_v2);
+        const bool settled = (i > 0) && (std::abs((pair.m_v1 - pair.m_v2) - (last.m_v1 - last.m_v2)) <= c_settleTolerance);
+        last = pair;
+        if (settled)
+        {
+            break;
+        }
+    }
+    return last;
+}
+
+static Result search(const TracerModel::Device &device, float microamps)
+{
+    TracerModel model(device, TracerModel::Firmware{false, false});
+
+    // the open-loop guess and the target of SweepPlan::baseTarget()
+    const float countsPerAmp = c_senseResistor / c_voltsPerCount;
+    BaseCurrentSearch::Target target;
+    target.m_counts       = microamps * 1e-6f * countsPerAmp;
+    target.m_countsPerPwm = (5.0f / 1023.0f) / (c_senseResistor + c_limitResistor) * countsPerAmp;
+    target.m_tolerance    = std::max(0.01f * target.m_counts, target.m_countsPerPwm);
+    target.m_gain[0]      = 1.0f;
+    target.m_gain[1]      = 1.0f;
+    target.m_offset[0]    = 0.0f;
+    target.m_offset[1]    = 0.0f;
+    target.m_pwm          = static_cast<uint16_t>(std::clamp(
+        ((microamps * 1e-6f * (c_senseResistor + c_limitResistor) + 0.65f) / 5.0f) * 1023.0f, 0.0f, 1023.0f));
+    target.m_maxIterations = 8;
+
+    Result result{};
+    BaseCurrentSearch baseSearch;
+    uint16_t pwm = baseSearch.start(target);
+    AdcPair measurement = measureBase(model, pwm, result.m_measurements);
+    result.m_openLoopError = baseSearch.senseCounts(measurement) / target.m_counts - 1.0f;
+
+    while(baseSearch.next(measurement, pwm))
+    {
+        measurement = measureBase(model, pwm, result.m_measurements);
+    }
+
+    // the search ends on the best PWM when it converged,
+    // otherwise that PWM is set again.
+    if (!baseSearch.converged())
+    {
+        measurement = measureBase(model, baseSearch.bestPwm(), result.m_measurements);
+    }
+
+    result.m_error      = baseSearch.senseCounts(measurement) / target.m_counts - 1.0f;
+    result.m_converged  = baseSearch.converged();
+    result.m_iterations = baseSearch.iterations();
+    return result;
+}
+
+int main()
+{
+    struct Part
+    {
+        const char *m_name;
+        TracerModel::Device m_device;
+    };
+
+    std::vector<Part> parts;
+    parts.push_back({"Vbe 0.65V", TracerModel::defaultTransistor()});
+    parts.push_back({"Vbe 0.77V", TracerModel::defaultTransistor()});
+    parts.back().m_device.m_saturationCurrent = 1.4e-18f;
+    parts.push_back({"Vbe 0.53V, noisy", TracerModel::defaultTransistor()});
+    parts.back().m_device.m_saturationCurrent = 1.4e-14f;
+    parts.back().m_device.m_noise = 8;
+
+    std::printf("%-18s %6s  %10s  %8s  %10s  %12s\n",
+        "part", "uA", "open loop", "search", "iterations", "measurements");
+
+    for(const auto &part : parts)
+    {
+        for(float microamps : {5.0f, 10.0f, 20.0f, 40.0f})
+        {
+            const auto result = search(part.m_device, microamps);
+            std::printf("%-18s %6.1f  %9.1f%%  %7.2f%%  %10u  %12u\n", part.m_name, microamps,
+                result.m_openLoopError * 100.0f, result.m_error * 100.0f,
+                result.m_iterations, result.m_measurements);
+
+            // 1% or a single PWM step, which is 1.2% at 5uA
+            CHECK(result.m_converged);
+            CHECK(std::fabs(result.m_error) <= 0.0125f);
+            CHECK(result.m_iterations <= 8);
+        }
+    }
+
+    return checkFailures();
+}
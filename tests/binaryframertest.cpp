@@ -0,0 +1,218 @@
+#include <array>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "check.h"
+#include "tracermodel.h"
+#include "binaryframer.h"
+
+/** the values of the record at the end of a model response, decoded
+    without BinaryFramer */
+static std::array<int32_t, 2> recordValues(const std::string &response)
+{
+    const auto *p = reinterpret_cast<const uint8_t*>(response.data() + response.size() - BinaryFramer::c_responseSize);
+    return {p[1] | (p[2] << 8) | (p[3] << 16), p[4] | (p[5] << 8) | (p[6] << 16)};
+}
+
+/** feed a byte stream to the framer in chunks of pseudo-random
+    sizes and return all the records it decodes */
+static std::vector<std::array<int32_t, 2>> decode(BinaryFramer &framer, const std::string &stream, uint32_t seed)
+{
+    std::vector<std::array<int32_t, 2>> frames;
+    size_t offset = 0;
+    while(offset < stream.size())
+    {
+        seed = seed * 1103515245u + 12345u;
+        const size_t chunk = std::min<size_t>(1 + (seed >> 16) % 700, stream.size() - offset);
+
+        size_t written = 0;
+        while(written < chunk)
+        {
+            written += framer.write(stream.data() + offset + written, chunk - written);
+
+            std::array<int32_t, 2> values;
+            while(framer.readFrame(values[0], values[1]))
+            {
+                frames.push_back(values);
+            }
+        }
+        offset += chunk;
+    }
+    return frames;
+}
+
+static void sendCommand(TracerModel &model, char command, uint16_t arg, std::vector<std::string> &responses)
+{
+    const auto record = BinaryFramer::encodeCommand(command, arg);
+
+    // the USB-serial converter may split the record anywhere
+    for(auto c : record)
+    {
+        model.receive(reinterpret_cast<const char*>(&c), 1, responses);
+    }
+}
+
+static void testHandshake()
+{
+    std::vector<std::string> responses;
+    TracerModel model(TracerModel::defaultTransistor(), TracerModel::Firmware{true, false});
+    model.receive("1P \n", 4, responses);
+
+    CHECK(model.isBinary());
+    CHECK(responses.size() == 1);
+
+    BinaryFramer framer;
+    const auto frames = decode(framer, responses.at(0), 1);
+    CHECK(frames.size() == 1);
+    CHECK(frames.at(0)[0] == BinaryFramer::c_protocolMagic);
+
+    // the released firmware doesn't answer, the host falls back to ASCII
+    responses.clear();
+    TracerModel ascii(TracerModel::defaultTransistor(), TracerModel::Firmware{false, false});
+    ascii.receive("1P \n", 4, responses);
+    CHECK(!ascii.isBinary());
+    CHECK(responses.empty());
+
+    ascii.receive("512C \n", 6, responses);
+    CHECK(responses.size() == 1);
+    CHECK(responses.at(0).back() == '\n');
+}
+
+/** a long exchange with garbage between the records, read in odd-sized pieces */
+static void testStream(uint32_t garbageInterval)
+{
+    std::vector<std::string> responses;
+    TracerModel model(TracerModel::defaultTransistor(), TracerModel::Firmware{true, false});
+    model.receive("1P \n", 4, responses);
+    model.setGarbageInterval(garbageInterval);
+    responses.clear();
+
+    uint32_t seed = 42;
+    for(int i=0; i<5000; i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        const auto pwm = static_cast<uint16_t>((seed >> 16) % 1024);
+        sendCommand(model, ((i % 10) == 0) ? 'B' : 'C', pwm, responses);
+    }
+
+    CHECK(responses.size() == 5000);
+    CHECK(model.commands('B') == 500);
+    CHECK(model.commands('C') == 4500);
+
+    std::string stream;
+    std::vector<std::array<int32_t, 2>> expected;
+    for(const auto &response : responses)
+    {
+        stream += response;
+        expected.push_back(recordValues(response));
+    }
+
+    BinaryFramer framer;
+    const auto frames = decode(framer, stream, garbageInterval + 7);
+    CHECK(frames == expected);
+
+    if (garbageInterval == 0)
+    {
+        CHECK(framer.checksumErrors() == 0);
+    }
+    else
+    {
+        CHECK(framer.checksumErrors() >= 5000 / garbageInterval);
+    }
+}
+
+/** a corrupted record is dropped, the records around it are not */
+static void testCorruption()
+{
+    std::vector<std::string> responses;
+    TracerModel model(TracerModel::defaultTransistor(), TracerModel::Firmware{true, false});
+    model.receive("1P \n", 4, responses);
+    responses.clear();
+
+    for(uint16_t pwm=0; pwm<1024; pwm+=16)
+    {
+        sendCommand(model, 'C', pwm, responses);
+    }
+
+    std::string stream;
+    std::vector<std::array<int32_t, 2>> expected;
+    for(size_t i=0; i<responses.size(); i++)
+    {
+        auto response = responses[i];
+        if ((i % 5) == 2)
+        {
+            response[1 + i % 6] ^= 0x10;
+        }
+        else
+        {
+            expected.push_back(recordValues(response));
+        }
+        stream += response;
+    }
+
+    BinaryFramer framer;
+    const auto frames = decode(framer, stream, 3);
+    CHECK(frames == expected);
+    CHECK(framer.checksumErrors() > 0);
+}
+
+/** the device-side sweep streams a record per step */
+static void testDeviceSweep()
+{
+    std::vector<std::string> responses;
+    TracerModel model(TracerModel::defaultTransistor(), TracerModel::Firmware{true, true});
+    model.receive("1P \n", 4, responses);
+
+    BinaryFramer framer;
+    auto frames = decode(framer, responses.at(0), 5);
+    CHECK(frames.size() == 1);
+    CHECK((frames.at(0)[1] & BinaryFramer::c_featureSweep) != 0);
+
+    responses.clear();
+    sendCommand(model, 'B', 300, responses);
+    const auto record = BinaryFramer::encodeCommand('S', 0, 1000, 10);
+    model.receive(reinterpret_cast<const char*>(record.data()), record.size(), responses);
+    CHECK(responses.size() == 1 + 101);
+    CHECK(model.commands('S') == 1);
+
+    std::string stream;
+    for(const auto &response : responses)
+    {
+        stream += response;
+    }
+    frames = decode(framer, stream, 9);
+    CHECK(frames.size() == responses.size());
+
+    // the same readings as single collector commands
+    TracerModel reference(TracerModel::defaultTransistor(), TracerModel::Firmware{true, false});
+    responses.clear();
+    reference.receive("1P \n", 4, responses);
+    responses.clear();
+    sendCommand(reference, 'B', 300, responses);
+    for(uint16_t pwm=0; pwm<=1000; pwm+=10)
+    {
+        sendCommand(reference, 'C', pwm, responses);
+    }
+
+    CHECK(responses.size() == frames.size());
+    for(size_t i=0; (i<responses.size()) && (i<frames.size()); i++)
+    {
+        CHECK(frames[i] == recordValues(responses[i]));
+    }
+}
+
+int main()
+{
+    testHandshake();
+    testStream(0);
+    testStream(3);
+    testStream(11);
+    testCorruption();
+    testDeviceSweep();
+
+    if (checkFailures() == 0)
+    {
+        std::cout << "binaryframertest passed\n";
+    }
+    return checkFailures();
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <iostream>
+
+/** minimal test checks. A failed check is reported and counted,
+    the test returns the count from main() so ctest sees the failure. */
+inline int& checkFailures()
+{
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition "\n"; \
+            checkFailures()++; \
+        } \
+    } while(0)
@@ -0,0 +1,93 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include <algorithm>
+#include "conversion.h"
+
+/** throughput of the ADC conversion in Gsamples/s: the SIMD kernel
+    of AdcConversion::convert() against its scalar kernel, on a batch
+    that fits in the cache and on one the size of a re-derived
+    session. Build with ENABLE_AVX2 to measure the AVX2 kernel, the
+    default x86 build uses SSE2. The compiler may vectorize the
+    scalar loop too at -O3. */
+
+using Clock = std::chrono::steady_clock;
+
+static double seconds(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/** exposes the scalar kernel */
+class BenchConversion : public AdcConversion
+{
+public:
+    using AdcConversion::AdcConversion;
+    using AdcConversion::convertScalar;
+};
+
+/** convert count samples repeats times with both kernels */
+static void measure(const BenchConversion &conversion, const std::vector<AdcPair> &pairs,
+    size_t count, int repeats)
+{
+    std::vector<float> voltage(count);
+    std::vector<float> current(count);
+    std::vector<float> scalarVoltage(count);
+    std::vector<float> scalarCurrent(count);
+
+    // warm up the caches and the page tables
+    conversion.convert(pairs.data(), count, voltage.data(), current.data());
+    conversion.convertScalar(pairs.data(), count, scalarVoltage.data(), scalarCurrent.data());
+
+    auto start = Clock::now();
+    for(int i=0; i<repeats; i++)
+    {
+        conversion.convert(pairs.data(), count, voltage.data(), current.data());
+    }
+    const double simdTime = seconds(start);
+
+    start = Clock::now();
+    for(int i=0; i<repeats; i++)
+    {
+        conversion.convertScalar(pairs.data(), count, scalarVoltage.data(), scalarCurrent.data());
+    }
+    const double scalarTime = seconds(start);
+
+    float maxError = 0.0f;
+    for(size_t i=0; i<count; i++)
+    {
+        maxError = std::max(maxError, std::abs(voltage[i] - scalarVoltage[i]));
+        maxError = std::max(maxError, std::abs(current[i] - scalarCurrent[i]));
+    }
+
+    const double samples = static_cast<double>(count) * repeats;
+    std::printf("%8zu samples  convert %6.2f  convertScalar %6.2f Gsamples/s  largest difference %g\n",
+        count, samples / simdTime * 1e-9, samples / scalarTime * 1e-9, maxError);
+}
+
+int main()
+{
+    SweepSetup setup{};
+    setup.m_baseLimitResistor = 100.0f;
+    setup.m_baseSenseResistor = 3.3f;
+    setup.m_collectorResistor = 1.0f;
+    setup.m_adcGain[0]   = 1.002f;
+    setup.m_adcGain[1]   = 0.998f;
+    setup.m_adcOffset[0] = -12.0f;
+    setup.m_adcOffset[1] = 7.5f;
+    const BenchConversion conversion(setup);
+
+    // collector sweeps over the full ADC range
+    std::vector<AdcPair> pairs(1 << 20);
+    for(size_t i=0; i<pairs.size(); i++)
+    {
+        const auto v1 = static_cast<int32_t>((i * 2654435761u) % 262144);
+        pairs[i] = AdcPair{v1, v1 / 3};
+    }
+
+    // a block of a sweep that stays in the cache, and a
+    // re-derived session that is limited by the memory
+    measure(conversion, pairs, 4096, 50000);
+    measure(conversion, pairs, pairs.size(), 200);
+}
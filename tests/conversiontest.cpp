@@ -0,0 +1,92 @@
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "check.h"
+#include "conversion.h"
+
+/** the SIMD kernel of AdcConversion::convert() against its scalar
+    kernel, on lengths that leave every tail of the 4 and 8 sample
+    loops, with a calibration that isn't the identity. */
+
+static uint32_t g_seed = 1;
+
+static uint32_t random(uint32_t range)
+{
+    g_seed = g_seed * 1103515245u + 12345u;
+    return (g_seed >> 8) % range;
+}
+
+/** exposes the scalar kernel */
+class TestConversion : public AdcConversion
+{
+public:
+    using AdcConversion::AdcConversion;
+    using AdcConversion::convertScalar;
+};
+
+/** the kernels only differ in the order of the samples,
+    not in the arithmetic. Allow for a contracted multiply-add. */
+static bool same(float a, float b)
+{
+    return std::abs(a - b) <= 1e-6f * std::max(std::abs(a), std::abs(b));
+}
+
+static void compare(const TestConversion &conversion, const std::vector<AdcPair> &pairs,
+    size_t first, size_t count)
+{
+    std::vector<float> voltage(count);
+    std::vector<float> current(count);
+    std::vector<float> scalarVoltage(count);
+    std::vector<float> scalarCurrent(count);
+
+    conversion.convert(pairs.data() + first, count, voltage.data(), current.data());
+    conversion.convertScalar(pairs.data() + first, count, scalarVoltage.data(), scalarCurrent.data());
+
+    size_t mismatches = 0;
+    for(size_t i=0; i<count; i++)
+    {
+        if (!same(voltage[i], scalarVoltage[i]) || !same(current[i], scalarCurrent[i]))
+        {
+            mismatches++;
+        }
+    }
+
+    if (mismatches != 0)
+    {
+        std::cerr << mismatches << " of " << count << " samples differ at offset " << first << "\n";
+    }
+    CHECK(mismatches == 0);
+}
+
+int main()
+{
+    SweepSetup setup{};
+    setup.m_collectorResistor = 0.1f;
+    setup.m_baseSenseResistor = 3.3f;
+    setup.m_adcGain[0]   = 1.013f;
+    setup.m_adcGain[1]   = 0.987f;
+    setup.m_adcOffset[0] = -37.5f;
+    setup.m_adcOffset[1] = 12.25f;
+    const TestConversion conversion(setup);
+
+    // the full range of the 18-bit ADC and a little below zero
+    std::vector<AdcPair> pairs(4096 + 64);
+    for(auto &pair : pairs)
+    {
+        pair.m_v1 = static_cast<int32_t>(random(1 << 18)) - 16;
+        pair.m_v2 = static_cast<int32_t>(random(1 << 18)) - 16;
+    }
+
+    for(size_t count=0; count<=40; count++)
+    {
+        compare(conversion, pairs, 0, count);
+        compare(conversion, pairs, 3, count);
+    }
+
+    for(size_t tail=0; tail<8; tail++)
+    {
+        compare(conversion, pairs, 1, 4096 + tail);
+    }
+
+    return checkFailures();
+}
@@ -0,0 +1,119 @@
+#include <array>
+#include <chrono>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include "lineframer.h"
+#include "binaryframer.h"
+
+/** decoding throughput of the ASCII and the binary framer in bytes
+    and responses per second. The stream is written in 64 byte pieces,
+    the size of a full-speed USB packet. Both streams hold the same
+    values, so the checksums must agree. */
+
+static constexpr size_t c_responses = 2000000;
+static constexpr size_t c_chunkSize = 64;
+
+static uint32_t g_seed = 1;
+
+static int32_t randomValue()
+{
+    g_seed = g_seed * 1103515245u + 12345u;
+    return static_cast<int32_t>((g_seed >> 8) & 0x3FFFF);
+}
+
+static void report(const char *name, const std::string &stream, size_t responses, double seconds)
+{
+    std::printf("%-8s %8.1f MB/s %8.2f M responses/s  (%zu of %zu decoded)\n", name,
+        stream.size() / seconds * 1e-6, responses / seconds * 1e-6, responses, c_responses);
+}
+
+static void benchAscii()
+{
+    g_seed = 1;
+    std::string stream;
+    for(size_t i=0; i<c_responses; i++)
+    {
+        stream += std::to_string(randomValue()) + "\t" + std::to_string(randomValue()) + "\r\n";
+    }
+
+    LineFramer framer;
+    size_t responses = 0;
+    int64_t checksum = 0;
+    const auto start = std::chrono::steady_clock::now();
+
+    size_t offset = 0;
+    while(offset < stream.size())
+    {
+        const size_t chunk = std::min(c_chunkSize, stream.size() - offset);
+        offset += framer.write(stream.data() + offset, chunk);
+
+        const char *line;
+        size_t len;
+        while(framer.readLine(line, len))
+        {
+            int32_t v1, v2;
+            if (LineFramer::parseValues(line, len, v1, v2))
+            {
+                responses++;
+                checksum += v1 + v2;
+            }
+        }
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    report("ASCII", stream, responses, elapsed.count());
+    std::printf("         checksum %lld\n", static_cast<long long>(checksum));
+}
+
+static void benchBinary()
+{
+    g_seed = 1;
+    std::string stream;
+    for(size_t i=0; i<c_responses; i++)
+    {
+        const int32_t v1 = randomValue();
+        const int32_t v2 = randomValue();
+        uint8_t record[BinaryFramer::c_responseSize] = {BinaryFramer::c_responseSync,
+            static_cast<uint8_t>(v1), static_cast<uint8_t>(v1 >> 8), static_cast<uint8_t>(v1 >> 16),
+            static_cast<uint8_t>(v2), static_cast<uint8_t>(v2 >> 8), static_cast<uint8_t>(v2 >> 16), 0};
+
+        uint8_t sum = 0;
+        for(size_t j=0; j<BinaryFramer::c_responseSize-1; j++)
+        {
+            sum += record[j];
+        }
+        record[BinaryFramer::c_responseSize-1] = static_cast<uint8_t>(-sum);
+        stream.append(reinterpret_cast<const char*>(record), sizeof(record));
+    }
+
+    BinaryFramer framer;
+    size_t responses = 0;
+    int64_t checksum = 0;
+    const auto start = std::chrono::steady_clock::now();
+
+    size_t offset = 0;
+    while(offset < stream.size())
+    {
+        const size_t chunk = std::min(c_chunkSize, stream.size() - offset);
+        offset += framer.write(stream.data() + offset, chunk);
+
+        int32_t v1, v2;
+        while(framer.readFrame(v1, v2))
+        {
+            responses++;
+            checksum += v1 + v2;
+        }
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    report("binary", stream, responses, elapsed.count());
+    std::printf("         checksum %lld\n", static_cast<long long>(checksum));
+}
+
+int main()
+{
+    benchAscii();
+    benchBinary();
+    return 0;
+}
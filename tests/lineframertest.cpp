@@ -0,0 +1,167 @@
+#include <array>
+#include <limits>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include "check.h"
+#include "lineframer.h"
+
+static uint32_t g_seed = 1;
+
+static uint32_t random(uint32_t range)
+{
+    g_seed = g_seed * 1103515245u + 12345u;
+    return (g_seed >> 8) % range;
+}
+
+static bool parse(const char *line, int32_t &v1, int32_t &v2)
+{
+    return LineFramer::parseValues(line, std::strlen(line), v1, v2);
+}
+
+static void testParseValues()
+{
+    int32_t v1 = 0;
+    int32_t v2 = 0;
+
+    CHECK(parse("123\t456", v1, v2));
+    CHECK((v1 == 123) && (v2 == 456));
+
+    CHECK(parse("  0 \t 16777215 ", v1, v2));
+    CHECK((v1 == 0) && (v2 == 16777215));
+
+    CHECK(parse("2147483647\t2147483647", v1, v2));
+    CHECK((v1 == std::numeric_limits<int32_t>::max()) && (v2 == v1));
+
+    CHECK(!parse("123", v1, v2));
+    CHECK(!parse("", v1, v2));
+    CHECK(!parse("2147483648\t1", v1, v2));
+    CHECK(!parse("1\t99999999999999999999", v1, v2));
+}
+
+/** response lines split at random places are all read back */
+static void testSplitLines()
+{
+    std::string stream;
+    std::vector<std::array<int32_t, 2>> expected;
+    for(int i=0; i<10000; i++)
+    {
+        const std::array<int32_t, 2> values = {static_cast<int32_t>(random(1 << 24)), static_cast<int32_t>(random(1 << 24))};
+        expected.push_back(values);
+        stream += std::to_string(values[0]) + "\t" + std::to_string(values[1]) + ((i & 1) ? "\r\n" : "\n");
+    }
+
+    LineFramer framer;
+    std::vector<std::array<int32_t, 2>> parsed;
+    size_t offset = 0;
+    while(offset < stream.size())
+    {
+        const size_t chunk = std::min<size_t>(1 + random(100), stream.size() - offset);
+        offset += framer.write(stream.data() + offset, chunk);
+
+        const char *line;
+        size_t len;
+        while(framer.readLine(line, len))
+        {
+            std::array<int32_t, 2> values;
+            CHECK(LineFramer::parseValues(line, len, values[0], values[1]));
+            parsed.push_back(values);
+        }
+    }
+
+    CHECK(parsed == expected);
+    CHECK(framer.overflows() == 0);
+}
+
+/** random bytes never produce lines longer than the framer allows,
+    values out of range or a line that ends the framer's progress */
+static void testFuzz()
+{
+    LineFramer framer;
+    const char alphabet[] = "0123456789\t \r\n";
+
+    size_t lines = 0;
+    for(int round=0; round<2000; round++)
+    {
+        std::string data;
+        const size_t size = 1 + random(2000);
+        for(size_t i=0; i<size; i++)
+        {
+            // mostly characters of the protocol, so lines do form
+            data += (random(4) == 0) ? static_cast<char>(random(256)) : alphabet[random(sizeof(alphabet)-1)];
+        }
+
+        // a run of digits that overflows any integer
+        if ((round % 10) == 0)
+        {
+            data += std::string(40, '9') + "\t1\n";
+        }
+
+        size_t offset = 0;
+        while(offset < data.size())
+        {
+            offset += framer.write(data.data() + offset, data.size() - offset);
+
+            const char *line;
+            size_t len;
+            while(framer.readLine(line, len))
+            {
+                lines++;
+                CHECK(len <= 128);
+                CHECK(std::strlen(line) == len);
+
+                int32_t v1 = -1;
+                int32_t v2 = -1;
+                if (LineFramer::parseValues(line, len, v1, v2))
+                {
+                    CHECK((v1 >= 0) && (v2 >= 0));
+                }
+            }
+        }
+    }
+
+    CHECK(lines > 0);
+}
+
+/** a line that lost data still ends as a single line, which doesn't
+    parse, so it can be matched with the command it answers */
+static void testDiscardedLines()
+{
+    LineFramer framer;
+    const char *line;
+    size_t len;
+    int32_t v1 = 0;
+    int32_t v2 = 0;
+
+    // too long to be a response
+    const std::string overlong = std::string(100, '1') + "\t" + std::string(100, '2') + "\n1\t2\n";
+    CHECK(framer.write(overlong.data(), overlong.size()) == overlong.size());
+    CHECK(framer.readLine(line, len) && !LineFramer::parseValues(line, len, v1, v2));
+    CHECK(framer.readLine(line, len) && LineFramer::parseValues(line, len, v1, v2));
+    CHECK((v1 == 1) && (v2 == 2));
+    CHECK(!framer.readLine(line, len));
+
+    // fills the ring, the start of the line is thrown away
+    const std::string overflow = std::string(5000, ' ') + "3\t4\n5\t6\n";
+    CHECK(framer.write(overflow.data(), overflow.size()) == overflow.size());
+    CHECK(framer.overflows() == 1);
+    CHECK(framer.readLine(line, len) && !LineFramer::parseValues(line, len, v1, v2));
+    CHECK(framer.readLine(line, len) && LineFramer::parseValues(line, len, v1, v2));
+    CHECK((v1 == 5) && (v2 == 6));
+    CHECK(!framer.readLine(line, len));
+}
+
+int main()
+{
+    testParseValues();
+    testSplitLines();
+    testFuzz();
+    testDiscardedLines();
+
+    if (checkFailures() == 0)
+    {
+        std::cout << "lineframertest passed\n";
+    }
+    return checkFailures();
+}
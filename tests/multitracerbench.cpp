@@ -0,0 +1,97 @@
+#include <memory>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTimer>
+#include "ptytracer.h"
+#include "sweepplan.h"
+#include "headlessrunner.h"
+
+/** aggregate samples per second of the headless mode with 1, 2 and 4
+    simulated tracers. Every tracer gets the same number of transistor
+    sweeps, so the run time stays the same if the throughput scales
+    with the number of tracers. The tracers have the ASCII-only
+    firmware behind a 1ms USB-serial latency at 115200 baud. The
+    bench fails if a tracer gets less than c_minScaling of the
+    throughput it gets on its own. */
+
+static constexpr uint32_t c_jobsPerTracer = 3;
+static constexpr uint32_t c_tracesPerJob  = 4;
+static constexpr double   c_minScaling    = 0.7;
+
+static const char *c_out = "multitracerbench.ptra";
+
+/** returns the number of samples per second, or 0 on error */
+static double run(size_t numberOfTracers)
+{
+    std::vector<std::unique_ptr<PtyTracer>> tracers;
+    HeadlessRunner::Options options{};
+    for(size_t i=0; i<numberOfTracers; i++)
+    {
+        tracers.push_back(std::make_unique<PtyTracer>(TracerModel::defaultTransistor(),
+            TracerModel::Firmware{false, false}));
+        if (!tracers.back()->start())
+        {
+            return 0;
+        }
+        options.m_ports.push_back(tracers.back()->portName());
+    }
+
+    options.m_out   = c_out;
+    options.m_jobs  = c_jobsPerTracer * static_cast<uint32_t>(numberOfTracers);
+    options.m_sweep = HeadlessRunner::SweepType::Transistor;
+    options.m_setup = SweepPlan::defaultSetup();
+    options.m_setup.m_numberOfTraces = c_tracesPerJob;
+    options.m_timeoutMs = 5000;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    HeadlessRunner runner(options);
+    QTimer::singleShot(0, &runner, &HeadlessRunner::start);
+    const int status = QCoreApplication::exec();
+
+    const double seconds = timer.nsecsElapsed() * 1e-9;
+
+    uint64_t samples = 0;
+    for(auto &tracer : tracers)
+    {
+        samples += tracer->model().totalCommands();
+        tracer->stop();
+    }
+
+    for(uint32_t job=0; job<options.m_jobs; job++)
+    {
+        std::remove(HeadlessRunner::archiveName(c_out, job, options.m_jobs).c_str());
+    }
+
+    return (status == HeadlessRunner::c_exitOk) ? (samples / seconds) : 0;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    std::vector<double> rates;
+    for(size_t numberOfTracers : {1, 2, 4})
+    {
+        rates.push_back(run(numberOfTracers));
+    }
+
+    std::printf("tracers  samples/s  per tracer  scaling  (%u jobs of %u traces per tracer)\n",
+        c_jobsPerTracer, c_tracesPerJob);
+
+    bool ok = true;
+    size_t numberOfTracers = 1;
+    for(double rate : rates)
+    {
+        const double scaling = (rates.front() > 0) ? rate / (numberOfTracers * rates.front()) : 0;
+        std::printf("%7zu  %9.0f  %10.0f  %7.2f\n", numberOfTracers, rate, rate / numberOfTracers, scaling);
+        ok = ok && (rate > 0) && (scaling >= c_minScaling);
+        numberOfTracers *= 2;
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,128 @@
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include <QGuiApplication>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QPainter>
+#include "graph.h"
+#include "tracecolors.h"
+#include "tracelod.h"
+
+/** time to draw a frame of traces with c_points points each, for a
+    range of trace counts. "segments" draws a line per pair of points
+    like the plot did before, "polyline" is PlotRect::plotData with
+    per-pixel decimation and "lod" uses the level-of-detail pyramid. */
+
+static constexpr size_t c_points = 10000;
+static constexpr int    c_frames = 10;
+
+struct Trace
+{
+    std::vector<float> m_x;
+    std::vector<float> m_y;
+    TraceLod           m_lod;
+};
+
+/** a collector sweep with a bit of noise, in V and mA */
+static Trace makeTrace(size_t index)
+{
+    Trace trace;
+    uint32_t seed = static_cast<uint32_t>(index) + 1;
+    for(size_t i=0; i<c_points; i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        const float noise = static_cast<float>((seed >> 16) & 0xFF) / 255.0f - 0.5f;
+        const float v = 5.0f * static_cast<float>(i) / c_points;
+        trace.m_x.push_back(v);
+        trace.m_y.push_back((index + 1) * 0.2f * (1.0f - std::exp(-v / 0.08f)) * (1.0f + v / 80.0f) + 0.002f * noise);
+    }
+    trace.m_lod.update(trace.m_x.data(), trace.m_y.data(), c_points);
+    return trace;
+}
+
+static void drawSegments(QPainter &painter, const PlotRect &plot, const Trace &trace, const QColor &color)
+{
+    painter.setRenderHints(QPainter::Antialiasing);
+    painter.setPen(QPen(color, 3.0f));
+
+    auto lineStart = plot.graphToScreen(QPointF{trace.m_x[0], trace.m_y[0]});
+    for(size_t i=1; i<trace.m_x.size(); i++)
+    {
+        const auto lineEnd = plot.graphToScreen(QPointF{trace.m_x[i], trace.m_y[i]});
+        painter.drawLine(lineStart, lineEnd);
+        lineStart = lineEnd;
+    }
+}
+
+enum class Method
+{
+    Segments,
+    Polyline,
+    Lod
+};
+
+/** returns the mean frame time in ms */
+static double frameTime(QImage &image, PlotRect &plot, const std::vector<Trace> &traces, size_t count, Method method)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    for(int frame=0; frame<c_frames; frame++)
+    {
+        QPainter painter(&image);
+        plot.clearRect(painter);
+        for(size_t i=0; i<count; i++)
+        {
+            const auto &trace = traces[i];
+            const auto &color = gs_traceColors.at(i % gs_traceColors.size());
+            switch(method)
+            {
+            case Method::Segments:
+                drawSegments(painter, plot, trace, color);
+                break;
+            case Method::Polyline:
+                plot.plotData(painter, trace.m_x.data(), trace.m_y.data(), c_points, color);
+                break;
+            case Method::Lod:
+                plot.plotData(painter, trace.m_x.data(), trace.m_y.data(), c_points, trace.m_lod, color);
+                break;
+            }
+        }
+    }
+
+    return timer.nsecsElapsed() * 1e-6 / c_frames;
+}
+
+int main(int argc, char *argv[])
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+    {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QGuiApplication app(argc, argv);
+
+    const size_t traceCounts[] = {1, 4, 16, 64};
+
+    std::vector<Trace> traces;
+    for(size_t i=0; i<traceCounts[3]; i++)
+    {
+        traces.push_back(makeTrace(i));
+    }
+
+    QImage image(1280, 800, QImage::Format_ARGB32_Premultiplied);
+    PlotRect plot;
+    plot.setPlotRect(QRect{40, 10, 1200, 750});
+    plot.setDataRect(QRectF{0.0, 0.0, 5.5, traceCounts[3] * 0.22});
+
+    std::printf("traces  segments ms  polyline ms  lod ms  (%zu points per trace, 1280x800)\n", c_points);
+    for(size_t count : traceCounts)
+    {
+        const double segments = frameTime(image, plot, traces, count, Method::Segments);
+        const double polyline = frameTime(image, plot, traces, count, Method::Polyline);
+        const double lod      = frameTime(image, plot, traces, count, Method::Lod);
+        std::printf("%6zu  %11.2f  %11.2f  %6.2f\n", count, segments, polyline, lod);
+    }
+
+    return 0;
+}
@@ -0,0 +1,122 @@
+#include <cmath>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include <limits>
+#include "pointindex.h"
+
+/** nearest-point lookup of the cursor on a trace of a million points:
+    PointIndex against a linear scan of all points, as the cursor did
+    before. The index is built the way the graph does, while the trace
+    comes in. Both must find points at the same distance. */
+
+static constexpr size_t c_points    = 1000000;
+static constexpr size_t c_blockSize = 100;
+static constexpr size_t c_queries   = 100000;
+static constexpr size_t c_scans     = 200;
+
+static uint32_t g_seed = 1;
+
+static float random01()
+{
+    g_seed = g_seed * 1103515245u + 12345u;
+    return static_cast<float>(g_seed >> 8) / 16777216.0f;
+}
+
+static bool linearNearest(const std::vector<float> &x, const std::vector<float> &y, const QPointF &p,
+    double xscale, double yscale, uint32_t &index, double &distance2)
+{
+    bool found = false;
+    for(size_t i=0; i<x.size(); i++)
+    {
+        const double dx = (x[i] - p.x()) * xscale;
+        const double dy = (y[i] - p.y()) * yscale;
+        const double d2 = dx*dx + dy*dy;
+        if (d2 < distance2)
+        {
+            distance2 = d2;
+            index = static_cast<uint32_t>(i);
+            found = true;
+        }
+    }
+    return found;
+}
+
+using Clock = std::chrono::steady_clock;
+
+static double seconds(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main()
+{
+    // a collector sweep in V and mA with noise, on a 1200x750 pixel plot
+    std::vector<float> x;
+    std::vector<float> y;
+    for(size_t i=0; i<c_points; i++)
+    {
+        const float v = 5.0f * static_cast<float>(i) / c_points;
+        x.push_back(v);
+        y.push_back(2.0f * (1.0f - std::exp(-v / 0.08f)) + 0.01f * (random01() - 0.5f));
+    }
+    const double xscale = 1200.0 / 5.5;
+    const double yscale = 750.0 / 2.2;
+
+    auto start = Clock::now();
+    PointIndex index;
+    for(size_t count=c_blockSize; count<=c_points; count+=c_blockSize)
+    {
+        index.update(x.data(), y.data(), count);
+    }
+    const double buildTime = seconds(start);
+
+    // half of the queries near the curve, where the cursor usually is
+    std::vector<QPointF> queries;
+    for(size_t i=0; i<c_queries; i++)
+    {
+        const float v = 5.5f * random01();
+        const float near = 2.0f * (1.0f - std::exp(-v / 0.08f)) + 0.1f * (random01() - 0.5f);
+        queries.emplace_back(v, ((i & 1) == 0) ? near : 2.2f * random01());
+    }
+
+    // the cursor snaps within 20 pixels
+    const double maxDistance2 = 20.0 * 20.0;
+
+    start = Clock::now();
+    size_t found = 0;
+    for(const auto &query : queries)
+    {
+        uint32_t nearest = 0;
+        double distance2 = maxDistance2;
+        found += index.nearest(query, xscale, yscale, nearest, distance2) ? 1 : 0;
+    }
+    const double indexTime = seconds(start);
+
+    start = Clock::now();
+    size_t mismatches = 0;
+    for(size_t i=0; i<c_scans; i++)
+    {
+        uint32_t linearIndex = 0;
+        double linearDistance2 = maxDistance2;
+        const bool linearFound = linearNearest(x, y, queries[i], xscale, yscale, linearIndex, linearDistance2);
+
+        uint32_t indexIndex = 0;
+        double indexDistance2 = maxDistance2;
+        const bool indexFound = index.nearest(queries[i], xscale, yscale, indexIndex, indexDistance2);
+
+        if ((linearFound != indexFound) || (linearDistance2 != indexDistance2))
+        {
+            mismatches++;
+        }
+    }
+    const double scanTime = seconds(start);
+
+    std::printf("%zu points, built in blocks of %zu in %.1f ms\n", c_points, c_blockSize, buildTime * 1e3);
+    std::printf("PointIndex   %10.2f us per lookup  (%zu of %zu found a point)\n",
+        indexTime * 1e6 / c_queries, found, c_queries);
+    std::printf("linear scan  %10.2f us per lookup\n", scanTime * 1e6 / c_scans);
+    std::printf("%zu of %zu lookups disagree\n", mismatches, c_scans);
+
+    return (mismatches == 0) ? 0 : 1;
+}
@@ -0,0 +1,171 @@
+#include <chrono>
+#include <string>
+#include <cstdio>
+#include <iostream>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include "ptytracer.h"
+#include "lineframer.h"
+#include "binaryframer.h"
+
+/** collector samples per second of the ASCII and the binary protocol
+    over a simulated 115200 baud link, with the host keeping a window
+    of commands in flight like SerialCtrl does. */
+
+static constexpr int c_samples = 2000;
+static constexpr int c_window  = 4;
+
+static int openPort(const std::string &name)
+{
+    const int fd = open(name.c_str(), O_RDWR | O_NOCTTY);
+    if (fd >= 0)
+    {
+        termios tio;
+        tcgetattr(fd, &tio);
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    return fd;
+}
+
+static bool readSome(int fd, char *buffer, size_t size, ssize_t &len)
+{
+    pollfd pfd{fd, POLLIN, 0};
+    if (poll(&pfd, 1, 1000) <= 0)
+    {
+        return false;
+    }
+    len = read(fd, buffer, size);
+    return len > 0;
+}
+
+static void writeAll(int fd, const char *data, size_t len)
+{
+    while(len > 0)
+    {
+        const auto written = write(fd, data, len);
+        if (written <= 0)
+        {
+            return;
+        }
+        data += written;
+        len  -= static_cast<size_t>(written);
+    }
+}
+
+static void sendCommand(int fd, bool binary, uint16_t pwm)
+{
+    if (binary)
+    {
+        const auto record = BinaryFramer::encodeCommand('C', pwm);
+        writeAll(fd, reinterpret_cast<const char*>(record.data()), record.size());
+    }
+    else
+    {
+        const auto command = std::to_string(pwm) + "C \n";
+        writeAll(fd, command.data(), command.size());
+    }
+}
+
+/** returns the number of samples per second, or 0 on error */
+static double run(bool binary)
+{
+    PtyTracer tracer(TracerModel::defaultTransistor(), TracerModel::Firmware{true, false});
+    if (!tracer.start())
+    {
+        return 0;
+    }
+
+    const int fd = openPort(tracer.portName());
+    if (fd < 0)
+    {
+        return 0;
+    }
+
+    LineFramer lineFramer;
+    BinaryFramer binaryFramer;
+    char buffer[4096];
+    ssize_t len;
+
+    if (binary)
+    {
+        writeAll(fd, "1P \n", 4);
+        int32_t v1 = 0;
+        int32_t v2 = 0;
+        while(!binaryFramer.readFrame(v1, v2))
+        {
+            if (!readSome(fd, buffer, sizeof(buffer), len))
+            {
+                close(fd);
+                return 0;
+            }
+            binaryFramer.write(buffer, static_cast<size_t>(len));
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    int sent = 0;
+    int received = 0;
+    while(received < c_samples)
+    {
+        while((sent < c_samples) && (sent - received < c_window))
+        {
+            sendCommand(fd, binary, static_cast<uint16_t>(sent % 1024));
+            sent++;
+        }
+
+        if (!readSome(fd, buffer, sizeof(buffer), len))
+        {
+            break;
+        }
+
+        int32_t v1;
+        int32_t v2;
+        if (binary)
+        {
+            binaryFramer.write(buffer, static_cast<size_t>(len));
+            while(binaryFramer.readFrame(v1, v2))
+            {
+                received++;
+            }
+        }
+        else
+        {
+            lineFramer.write(buffer, static_cast<size_t>(len));
+            const char *line;
+            size_t lineLen;
+            while(lineFramer.readLine(line, lineLen))
+            {
+                if (LineFramer::parseValues(line, lineLen, v1, v2))
+                {
+                    received++;
+                }
+            }
+        }
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    close(fd);
+
+    if (received < c_samples)
+    {
+        return 0;
+    }
+
+    return received / elapsed.count();
+}
+
+int main()
+{
+    const double ascii  = run(false);
+    const double binary = run(true);
+
+    std::printf("protocol  samples/s  (%d samples, window %d, 115200 baud, 1ms latency)\n", c_samples, c_window);
+    std::printf("ASCII     %9.0f\n", ascii);
+    std::printf("binary    %9.0f\n", binary);
+
+    return ((ascii > 0) && (binary > 0)) ? 0 : 1;
+}
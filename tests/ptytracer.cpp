@@ -0,0 +1,152 @@
+#include <chrono>
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#ifdef __APPLE__
+#include <util.h>
+#else
+#include <pty.h>
+#endif
+#include "ptytracer.h"
+
+PtyTracer::Link PtyTracer::defaultLink()
+{
+    Link link;
+    link.m_latencyUs    = 1000;
+    link.m_sampleTimeUs = 100;
+    link.m_baudRate     = 115200;
+    return link;
+}
+
+PtyTracer::PtyTracer(const TracerModel::Device &device, const TracerModel::Firmware &firmware,
+    const Link &link)
+    : m_model(device, firmware), m_link(link), m_master(-1), m_slave(-1), m_running(false)
+{
+}
+
+PtyTracer::~PtyTracer()
+{
+    stop();
+}
+
+bool PtyTracer::start()
+{
+    char name[256];
+    if (openpty(&m_master, &m_slave, name, nullptr, nullptr) != 0)
+    {
+        return false;
+    }
+
+    termios tio;
+    tcgetattr(m_slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(m_slave, TCSANOW, &tio);
+
+    fcntl(m_master, F_SETFL, fcntl(m_master, F_GETFL) | O_NONBLOCK);
+
+    m_portName = name;
+    m_running  = true;
+    m_thread   = std::thread(&PtyTracer::run, this);
+    return true;
+}
+
+void PtyTracer::stop()
+{
+    m_running = false;
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+
+    if (m_master >= 0)
+    {
+        close(m_master);
+        close(m_slave);
+        m_master = -1;
+        m_slave  = -1;
+    }
+}
+
+void PtyTracer::run()
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Pending
+    {
+        Clock::time_point m_due;
+        std::string       m_data;
+    };
+
+    std::deque<Pending> pending;
+    std::vector<std::string> responses;
+    std::string output;                 // due data the host hasn't taken yet
+
+    auto deviceFree = Clock::now();     // the ADC has finished the previous measurement
+    auto linkFree   = Clock::now();     // the UART has sent the previous response
+
+    while(m_running)
+    {
+        auto now = Clock::now();
+
+        // move the responses that arrived at the host into the pty
+        while(!pending.empty() && (pending.front().m_due <= now))
+        {
+            output += pending.front().m_data;
+            pending.pop_front();
+        }
+
+        if (!output.empty())
+        {
+            const auto written = write(m_master, output.data(), output.size());
+            if (written > 0)
+            {
+                output.erase(0, static_cast<size_t>(written));
+            }
+        }
+
+        int timeoutMs = 5;
+        if (!pending.empty())
+        {
+            const auto wait = std::chrono::duration_cast<std::chrono::microseconds>(pending.front().m_due - now);
+            timeoutMs = std::clamp(static_cast<int>((wait.count() + 999) / 1000), 0, timeoutMs);
+        }
+
+        if (!output.empty())
+        {
+            timeoutMs = std::min(timeoutMs, 1);
+        }
+
+        pollfd fd{m_master, POLLIN, 0};
+        if (poll(&fd, 1, timeoutMs) <= 0)
+        {
+            continue;
+        }
+
+        char buffer[4096];
+        const auto len = read(m_master, buffer, sizeof(buffer));
+        if (len <= 0)
+        {
+            continue;
+        }
+
+        now = Clock::now();
+        responses.clear();
+        m_model.receive(buffer, static_cast<size_t>(len), responses);
+
+        for(const auto &response : responses)
+        {
+            deviceFree = std::max(deviceFree, now) + std::chrono::microseconds(m_link.m_sampleTimeUs);
+            linkFree   = std::max(linkFree, deviceFree);
+            if (m_link.m_baudRate != 0)
+            {
+                linkFree += std::chrono::microseconds(response.size() * 10000000ull / m_link.m_baudRate);
+            }
+
+            pending.push_back({linkFree + std::chrono::microseconds(m_link.m_latencyUs), response});
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include <thread>
+#include <atomic>
+#include "tracermodel.h"
+
+/** a simulated tracer behind a pseudo terminal.
+
+    The host opens portName() like the serial port of a real tracer.
+    A thread feeds the bytes it writes to a TracerModel and sends the
+    responses back with the timing of the hardware: the ADC takes
+    m_sampleTimeUs per measurement, the UART sends 10 bits per byte
+    at m_baudRate and the USB-serial converter adds m_latencyUs to
+    every response. Commands are answered in order, like the firmware
+    does. UNIX only.
+*/
+class PtyTracer
+{
+public:
+    struct Link
+    {
+        uint32_t m_latencyUs;       // USB-serial converter latency
+        uint32_t m_sampleTimeUs;    // time per ADC measurement
+        uint32_t m_baudRate;        // 0 = unlimited
+    };
+
+    /** 1ms USB latency and 115200 baud, like the FTDI converter of the board */
+    static Link defaultLink();
+
+    PtyTracer(const TracerModel::Device &device, const TracerModel::Firmware &firmware,
+        const Link &link = defaultLink());
+
+    virtual ~PtyTracer();
+
+    /** create the pseudo terminal and start answering, returns false on error */
+    bool start();
+    void stop();
+
+    /** name of the port to open on the host side */
+    std::string portName() const
+    {
+        return m_portName;
+    }
+
+    /** the model is owned by the simulator thread, only
+        the thread safe methods may be called while it runs. */
+    TracerModel& model() noexcept
+    {
+        return m_model;
+    }
+
+protected:
+    void run();
+
+    TracerModel m_model;
+    Link        m_link;
+
+    int m_master;
+    int m_slave;            // kept open so the pty survives the host closing it
+    std::string m_portName;
+
+    std::thread m_thread;
+    std::atomic<bool> m_running;
+};
@@ -0,0 +1,116 @@
+#include <cstdio>
+#include <vector>
+#include <algorithm>
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QImage>
+#include "graph.h"
+
+/** frame time of the graph while a 10000 point trace comes in, in
+    blocks of 100 points. "incremental" draws the new segments into
+    the trace layer, "full" redraws the layer every frame as the
+    graph did before. A complete trace is on the plot already. */
+
+static constexpr size_t c_points    = 10000;
+static constexpr size_t c_blockSize = 100;
+
+/** gives access to the layer cache */
+class BenchGraph : public Graph
+{
+public:
+    void invalidateTraces()
+    {
+        invalidateLayers(false);
+    }
+};
+
+/** raw samples of a collector sweep that saturates at maxCurrent amps,
+    with the setup below */
+static std::vector<AdcPair> makeSweep(float maxCurrent)
+{
+    const float countsPerVolt = 262144.0f / 5.0f;
+
+    std::vector<AdcPair> pairs;
+    for(size_t i=0; i<c_points; i++)
+    {
+        const float supply = 5.0f * static_cast<float>(i) / c_points;
+        const float current = std::min(maxCurrent, supply / 1e3f);
+        const float device = supply - current * 1e3f;
+        pairs.push_back(AdcPair{static_cast<int32_t>(supply * countsPerVolt), static_cast<int32_t>(device * countsPerVolt)});
+    }
+    return pairs;
+}
+
+struct FrameTimes
+{
+    double m_mean;  // in ms
+    double m_max;
+};
+
+static FrameTimes streamTrace(BenchGraph &graph, QImage &image, const std::vector<AdcPair> &pairs, bool full)
+{
+    graph.newTrace();
+
+    double total = 0;
+    double longest = 0;
+    size_t frames = 0;
+
+    QElapsedTimer timer;
+    for(size_t offset=0; offset<pairs.size(); offset+=c_blockSize)
+    {
+        graph.addSamples(pairs.data() + offset, std::min(c_blockSize, pairs.size() - offset));
+        if (full)
+        {
+            graph.invalidateTraces();
+        }
+
+        timer.start();
+        graph.render(&image);
+        const double ms = timer.nsecsElapsed() * 1e-6;
+
+        total  += ms;
+        longest = std::max(longest, ms);
+        frames++;
+    }
+
+    return {total / frames, longest};
+}
+
+int main(int argc, char *argv[])
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+    {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication app(argc, argv);
+
+    SweepSetup setup{};
+    setup.m_baseLimitResistor = 100.0f;
+    setup.m_baseSenseResistor = 3.3f;
+    setup.m_collectorResistor = 1.0f;
+    setup.m_adcGain[0] = 1.0f;
+    setup.m_adcGain[1] = 1.0f;
+
+    BenchGraph graph;
+    graph.resize(1280, 800);
+    graph.setSweepSetup(setup);
+
+    QImage image(1280, 800, QImage::Format_ARGB32_Premultiplied);
+
+    // the complete trace sets the extents, the others stay inside
+    const auto reference = makeSweep(4e-3f);
+    graph.newTrace();
+    graph.addSamples(reference.data(), reference.size());
+    graph.render(&image);
+
+    const auto sweep = makeSweep(2e-3f);
+    const auto full        = streamTrace(graph, image, sweep, true);
+    const auto incremental = streamTrace(graph, image, sweep, false);
+
+    std::printf("frame time in ms, %zu points in blocks of %zu, 1280x800\n", c_points, c_blockSize);
+    std::printf("              mean     max\n");
+    std::printf("incremental %6.2f  %6.2f\n", incremental.m_mean, incremental.m_max);
+    std::printf("full        %6.2f  %6.2f\n", full.m_mean, full.m_max);
+
+    return 0;
+}
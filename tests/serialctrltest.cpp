@@ -0,0 +1,373 @@
+#include <memory>
+#include <algorithm>
+#include <vector>
+#include <QCoreApplication>
+#include <QThread>
+#include <QElapsedTimer>
+#include "check.h"
+#include "ptytracer.h"
+#include "serialctrl.h"
+
+/** SerialCtrl against simulated tracers with and without
+    the binary protocol and the device-side sweep. */
+
+/** the samples up to and including the next EndSweep */
+static std::vector<AdcSample> readSweep(SerialCtrl *serial, int timeoutMs = 5000)
+{
+    std::vector<AdcSample> samples;
+    QElapsedTimer timer;
+    timer.start();
+
+    while(timer.elapsed() < timeoutMs)
+    {
+        AdcSample sample;
+        if (!serial->samples().pop(sample))
+        {
+            QThread::msleep(1);
+            continue;
+        }
+
+        samples.push_back(sample);
+        if (sample.m_type == DataEvent::DataType::EndSweep)
+        {
+            break;
+        }
+    }
+    return samples;
+}
+
+/** sweep the collector of a transistor and return the samples */
+static std::vector<AdcSample> sweep(const TracerModel::Firmware &firmware,
+    SerialCtrl::Protocol expectedProtocol, uint64_t expectedSweeps, uint64_t expectedCollector)
+{
+    PtyTracer tracer(TracerModel::defaultTransistor(), firmware);
+    CHECK(tracer.start());
+
+    std::unique_ptr<SerialCtrl> serial(SerialCtrl::open(tracer.portName()));
+    CHECK(serial);
+    if (!serial)
+    {
+        return {};
+    }
+
+    CHECK(serial->protocol() == expectedProtocol);
+
+    serial->setBasePWM(300, true);
+    serial->sweepCollector(0, 1000, 10);
+    serial->run();
+
+    const auto samples = readSweep(serial.get());
+    serial->close();
+
+    CHECK(tracer.model().commands('S') == expectedSweeps);
+    CHECK(tracer.model().commands('C') == expectedCollector);
+    return samples;
+}
+
+/** wait until the serial controller is idle, returns false on a timeout */
+static bool waitIdle(SerialCtrl *serial, int timeoutMs = 5000)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while(serial->isBusy())
+    {
+        if (timer.elapsed() > timeoutMs)
+        {
+            return false;
+        }
+        QThread::msleep(1);
+    }
+    return true;
+}
+
+/** a controller is busy while a sweep runs, cancel() ends the sweep
+    and the controller is idle once the tracer has answered */
+static void testCancel()
+{
+    PtyTracer tracer(TracerModel::defaultTransistor(), TracerModel::Firmware{false, false});
+    CHECK(tracer.start());
+
+    std::unique_ptr<SerialCtrl> serial(SerialCtrl::open(tracer.portName()));
+    CHECK(serial);
+    if (!serial)
+    {
+        return;
+    }
+
+    CHECK(waitIdle(serial.get()));
+    const auto collectorCommands = tracer.model().commands('C');
+
+    serial->setBasePWM(300, true);
+    serial->sweepCollector(0, 1000, 1);
+    serial->run();
+    CHECK(serial->isBusy());
+
+    // let part of the sweep through before it is cancelled
+    const auto start = readSweep(serial.get(), 20);
+    CHECK(!start.empty() && (start.back().m_type != DataEvent::DataType::EndSweep));
+
+    serial->cancel();
+    const auto rest = readSweep(serial.get());
+    CHECK(!rest.empty() && (rest.back().m_type == DataEvent::DataType::EndSweep));
+    if (!rest.empty())
+    {
+        CHECK(rest.back().m_v1 == static_cast<int32_t>(SerialCtrl::SweepStop::Cancelled));
+    }
+
+    CHECK(waitIdle(serial.get()));
+    const auto cancelled = tracer.model().commands('C');
+    CHECK(cancelled < collectorCommands + 1001);
+
+    // nothing is sent to an idle tracer
+    CHECK(!serial->isBusy());
+    QThread::msleep(10);
+    CHECK(tracer.model().commands('C') == cancelled);
+
+    serial->close();
+}
+
+/** a base PWM and a collector sweep on the ASCII firmware, every
+    garbageInterval-th response is garbled. */
+static std::vector<AdcSample> garbledSweep(uint32_t garbageInterval, uint32_t &badLines)
+{
+    PtyTracer tracer(TracerModel::defaultTransistor(), TracerModel::Firmware{false, false});
+    tracer.model().setGarbageInterval(garbageInterval);
+    CHECK(tracer.start());
+
+    std::unique_ptr<SerialCtrl> serial(SerialCtrl::open(tracer.portName()));
+    CHECK(serial);
+    if (!serial)
+    {
+        return {};
+    }
+
+    serial->setBasePWM(300);
+    serial->sweepCollector(0, 1000, 10);
+    serial->setCollectorPWM(500);
+    serial->run();
+
+    auto samples = readSweep(serial.get());
+    const auto last = readSweep(serial.get(), 1000);
+    samples.insert(samples.end(), last.begin(), last.end());
+
+    badLines = serial->badLines();
+    serial->close();
+    return samples;
+}
+
+/** a garbled response answers its command, the
+    responses after it stay with their commands */
+static void testGarbledLines()
+{
+    uint32_t badLines = 0;
+    const auto clean = garbledSweep(0, badLines);
+    CHECK(badLines == 0);
+
+    // the sweep points at PWM 20, 60, ... 980 are garbled
+    const auto garbled = garbledSweep(4, badLines);
+    CHECK(badLines == 25);
+    CHECK(garbled.size() + badLines == clean.size());
+
+    // the other samples are reported as without garbling
+    size_t next = 0;
+    for(const auto &sample : clean)
+    {
+        if ((next < garbled.size()) && (garbled[next].m_type == sample.m_type) &&
+            (garbled[next].m_v1 == sample.m_v1) && (garbled[next].m_v2 == sample.m_v2))
+        {
+            next++;
+        }
+    }
+    CHECK(next == garbled.size());
+
+    // the base and the single collector PWM around the sweep
+    CHECK(!garbled.empty() && !clean.empty());
+    if (!garbled.empty() && !clean.empty())
+    {
+        CHECK(garbled.front().m_type == DataEvent::DataType::Base);
+        CHECK((garbled.back().m_type == DataEvent::DataType::Collector) && (garbled.back().m_v1 == clean.back().m_v1));
+    }
+
+    const bool ended = std::any_of(garbled.begin(), garbled.end(), [](const AdcSample &sample)
+        {
+            return (sample.m_type == DataEvent::DataType::EndSweep) &&
+                (sample.m_v1 == static_cast<int32_t>(SerialCtrl::SweepStop::Complete));
+        });
+    CHECK(ended);
+}
+
+/** a collector sweep over every PWM, the consumer stops reading
+    for stallMs once the first samples have arrived. Returns the
+    samples and the number of PWMs the tracer measured meanwhile. */
+static std::vector<AdcSample> stalledSweep(int stallMs, uint64_t &measuredWhileStalled)
+{
+    PtyTracer tracer(TracerModel::defaultTransistor(), TracerModel::Firmware{false, false});
+    CHECK(tracer.start());
+
+    std::unique_ptr<SerialCtrl> serial(SerialCtrl::open(tracer.portName()));
+    CHECK(serial);
+    if (!serial)
+    {
+        return {};
+    }
+
+    serial->setBasePWM(300, true);
+    serial->sweepCollector(0, 1023, 1);
+    serial->run();
+
+    std::vector<AdcSample> samples;
+    AdcSample sample;
+    QElapsedTimer timer;
+    timer.start();
+    while(samples.size() < 10 && (timer.elapsed() < 5000))
+    {
+        if (serial->samples().pop(sample))
+        {
+            samples.push_back(sample);
+        }
+        else
+        {
+            QThread::msleep(1);
+        }
+    }
+
+    // a consumer that blocks, like a slow repaint of the GUI thread
+    const auto before = tracer.model().commands('C');
+    QThread::msleep(stallMs);
+    measuredWhileStalled = tracer.model().commands('C') - before;
+
+    const auto rest = readSweep(serial.get());
+    samples.insert(samples.end(), rest.begin(), rest.end());
+
+    CHECK(serial->droppedSamples() == 0);
+    serial->close();
+    return samples;
+}
+
+/** the I/O thread keeps measuring while the consumer is stalled
+    and every sample arrives, in order */
+static void testStalledConsumer()
+{
+    uint64_t measured = 0;
+    const auto reference = stalledSweep(0, measured);
+    const auto stalled = stalledSweep(300, measured);
+
+    CHECK(reference.size() == 1 + 1024 + 1);
+    CHECK(stalled.size() == reference.size());
+    CHECK(std::equal(stalled.begin(), stalled.end(), reference.begin(), reference.end(),
+        [](const AdcSample &a, const AdcSample &b)
+        {
+            return (a.m_type == b.m_type) && (a.m_v1 == b.m_v1) && (a.m_v2 == b.m_v2);
+        }));
+
+    // about a PWM per 1.5ms on the 115200 baud link
+    std::cout << "measured " << measured << " PWMs in a 300ms consumer stall\n";
+    CHECK(measured >= 100);
+}
+
+/** a sweep with a current limit on the firmware with the device-side
+    sweep ends at the limit, the tracer isn't driven past it. */
+static void testCurrentLimit()
+{
+    PtyTracer tracer(TracerModel::defaultTransistor(), TracerModel::Firmware{true, true});
+    CHECK(tracer.start());
+
+    std::unique_ptr<SerialCtrl> serial(SerialCtrl::open(tracer.portName()));
+    CHECK(serial);
+    if (!serial)
+    {
+        return;
+    }
+
+    serial->setBasePWM(300, true);
+    serial->sweepCollector(0, 1000, 10);
+    serial->run();
+
+    int32_t maxCurrent = 0;
+    for(const auto &sample : readSweep(serial.get()))
+    {
+        if (sample.m_type == DataEvent::DataType::Collector)
+        {
+            maxCurrent = std::max(maxCurrent, sample.m_v1 - sample.m_v2);
+        }
+    }
+    CHECK(maxCurrent > 0);
+
+    SerialCtrl::SweepLimits limits{};
+    limits.m_gain[0]    = 1.0f;
+    limits.m_gain[1]    = 1.0f;
+    limits.m_maxCurrent = 0.25f * static_cast<float>(maxCurrent);
+
+    const auto sweeps    = tracer.model().commands('S');
+    const auto collector = tracer.model().commands('C');
+    serial->sweepCollector(0, 1000, 10, limits);
+    serial->run();
+
+    const auto samples = readSweep(serial.get());
+    CHECK(!samples.empty() && (samples.back().m_type == DataEvent::DataType::EndSweep));
+    if (!samples.empty())
+    {
+        CHECK(samples.back().m_v1 == static_cast<int32_t>(SerialCtrl::SweepStop::Current));
+    }
+
+    // stepped by the host: the points up to the limit, those in flight
+    // when it was reached and the PWM 0 that ends the sweep.
+    CHECK(tracer.model().commands('S') == sweeps);
+    const auto measured = tracer.model().commands('C') - collector;
+    std::cout << "measured " << measured << " of 101 PWMs up to the current limit\n";
+    CHECK((measured > 1) && (measured < 101));
+
+    serial->close();
+    tracer.stop();
+    CHECK(tracer.model().collectorPWM() == 0);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    testCancel();
+    testGarbledLines();
+    testStalledConsumer();
+    testCurrentLimit();
+
+    const auto device = sweep(TracerModel::Firmware{true, true}, SerialCtrl::Protocol::Binary, 1, 0);
+    const auto binary = sweep(TracerModel::Firmware{true, false}, SerialCtrl::Protocol::Binary, 0, 101);
+
+    // the released firmware ignores "1P" and the host falls back to ASCII
+    const auto ascii  = sweep(TracerModel::Firmware{false, false}, SerialCtrl::Protocol::ASCII, 0, 101);
+
+    CHECK(device.size() == 1 + 101 + 1);
+    if (device.size() == 103)
+    {
+        CHECK(device.front().m_type == DataEvent::DataType::StartSweep);
+        CHECK(device.back().m_type == DataEvent::DataType::EndSweep);
+        CHECK(device.back().m_v1 == static_cast<int32_t>(SerialCtrl::SweepStop::Complete));
+    }
+
+    // the model has no noise, all three report the same readings
+    const auto same = [](const std::vector<AdcSample> &a, const std::vector<AdcSample> &b)
+    {
+        if (a.size() != b.size())
+        {
+            return false;
+        }
+        for(size_t i=0; i<a.size(); i++)
+        {
+            if ((a[i].m_type != b[i].m_type) || (a[i].m_v1 != b[i].m_v1) || (a[i].m_v2 != b[i].m_v2))
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    CHECK(same(device, binary));
+    CHECK(same(device, ascii));
+
+    if (checkFailures() == 0)
+    {
+        std::cout << "serialctrltest passed\n";
+    }
+    return checkFailures();
+}
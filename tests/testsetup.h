@@ -0,0 +1,16 @@
+#pragma once
+
+#include "customevent.h"
+
+/** a setup with round resistor values and unity ADC gains,
+    for the tests that store traces */
+inline SweepSetup testSetup()
+{
+    SweepSetup setup{};
+    setup.m_baseLimitResistor = 100.0f;
+    setup.m_baseSenseResistor = 3.3f;
+    setup.m_collectorResistor = 1.0f;
+    setup.m_adcGain[0] = 1.0f;
+    setup.m_adcGain[1] = 1.0f;
+    return setup;
+}
@@ -0,0 +1,129 @@
+#include <cstdio>
+#include <cstddef>
+#include <vector>
+#include <fstream>
+#include "check.h"
+#include "testsetup.h"
+#include "tracearchive.h"
+
+/** loading of trace archives: records are read back as written and
+    archives of the other byte order, misaligned columns and truncated
+    records are not used. */
+
+static const char *c_filename = "tracearchivetest.ptra";
+
+/** an archive with traces of 10 and 20 samples, the first with a base */
+static void writeArchive()
+{
+    TraceArchiveWriter writer;
+    CHECK(writer.open(c_filename));
+
+    for(size_t count : {10, 20})
+    {
+        std::vector<AdcPair> pairs;
+        std::vector<float> x;
+        std::vector<float> y;
+        for(size_t i=0; i<count; i++)
+        {
+            pairs.push_back(AdcPair{static_cast<int32_t>(i), static_cast<int32_t>(2*i)});
+            x.push_back(static_cast<float>(i));
+            y.push_back(static_cast<float>(3*i));
+        }
+
+        const AdcPair base{5, 6};
+        CHECK(writer.append(testSetup(), (count == 10) ? &base : nullptr, pairs.data(), x.data(), y.data(), count));
+    }
+    writer.close();
+}
+
+/** overwrite a 32-bit value of the archive */
+static void patch(std::streamoff offset, uint32_t value)
+{
+    std::fstream file(c_filename, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(offset);
+    file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void truncate(size_t size)
+{
+    std::vector<char> bytes(size);
+    {
+        std::ifstream in(c_filename, std::ios::binary);
+        in.read(bytes.data(), static_cast<std::streamsize>(size));
+    }
+    std::ofstream out(c_filename, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), static_cast<std::streamsize>(size));
+}
+
+static void testReadBack()
+{
+    writeArchive();
+
+    TraceArchive archive;
+    CHECK(archive.open(QString(c_filename)));
+    CHECK(archive.numberOfTraces() == 2);
+    if (archive.numberOfTraces() != 2)
+    {
+        return;
+    }
+
+    CHECK((archive.size(0) == 10) && (archive.size(1) == 20));
+    CHECK(archive.setup(1).m_collectorResistor == testSetup().m_collectorResistor);
+
+    AdcPair base;
+    CHECK(archive.base(0, base) && (base.m_v1 == 5) && (base.m_v2 == 6));
+    CHECK(!archive.base(1, base));
+
+    for(size_t i=0; i<20; i++)
+    {
+        CHECK(archive.v1(1)[i] == static_cast<int32_t>(i));
+        CHECK(archive.v2(1)[i] == static_cast<int32_t>(2*i));
+        CHECK(archive.x(1)[i] == static_cast<float>(i));
+        CHECK(archive.y(1)[i] == static_cast<float>(3*i));
+    }
+}
+
+static void testByteOrder()
+{
+    writeArchive();
+    patch(offsetof(TraceArchiveFormat::FileHeader, m_byteOrder), 0x04030201);
+
+    TraceArchive archive;
+    CHECK(!archive.open(QString(c_filename)));
+}
+
+static void testMisaligned()
+{
+    // the columns of the second record would start 2 bytes after the
+    // header, it is shortened so the record still fits in the file.
+    writeArchive();
+    const auto second = sizeof(TraceArchiveFormat::FileHeader) + sizeof(TraceArchiveFormat::TraceHeader) + 16*10;
+    patch(second + offsetof(TraceArchiveFormat::TraceHeader, m_headerSize), sizeof(TraceArchiveFormat::TraceHeader) + 2);
+    patch(second + offsetof(TraceArchiveFormat::TraceHeader, m_count), 19);
+
+    TraceArchive archive;
+    CHECK(archive.open(QString(c_filename)));
+    CHECK(archive.numberOfTraces() == 1);
+}
+
+static void testTruncated()
+{
+    // the second record lost its last samples
+    writeArchive();
+    const auto size = sizeof(TraceArchiveFormat::FileHeader) + 2*sizeof(TraceArchiveFormat::TraceHeader) + 16*(10 + 20);
+    truncate(size - 4);
+
+    TraceArchive archive;
+    CHECK(archive.open(QString(c_filename)));
+    CHECK(archive.numberOfTraces() == 1);
+}
+
+int main()
+{
+    testReadBack();
+    testByteOrder();
+    testMisaligned();
+    testTruncated();
+    std::remove(c_filename);
+    return checkFailures();
+}
@@ -0,0 +1,321 @@
+#include <cmath>
+#include <algorithm>
+#include "tracermodel.h"
+
+TracerModel::Device TracerModel::defaultTransistor()
+{
+    Device device;
+    device.m_part                = Part::Transistor;
+    device.m_beta                = 200.0f;
+    device.m_earlyVoltage        = 80.0f;
+    device.m_saturationVoltage   = 0.08f;
+    device.m_saturationCurrent   = 1.4e-16f;   // Vbe = 0.65V at 10uA
+    device.m_emissionCoefficient = 1.0f;
+    device.m_baseSenseResistor   = 3.3e3f;
+    device.m_baseLimitResistor   = 100e3f;
+    device.m_collectorResistor   = 1e3f;
+    device.m_settleError         = 0.05f;
+    device.m_noise               = 0;
+    return device;
+}
+
+TracerModel::Device TracerModel::defaultDiode()
+{
+    Device device = defaultTransistor();
+    device.m_part                = Part::Diode;
+    device.m_saturationCurrent   = 2.5e-9f;    // 1N4148-like
+    device.m_emissionCoefficient = 1.75f;
+    return device;
+}
+
+TracerModel::TracerModel(const Device &device, const Firmware &firmware)
+    : m_device(device), m_firmware(firmware)
+{
+    m_isBinary     = false;
+    m_basePwm      = 0;
+    m_collectorPwm = 0;
+    m_baseReadings = 0;
+    m_garbageInterval = 0;
+    m_responses    = 0;
+    m_random       = 12345;
+
+    for(auto &count : m_commands)
+    {
+        count = 0;
+    }
+}
+
+uint64_t TracerModel::totalCommands() const noexcept
+{
+    uint64_t total = 0;
+    for(const auto &count : m_commands)
+    {
+        total += count.load();
+    }
+    return total;
+}
+
+void TracerModel::receive(const char *data, size_t len, std::vector<std::string> &responses)
+{
+    for(size_t i=0; i<len; i++)
+    {
+        if (m_isBinary)
+        {
+            receiveBinary(static_cast<uint8_t>(data[i]), responses);
+        }
+        else
+        {
+            receiveAscii(data[i], responses);
+        }
+    }
+}
+
+void TracerModel::receiveAscii(char c, std::vector<std::string> &responses)
+{
+    if ((c != '\n') && (c != '\r'))
+    {
+        if (m_line.size() < 64)
+        {
+            m_line.push_back(c);
+        }
+        return;
+    }
+
+    // "<decimal><command> "
+    uint32_t value = 0;
+    char command = 0;
+    for(char lc : m_line)
+    {
+        if ((lc >= '0') && (lc <= '9'))
+        {
+            value = std::min<uint32_t>(value*10 + (lc - '0'), 0xFFFF);
+        }
+        else if (lc != ' ')
+        {
+            command = lc;
+            break;
+        }
+    }
+    m_line.clear();
+
+    if ((command == 'P') && (value == 1) && m_firmware.m_binary)
+    {
+        m_commands['P']++;
+        m_isBinary = true;
+        respond({static_cast<int32_t>(c_protocolMagic),
+            static_cast<int32_t>(m_firmware.m_sweep ? c_featureSweep : 0)}, responses);
+        return;
+    }
+
+    // the released firmware ignores the commands it doesn't know
+    if ((command == 'B') || (command == 'C'))
+    {
+        handleCommand(command, static_cast<uint16_t>(value), 0, 0, responses);
+    }
+}
+
+void TracerModel::receiveBinary(uint8_t c, std::vector<std::string> &responses)
+{
+    m_record.push_back(c);
+
+    while(m_record.size() >= 9)
+    {
+        uint8_t sum = 0;
+        for(size_t i=0; i<9; i++)
+        {
+            sum += m_record[i];
+        }
+
+        if ((m_record[0] != 0xA5) || (sum != 0))
+        {
+            m_record.erase(m_record.begin());
+            continue;
+        }
+
+        const auto arg = [this](size_t i)
+        {
+            return static_cast<uint16_t>(m_record[i] | (m_record[i+1] << 8));
+        };
+
+        const char command = static_cast<char>(m_record[1]);
+        const uint16_t arg0 = arg(2);
+        const uint16_t arg1 = arg(4);
+        const uint16_t arg2 = arg(6);
+        m_record.erase(m_record.begin(), m_record.begin() + 9);
+
+        handleCommand(command, arg0, arg1, arg2, responses);
+    }
+}
+
+void TracerModel::handleCommand(char command, uint16_t arg0, uint16_t arg1, uint16_t arg2,
+    std::vector<std::string> &responses)
+{
+    switch(command)
+    {
+    case 'B':
+        if (arg0 != m_basePwm)
+        {
+            m_baseReadings = 0;
+        }
+        m_basePwm = std::min<uint16_t>(arg0, 1023);
+        respond(measureBase(), responses);
+        break;
+    case 'C':
+        m_collectorPwm = std::min<uint16_t>(arg0, 1023);
+        respond(measureCollector(), responses);
+        break;
+    case 'S':
+        if (!m_firmware.m_sweep || (arg2 == 0))
+        {
+            return;
+        }
+        for(uint32_t pwm = arg0; pwm <= std::min<uint16_t>(arg1, 1023); pwm += arg2)
+        {
+            m_collectorPwm = static_cast<uint16_t>(pwm);
+            respond(measureCollector(), responses);
+        }
+        break;
+    default:
+        return;
+    }
+
+    m_commands[static_cast<uint8_t>(command) & 0x7F]++;
+}
+
+void TracerModel::respond(const std::array<int32_t, 2> &values, std::vector<std::string> &responses)
+{
+    m_responses++;
+    const bool garbage = (m_garbageInterval != 0) && ((m_responses % m_garbageInterval) == 0);
+
+    if (!m_isBinary)
+    {
+        // a lost tab runs the values together into a line
+        // with a single value.
+        responses.push_back(std::to_string(values[0]) + (garbage ? "" : "\t") + std::to_string(values[1]) + "\r\n");
+        return;
+    }
+
+    uint8_t bytes[8];
+    bytes[0] = 0x5A;
+    for(int i=0; i<3; i++)
+    {
+        bytes[1+i] = static_cast<uint8_t>(values[0] >> (8*i));
+        bytes[4+i] = static_cast<uint8_t>(values[1] >> (8*i));
+    }
+
+    uint8_t sum = 0;
+    for(int i=0; i<7; i++)
+    {
+        sum += bytes[i];
+    }
+    bytes[7] = static_cast<uint8_t>(-sum);
+
+    std::string record;
+    if (garbage)
+    {
+        // a stray sync byte followed by bytes that don't add up, also not
+        // with the start of the record. An 8-bit sum can't tell them apart
+        // from a record otherwise.
+        uint8_t garbage[3] = {0x5A, 0x01, 0xFF};
+        uint8_t window = garbage[0] + garbage[1] + garbage[2];
+        for(int i=0; i<5; i++)
+        {
+            window += bytes[i];
+        }
+        if (window == 0)
+        {
+            garbage[2]--;
+        }
+        record.append(reinterpret_cast<const char*>(garbage), sizeof(garbage));
+    }
+
+    record.append(reinterpret_cast<const char*>(bytes), sizeof(bytes));
+    responses.push_back(record);
+}
+
+float TracerModel::baseCurrent(float pwmVoltage) const
+{
+    // solve Vpwm = Ib*R + Vbe(Ib) for Vbe by bisection
+    const float resistance = m_device.m_baseSenseResistor + m_device.m_baseLimitResistor;
+    const float thermalVoltage = 0.02585f * m_device.m_emissionCoefficient;
+
+    float lo = 0.0f;
+    float hi = std::max(pwmVoltage, 0.0f);
+    for(int i=0; i<60; i++)
+    {
+        const float vbe = 0.5f*(lo + hi);
+        const float junction = m_device.m_saturationCurrent * std::expm1(vbe / thermalVoltage);
+        const float resistor = (pwmVoltage - vbe) / resistance;
+        if (junction > resistor)
+        {
+            hi = vbe;
+        }
+        else
+        {
+            lo = vbe;
+        }
+    }
+
+    return std::max((pwmVoltage - 0.5f*(lo + hi)) / resistance, 0.0f);
+}
+
+int32_t TracerModel::counts(float voltage)
+{
+    int32_t noise = 0;
+    if (m_device.m_noise > 0)
+    {
+        m_random = m_random * 1103515245u + 12345u;
+        noise = static_cast<int32_t>((m_random >> 16) % (2*m_device.m_noise + 1)) - m_device.m_noise;
+    }
+
+    const auto value = static_cast<int32_t>(std::lround(voltage * c_countsPerVolt)) + noise;
+    return std::clamp(value, 0, (1 << 24) - 1);
+}
+
+std::array<int32_t, 2> TracerModel::measureBase()
+{
+    const float supply = pwmVoltage(m_basePwm);
+    float current = (m_device.m_part == Part::Transistor) ? baseCurrent(supply) : 0.0f;
+
+    // the PWM filter is still settling after a change
+    m_baseReadings++;
+    current *= 1.0f - std::pow(m_device.m_settleError, static_cast<float>(m_baseReadings));
+
+    return {counts(supply), counts(supply - current*m_device.m_baseSenseResistor)};
+}
+
+std::array<int32_t, 2> TracerModel::measureCollector()
+{
+    const float supply = pwmVoltage(m_collectorPwm);
+    const float thermalVoltage = 0.02585f * m_device.m_emissionCoefficient;
+    const float baseCurrentA = (m_device.m_part == Part::Transistor) ? baseCurrent(pwmVoltage(m_basePwm)) : 0.0f;
+
+    // solve Vsupply = Ic*Rc + Vdevice(Ic) for the device voltage by bisection
+    float lo = 0.0f;
+    float hi = supply;
+    for(int i=0; i<60; i++)
+    {
+        const float v = 0.5f*(lo + hi);
+        float device;
+        if (m_device.m_part == Part::Transistor)
+        {
+            device = m_device.m_beta * baseCurrentA * (1.0f - std::exp(-v / m_device.m_saturationVoltage))
+                * (1.0f + v / m_device.m_earlyVoltage);
+        }
+        else
+        {
+            device = m_device.m_saturationCurrent * std::expm1(v / thermalVoltage);
+        }
+
+        if (device > (supply - v) / m_device.m_collectorResistor)
+        {
+            hi = v;
+        }
+        else
+        {
+            lo = v;
+        }
+    }
+
+    return {counts(supply), counts(0.5f*(lo + hi))};
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/** firmware stand-in for the POSTracer board.
+
+    The model speaks the ASCII protocol of the released firmware:
+    "123B \n" sets the base PWM, "123C \n" the collector PWM, and both
+    are answered with a "v1\tv2\r\n" measurement. The binary protocol
+    and the device-side sweep of binaryframer.h are not in the released
+    firmware yet; the model implements the firmware side of them when
+    Firmware asks for it, so the host side can be tested without a
+    board. The records are
+    encoded here independently of BinaryFramer.
+
+    The part under test is a small-signal NPN transistor or a diode,
+    driven through the resistors of SweepPlan::defaultSetup(). The ADC
+    has a 5V full scale at 2^18 counts, like AdcConversion expects.
+*/
+class TracerModel
+{
+public:
+    enum class Part
+    {
+        Transistor,
+        Diode
+    };
+
+    struct Device
+    {
+        Part  m_part;
+        float m_beta;               // current gain of the transistor
+        float m_earlyVoltage;       // in volts
+        float m_saturationVoltage;  // Vce where the collector current reaches 63%
+        float m_saturationCurrent;  // Is of the base-emitter junction or diode, in amps
+        float m_emissionCoefficient;
+        float m_baseSenseResistor;  // in ohms
+        float m_baseLimitResistor;  // in ohms
+        float m_collectorResistor;  // in ohms
+        float m_settleError;        // relative error of the first base reading after a change, 0 = settled
+        int32_t m_noise;            // peak ADC noise in counts
+    };
+
+    struct Firmware
+    {
+        bool m_binary;      // acknowledges "1P \n" and switches to binary records
+        bool m_sweep;       // accepts the device-side sweep 'S' in binary mode
+    };
+
+    /** a transistor with a gain of 200 on the default setup */
+    static Device defaultTransistor();
+
+    /** a small-signal silicon diode on the default setup */
+    static Device defaultDiode();
+
+    TracerModel(const Device &device, const Firmware &firmware);
+
+    /** handle bytes sent by the host. The measurements that
+        are answered are appended to responses, one per entry. */
+    void receive(const char *data, size_t len, std::vector<std::string> &responses);
+
+    /** insert a burst of garbage before every n-th binary response
+        or garble every n-th ASCII response, 0 = never */
+    void setGarbageInterval(uint32_t interval)
+    {
+        m_garbageInterval = interval;
+    }
+
+    /** reading of the base or collector measurement at the current PWMs */
+    std::array<int32_t, 2> measureBase();
+    std::array<int32_t, 2> measureCollector();
+
+    /** number of commands of a type that were handled, thread safe */
+    uint64_t commands(char command) const noexcept
+    {
+        return m_commands[static_cast<uint8_t>(command) & 0x7F].load();
+    }
+
+    /** number of commands, all types */
+    uint64_t totalCommands() const noexcept;
+
+    bool isBinary() const noexcept
+    {
+        return m_isBinary;
+    }
+
+    uint16_t basePWM() const noexcept
+    {
+        return m_basePwm;
+    }
+
+    uint16_t collectorPWM() const noexcept
+    {
+        return m_collectorPwm;
+    }
+
+    static constexpr float    c_supplyVoltage = 5.0f;
+    static constexpr float    c_countsPerVolt = 262144.0f / 5.0f;
+    static constexpr uint32_t c_protocolMagic = 0x425450;
+    static constexpr uint32_t c_featureSweep  = 0x01;
+
+protected:
+    void handleCommand(char command, uint16_t arg0, uint16_t arg1, uint16_t arg2,
+        std::vector<std::string> &responses);
+
+    void respond(const std::array<int32_t, 2> &values, std::vector<std::string> &responses);
+
+    void receiveAscii(char c, std::vector<std::string> &responses);
+    void receiveBinary(uint8_t c, std::vector<std::string> &responses);
+
+    /** base current in amps for a base PWM voltage */
+    float baseCurrent(float pwmVoltage) const;
+
+    static float pwmVoltage(uint16_t pwm)
+    {
+        return static_cast<float>(pwm) * c_supplyVoltage / 1023.0f;
+    }
+
+    int32_t counts(float voltage);
+
+    Device   m_device;
+    Firmware m_firmware;
+
+    bool     m_isBinary;
+    uint16_t m_basePwm;
+    uint16_t m_collectorPwm;
+    uint32_t m_baseReadings;        // base readings since the last base PWM change
+
+    std::string          m_line;    // ASCII command being received
+    std::vector<uint8_t> m_record;  // binary command being received
+
+    uint32_t m_garbageInterval;
+    uint32_t m_responses;
+    uint32_t m_random;
+
+    std::array<std::atomic<uint64_t>, 128> m_commands;
+};
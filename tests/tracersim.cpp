@@ -0,0 +1,123 @@
+#include <memory>
+#include <vector>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <csignal>
+#include "ptytracer.h"
+
+/** runs simulated tracers for the GUI or the headless mode:
+
+        tracersim --devices 2 &
+        curvetracer --headless --port /dev/pts/5 --port /dev/pts/6
+
+    The names of the pseudo terminals are printed one per line.
+*/
+
+static volatile std::sig_atomic_t g_stop = 0;
+
+static void onSignal(int)
+{
+    g_stop = 1;
+}
+
+static void usage()
+{
+    std::cout << "usage: tracersim [options]\n"
+        "  --devices N       number of tracers, default 1\n"
+        "  --diode           a diode instead of a transistor\n"
+        "  --ascii-only      firmware without binary mode, like the released firmware\n"
+        "  --no-sweep        binary mode without the device-side sweep\n"
+        "  --latency us      USB-serial latency, default 1000\n"
+        "  --sample-time us  ADC time per measurement, default 100\n"
+        "  --baud N          UART baud rate, 0 = unlimited, default 115200\n"
+        "  --noise N         peak ADC noise in counts, default 0\n"
+        "  --seconds N       stop after N seconds, default: run until interrupted\n";
+}
+
+int main(int argc, char **argv)
+{
+    auto device   = TracerModel::defaultTransistor();
+    TracerModel::Firmware firmware{true, true};
+    auto link     = PtyTracer::defaultLink();
+    int devices   = 1;
+    int seconds   = 0;
+
+    for(int i=1; i<argc; i++)
+    {
+        const bool hasValue = (i+1 < argc);
+        if (std::strcmp(argv[i], "--diode") == 0)
+        {
+            device = TracerModel::defaultDiode();
+        }
+        else if (std::strcmp(argv[i], "--ascii-only") == 0)
+        {
+            firmware.m_binary = false;
+        }
+        else if (std::strcmp(argv[i], "--no-sweep") == 0)
+        {
+            firmware.m_sweep = false;
+        }
+        else if ((std::strcmp(argv[i], "--devices") == 0) && hasValue)
+        {
+            devices = std::atoi(argv[++i]);
+        }
+        else if ((std::strcmp(argv[i], "--latency") == 0) && hasValue)
+        {
+            link.m_latencyUs = static_cast<uint32_t>(std::atoi(argv[++i]));
+        }
+        else if ((std::strcmp(argv[i], "--sample-time") == 0) && hasValue)
+        {
+            link.m_sampleTimeUs = static_cast<uint32_t>(std::atoi(argv[++i]));
+        }
+        else if ((std::strcmp(argv[i], "--baud") == 0) && hasValue)
+        {
+            link.m_baudRate = static_cast<uint32_t>(std::atoi(argv[++i]));
+        }
+        else if ((std::strcmp(argv[i], "--noise") == 0) && hasValue)
+        {
+            device.m_noise = std::atoi(argv[++i]);
+        }
+        else if ((std::strcmp(argv[i], "--seconds") == 0) && hasValue)
+        {
+            seconds = std::atoi(argv[++i]);
+        }
+        else
+        {
+            usage();
+            return (std::strcmp(argv[i], "--help") == 0) ? 0 : 1;
+        }
+    }
+
+    std::vector<std::unique_ptr<PtyTracer>> tracers;
+    for(int i=0; i<devices; i++)
+    {
+        tracers.emplace_back(new PtyTracer(device, firmware, link));
+        if (!tracers.back()->start())
+        {
+            std::cerr << "cannot create a pseudo terminal\n";
+            return 1;
+        }
+        std::cout << tracers.back()->portName() << std::endl;
+    }
+
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    const auto end = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    while(!g_stop && ((seconds == 0) || (std::chrono::steady_clock::now() < end)))
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+
+    for(auto &tracer : tracers)
+    {
+        std::cerr << tracer->portName() << ": " << tracer->model().totalCommands() << " commands\n";
+        tracer->stop();
+    }
+
+    return 0;
+}
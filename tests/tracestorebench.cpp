@@ -0,0 +1,120 @@
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <QPointF>
+#include "tracestore.h"
+
+/** memory use and scan speed of the trace storage. TraceStore keeps
+    the raw pairs and the derived values as floats in contiguous
+    arrays, the graph used to keep a vector of QPointF per trace.
+    The scan finds the extents of all traces, like the autoscale. */
+
+static constexpr size_t c_traces = 200;
+static constexpr size_t c_points = 10000;
+static constexpr int    c_scans  = 20;
+
+using Clock = std::chrono::steady_clock;
+
+static double seconds(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main()
+{
+    SweepSetup setup{};
+    setup.m_baseLimitResistor = 100.0f;
+    setup.m_baseSenseResistor = 3.3f;
+    setup.m_collectorResistor = 1.0f;
+    setup.m_adcGain[0] = 1.0f;
+    setup.m_adcGain[1] = 1.0f;
+
+    // raw collector sweeps that saturate at different currents
+    std::vector<AdcPair> pairs(c_points);
+    TraceStore store;
+    std::vector<std::vector<QPointF>> points;
+
+    for(size_t trace=0; trace<c_traces; trace++)
+    {
+        for(size_t i=0; i<c_points; i++)
+        {
+            const int32_t v1 = static_cast<int32_t>(i * 26);
+            const int32_t v2 = std::max(0, v1 - static_cast<int32_t>(trace * 100));
+            pairs[i] = AdcPair{v1, v2};
+        }
+
+        store.newTrace(setup);
+        for(size_t i=0; i<c_points; i+=100)
+        {
+            store.append(pairs.data() + i, 100);
+        }
+
+        // the old storage, filled a point at a time
+        points.emplace_back();
+        for(size_t i=0; i<c_points; i++)
+        {
+            points.back().push_back(QPointF{store.x(trace)[i], store.y(trace)[i]});
+        }
+    }
+
+    size_t pointBytes = points.capacity() * sizeof(std::vector<QPointF>);
+    for(const auto &trace : points)
+    {
+        pointBytes += trace.capacity() * sizeof(QPointF);
+    }
+
+    const double totalPoints = static_cast<double>(c_traces * c_points);
+    std::printf("%zu traces of %zu points\n", c_traces, c_points);
+    std::printf("memory       total MB  bytes/point\n");
+    std::printf("TraceStore   %8.1f  %11.1f  (raw pairs and derived floats)\n",
+        store.memoryUsage() * 1e-6, store.memoryUsage() / totalPoints);
+    std::printf("  floats     %8.1f  %11.1f\n",
+        2.0 * sizeof(float) * store.numberOfPoints() * 1e-6, 2.0 * sizeof(float));
+    std::printf("QPointF      %8.1f  %11.1f\n", pointBytes * 1e-6, pointBytes / totalPoints);
+
+    float minY = 0;
+    float maxY = 0;
+    auto start = Clock::now();
+    for(int scan=0; scan<c_scans; scan++)
+    {
+        minY = std::numeric_limits<float>::max();
+        maxY = std::numeric_limits<float>::lowest();
+        for(size_t trace=0; trace<c_traces; trace++)
+        {
+            const float *y = store.y(trace);
+            for(size_t i=0; i<store.size(trace); i++)
+            {
+                minY = std::min(minY, y[i]);
+                maxY = std::max(maxY, y[i]);
+            }
+        }
+    }
+    const double storeTime = seconds(start) / c_scans;
+
+    double minPointY = 0;
+    double maxPointY = 0;
+    start = Clock::now();
+    for(int scan=0; scan<c_scans; scan++)
+    {
+        minPointY = std::numeric_limits<double>::max();
+        maxPointY = std::numeric_limits<double>::lowest();
+        for(const auto &trace : points)
+        {
+            for(const auto &p : trace)
+            {
+                minPointY = std::min(minPointY, p.y());
+                maxPointY = std::max(maxPointY, p.y());
+            }
+        }
+    }
+    const double pointTime = seconds(start) / c_scans;
+
+    std::printf("y extents    ms/scan  Mpoints/s\n");
+    std::printf("TraceStore   %7.2f  %9.0f\n", storeTime * 1e3, totalPoints / storeTime * 1e-6);
+    std::printf("QPointF      %7.2f  %9.0f\n", pointTime * 1e3, totalPoints / pointTime * 1e-6);
+
+    // both must see the same data
+    return ((minY == static_cast<float>(minPointY)) && (maxY == static_cast<float>(maxPointY))) ? 0 : 1;
+}
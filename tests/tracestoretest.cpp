@@ -0,0 +1,179 @@
+#include <cstdio>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include "check.h"
+#include "testsetup.h"
+#include "conversion.h"
+#include "tracestore.h"
+
+/** the block arena of TraceStore: traces are spilled and paged in
+    intact, growing the last trace leaves the others in place and the
+    blocks of spilled traces are used again. A corrected setup only
+    changes the traces measured in the session. */
+
+/** raw samples of a trace, different for every trace */
+static std::vector<AdcPair> tracePairs(size_t trace, size_t count)
+{
+    std::vector<AdcPair> pairs(count);
+    for(size_t i=0; i<count; i++)
+    {
+        const auto v1 = static_cast<int32_t>(i * 7 + trace);
+        pairs[i] = AdcPair{v1, std::max(0, v1 - static_cast<int32_t>(trace * 13))};
+    }
+    return pairs;
+}
+
+/** some traces are longer than a block */
+static size_t traceLength(size_t trace)
+{
+    static const size_t lengths[] = {1000, 30000, 5, 100000, 20000};
+    return lengths[trace % 5];
+}
+
+static bool sameValues(const TraceStore &store, size_t trace, const std::vector<AdcPair> &pairs,
+    const SweepSetup &setup = testSetup())
+{
+    std::vector<float> x(pairs.size());
+    std::vector<float> y(pairs.size());
+    AdcConversion(setup).convert(pairs.data(), pairs.size(), x.data(), y.data());
+    return std::equal(x.begin(), x.end(), store.x(trace)) && std::equal(y.begin(), y.end(), store.y(trace));
+}
+
+static void testSpill()
+{
+    const size_t c_traces    = 50;
+    const size_t c_maxTraces = 4;
+
+    TraceStore store;
+    CHECK(store.setSpillFile("tracestoretest.spill"));
+    store.setLimits(c_maxTraces, 0);
+
+    size_t steadyMemory = 0;
+    for(size_t trace=0; trace<c_traces; trace++)
+    {
+        CHECK(store.newTrace(testSetup()) == trace);
+
+        // appended in pieces, the trace moves when it outgrows its block
+        const auto pairs = tracePairs(trace, traceLength(trace));
+        const float *previousX = (trace > 0) ? store.x(trace-1) : nullptr;
+        for(size_t i=0; i<pairs.size(); i+=1000)
+        {
+            store.append(pairs.data() + i, std::min<size_t>(1000, pairs.size() - i));
+        }
+        CHECK((trace == 0) || (store.x(trace-1) == previousX));
+        CHECK(sameValues(store, trace, pairs));
+
+        CHECK(store.numberOfTraces() - store.firstResident() <= c_maxTraces);
+        size_t residentPoints = 0;
+        for(size_t resident = store.firstResident(); resident <= trace; resident++)
+        {
+            residentPoints += store.size(resident);
+            CHECK(sameValues(store, resident, tracePairs(resident, traceLength(resident))));
+        }
+        CHECK(store.numberOfPoints() == residentPoints);
+
+        // the blocks of spilled traces are used again,
+        // only the table of traces keeps growing.
+        if (trace == 2*5 - 1)
+        {
+            steadyMemory = store.memoryUsage();
+        }
+        if (trace > 2*5 - 1)
+        {
+            CHECK(store.memoryUsage() < steadyMemory + 64*1024);
+        }
+    }
+
+    // spilled traces read back and paged in
+    for(size_t trace=0; trace<c_traces; trace++)
+    {
+        const auto expected = tracePairs(trace, traceLength(trace));
+        std::vector<AdcPair> pairs;
+        CHECK(store.readRaw(trace, pairs));
+        CHECK((pairs.size() == expected.size()) && std::equal(pairs.begin(), pairs.end(), expected.begin(),
+            [](const AdcPair &a, const AdcPair &b) { return (a.m_v1 == b.m_v1) && (a.m_v2 == b.m_v2); }));
+
+        CHECK(store.pageIn(trace));
+        CHECK(sameValues(store, trace, expected));
+    }
+}
+
+static void testClear()
+{
+    TraceStore store;
+    for(size_t trace=0; trace<10; trace++)
+    {
+        store.newTrace(testSetup());
+        const auto pairs = tracePairs(trace, traceLength(trace));
+        store.append(pairs.data(), pairs.size());
+    }
+
+    // the blocks are kept and filled again
+    const size_t memory = store.memoryUsage();
+    store.clear();
+    CHECK(store.numberOfPoints() == 0);
+    for(size_t trace=0; trace<10; trace++)
+    {
+        store.newTrace(testSetup());
+        const auto pairs = tracePairs(trace, traceLength(trace));
+        store.append(pairs.data(), pairs.size());
+        CHECK(sameValues(store, trace, pairs));
+    }
+    CHECK(store.memoryUsage() == memory);
+}
+
+static void testSetSetup()
+{
+    const auto setup = testSetup();
+    const auto first  = tracePairs(0, 1000);
+    const auto second = tracePairs(1, 1000);
+
+    // an archived trace measured with the same setup as the new traces
+    {
+        std::vector<float> x(first.size());
+        std::vector<float> y(first.size());
+        AdcConversion(setup).convert(first.data(), first.size(), x.data(), y.data());
+
+        TraceArchiveWriter writer;
+        CHECK(writer.open("tracestoretest.ptra"));
+        CHECK(writer.append(setup, nullptr, first.data(), x.data(), y.data(), first.size()));
+        writer.close();
+    }
+
+    auto archive = std::make_shared<TraceArchive>();
+    CHECK(archive->open(QString("tracestoretest.ptra")));
+
+    TraceStore store;
+    store.attachArchive(archive);
+    store.newTrace(setup);
+    store.append(second.data(), second.size());
+
+    // a different sweep doesn't change the values
+    auto sweep = setup;
+    sweep.m_baseCurrentStop = 100;
+    CHECK(!store.setSetup(sweep));
+
+    // a corrected resistor applies to the measured trace only
+    auto corrected = setup;
+    corrected.m_collectorResistor = 2.0f;
+    CHECK(store.setSetup(corrected));
+    CHECK(store.setup(0).m_collectorResistor == setup.m_collectorResistor);
+    CHECK(store.setup(1).m_collectorResistor == corrected.m_collectorResistor);
+    CHECK(sameValues(store, 1, second, corrected));
+
+    CHECK(store.pageIn(0));
+    CHECK(sameValues(store, 0, first, setup));
+
+    store.clear();
+    archive.reset();
+    std::remove("tracestoretest.ptra");
+}
+
+int main()
+{
+    testSpill();
+    testClear();
+    testSetSetup();
+    return checkFailures();
+}
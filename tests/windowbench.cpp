@@ -0,0 +1,77 @@
+#include <memory>
+#include <cstdio>
+#include <QCoreApplication>
+#include <QThread>
+#include <QElapsedTimer>
+#include "ptytracer.h"
+#include "serialctrl.h"
+
+/** collector samples per second of SerialCtrl for a range of window
+    sizes, against a simulated tracer with the ASCII-only firmware
+    behind a 1ms USB-serial latency at 115200 baud. */
+
+static constexpr int c_points = 500;
+
+/** returns the number of samples per second, or 0 on error */
+static double run(uint32_t windowSize)
+{
+    PtyTracer tracer(TracerModel::defaultTransistor(), TracerModel::Firmware{false, false});
+    if (!tracer.start())
+    {
+        return 0;
+    }
+
+    std::unique_ptr<SerialCtrl> serial(SerialCtrl::open(tracer.portName()));
+    if (!serial)
+    {
+        return 0;
+    }
+
+    serial->setWindowSize(windowSize);
+    serial->setBasePWM(300, true);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    for(int i=0; i<c_points; i++)
+    {
+        serial->setCollectorPWM(static_cast<uint16_t>(i % 1024));
+    }
+    serial->run();
+
+    int received = 0;
+    while((received < c_points) && (timer.elapsed() < 30000))
+    {
+        AdcSample sample;
+        if (serial->samples().pop(sample))
+        {
+            received++;
+        }
+        else
+        {
+            QThread::msleep(1);
+        }
+    }
+
+    const double seconds = timer.nsecsElapsed() * 1e-9;
+    serial->close();
+
+    return (received == c_points) ? (received / seconds) : 0;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    std::printf("window  samples/s  (%d points, ASCII, 115200 baud, 1ms latency)\n", c_points);
+
+    bool ok = true;
+    for(uint32_t windowSize : {1U, 2U, 4U, 8U, 16U})
+    {
+        const double rate = run(windowSize);
+        std::printf("%6u  %9.0f\n", windowSize, rate);
+        ok = ok && (rate > 0);
+    }
+
+    return ok ? 0 : 1;
+}